@@ -0,0 +1,1188 @@
+/*
+Benchmarks of the image pipeline, which run without a window.
+
+Run `bench [--iterations <n>] [--json <file>] [<png or jpeg file>...]` from the
+build directory. Without any files, synthetic images resembling a photo and a
+screenshot are generated and used instead. Resampling, adjustments and texture
+uploads are always measured on synthetic images. With `--json`, the results are
+also written to a file for tracking regressions.
+
+The decoded pixels of every image, and of synthetic images covering the PNG and
+JPEG features the decoders support, are compared with those of stb_image, and
+the exit status is nonzero if any differ.
+
+Texture uploads need a renderer, which is created with the offscreen video
+driver (or the dummy driver if it is not available) unless the SDL_VIDEO_DRIVER
+environment variable picks another one, so no display is needed.
+*/
+#include <SDL3/SDL.h>
+#include <stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "adjustments.h"
+#include "deflate.h"
+#include "image_pyramid.h"
+#include "jpeg_decoder.h"
+#include "pixel_packing.h"
+#include "png_decoder.h"
+#include "png_encoder.h"
+#include "resampler.h"
+#include "task_pool.h"
+#include "tile_cache.h"
+
+namespace {
+
+// An encoded image to benchmark.
+struct BenchImage {
+	std::string name;
+	std::vector<Uint8> data;
+};
+
+// One measurement, as written to the JSON results.
+struct BenchResult {
+	std::string benchmark;	// The stage of the pipeline, e.g. "decode".
+	std::string subject;	// The image or method measured.
+	std::string metric;		// What was measured, including the unit.
+	double value;
+};
+
+}  // namespace
+
+// Cheap deterministic noise in [0, 255].
+static std::uint32_t noise(std::uint32_t x, std::uint32_t y) {
+	std::uint32_t h = x * 374761393u + y * 668265263u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	return (h ^ (h >> 16)) & 0xff;
+}
+
+// Smooth gradients with a little noise, which compresses like a photo.
+static SDL_Surface* synthetic_photo(int width, int height) {
+	SDL_Surface* surface =
+		SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+	for (int y = 0; y < height; y++) {
+		auto* row = static_cast<Uint8*>(surface->pixels) + y * surface->pitch;
+		for (int x = 0; x < width; x++) {
+			std::uint32_t n = noise(x, y) % 9;
+			row[x * 4] = static_cast<Uint8>((x * 255 / width + n) & 0xff);
+			row[x * 4 + 1] = static_cast<Uint8>((y * 255 / height + n) & 0xff);
+			row[x * 4 + 2] =
+				static_cast<Uint8>(((x + y) * 127 / (width + height)) + n);
+			row[x * 4 + 3] = 255;
+		}
+	}
+	return surface;
+}
+
+// Flat panels with small high-contrast details, like a screenshot.
+static SDL_Surface* synthetic_screenshot(int width, int height) {
+	SDL_Surface* surface =
+		SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+	SDL_FillSurfaceRect(surface, nullptr,
+						SDL_MapSurfaceRGBA(surface, 240, 240, 240, 255));
+	for (int panel = 0; panel < 24; panel++) {
+		SDL_Rect rect{static_cast<int>(noise(panel, 1) * width / 256),
+					  static_cast<int>(noise(panel, 2) * height / 256),
+					  width / 4, height / 5};
+		SDL_FillSurfaceRect(
+			surface, &rect,
+			SDL_MapSurfaceRGBA(surface, noise(panel, 3), noise(panel, 4),
+							   noise(panel, 5), 255));
+	}
+	// "Text": short runs of dark pixels on every other line.
+	for (int y = 0; y < height; y += 2) {
+		auto* row = static_cast<Uint32*>(surface->pixels) +
+					y * (surface->pitch / 4);
+		for (int x = 0; x < width; x++) {
+			if (noise(x / 3, y) < 40) {
+				row[x] = SDL_MapSurfaceRGBA(surface, 20, 20, 20, 255);
+			}
+		}
+	}
+	return surface;
+}
+
+static bool add_synthetic(std::vector<BenchImage>& images, const char* name,
+						  SDL_Surface* surface) {
+	BenchImage image;
+	image.name = name;
+	bool ok = surface != nullptr && encode_png(surface, image.data);
+	SDL_DestroySurface(surface);
+	if (!ok) {
+		SDL_Log("Failed to create synthetic image '%s': %s", name,
+				SDL_GetError());
+		return false;
+	}
+	images.push_back(std::move(image));
+	return true;
+}
+
+/*
+Time an operation.
+
+@return The median time of one run in seconds, or a negative value if the
+operation failed.
+*/
+template <typename Operation>
+static double median_time(int iterations, Operation run) {
+	std::vector<double> times;
+	for (int i = 0; i < iterations; i++) {
+		Uint64 start = SDL_GetPerformanceCounter();
+		if (!run()) {
+			return -1;
+		}
+		Uint64 end = SDL_GetPerformanceCounter();
+		times.push_back(static_cast<double>(end - start) /
+						static_cast<double>(SDL_GetPerformanceFrequency()));
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+// Name a metric measured at a size, e.g. "1920x1280 ms".
+static std::string size_name(int width, int height, const char* metric) {
+	return std::to_string(width) + "x" + std::to_string(height) + " " + metric;
+}
+
+// Decode an image with the native decoder for its format.
+static bool decode_native(const BenchImage& image, const DecodeOutput& output) {
+	if (is_jpeg(image.data.data(), image.data.size())) {
+		return decode_jpeg(image.data.data(), image.data.size(),
+						   SDL_PIXELFORMAT_ARGB8888, output);
+	}
+	return decode_png(image.data.data(), image.data.size(),
+					  SDL_PIXELFORMAT_ARGB8888, output);
+}
+
+/*
+Decode images with the native decoders and with stb_image. The time until the
+native decoder has produced the first rows of an image is how long the viewer
+takes to start showing it.
+*/
+static void bench_decode(const std::vector<BenchImage>& images,
+						 int iterations, std::vector<BenchResult>& results) {
+	std::printf("Decoding (single thread, MB/s of decoded RGBA pixels, "
+				"milliseconds until the first rows)\n");
+	std::printf("%-24s %11s %10s %10s %8s %11s\n", "image", "pixels", "native",
+				"stb_image", "speedup", "first rows");
+	for (const BenchImage& image : images) {
+		int width = 0;
+		int height = 0;
+		SDL_Surface* surface = nullptr;
+		DecodeOutput output;
+		output.create = [&surface](int width, int height) {
+			surface =
+				SDL_CreateSurface(width, height, SDL_PIXELFORMAT_ARGB8888);
+			return surface;
+		};
+		double native = median_time(iterations, [&] {
+			bool decoded = decode_native(image, output);
+			if (decoded) {
+				width = surface->w;
+				height = surface->h;
+			}
+			SDL_DestroySurface(surface);
+			surface = nullptr;
+			return decoded;
+		});
+
+		// Stop decoding as soon as the first rows are final.
+		bool reported = false;
+		DecodeOutput first_output = output;
+		first_output.progress = [&reported](int /*rows*/) {
+			reported = true;
+			return false;
+		};
+		double first = median_time(iterations, [&] {
+			reported = false;
+			decode_native(image, first_output);
+			SDL_DestroySurface(surface);
+			surface = nullptr;
+			return reported;
+		});
+
+		double stb = median_time(iterations, [&] {
+			int channels = 0;
+			stbi_uc* pixels = stbi_load_from_memory(
+				image.data.data(), static_cast<int>(image.data.size()), &width,
+				&height, &channels, 4);
+			stbi_image_free(pixels);
+			return pixels != nullptr;
+		});
+		if (native < 0 || stb < 0 || first < 0) {
+			std::printf("%-24s failed: %s\n", image.name.c_str(),
+						SDL_GetError());
+			continue;
+		}
+
+		double megabytes = static_cast<double>(width) * height * 4 / 1e6;
+		std::printf("%-24s %5dx%-5d %10.1f %10.1f %7.2fx %11.2f\n",
+					image.name.c_str(), width, height, megabytes / native,
+					megabytes / stb, stb / native, first * 1000);
+		results.push_back({"decode", image.name, "native MB/s",
+						   megabytes / native});
+		results.push_back({"decode", image.name, "stb_image MB/s",
+						   megabytes / stb});
+		results.push_back({"decode", image.name, "first rows ms",
+						   first * 1000});
+	}
+}
+
+/*
+Decode an image with the native decoder for its format and with stb_image, and
+compare their pixels.
+
+@return The largest difference between a channel of the two images, or a
+negative value if either decoder failed or their sizes differ.
+*/
+static int decode_difference(const std::vector<Uint8>& data) {
+	SDL_Surface* surface = nullptr;
+	DecodeOutput output;
+	output.create = [&surface](int width, int height) {
+		surface = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+		return surface;
+	};
+	const bool decoded =
+		is_jpeg(data.data(), data.size())
+			? decode_jpeg(data.data(), data.size(), SDL_PIXELFORMAT_RGBA32,
+						  output)
+			: decode_png(data.data(), data.size(), SDL_PIXELFORMAT_RGBA32,
+						 output);
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	stbi_uc* pixels =
+		stbi_load_from_memory(data.data(), static_cast<int>(data.size()),
+							  &width, &height, &channels, 4);
+	int difference = -1;
+	if (decoded && pixels != nullptr && surface->w == width &&
+		surface->h == height) {
+		difference = 0;
+		for (int y = 0; y < height; y++) {
+			const auto* row =
+				static_cast<const Uint8*>(surface->pixels) + y * surface->pitch;
+			const stbi_uc* expected = pixels + std::size_t{4} * width * y;
+			for (int i = 0; i < width * 4; i++) {
+				difference =
+					std::max(difference, std::abs(row[i] - expected[i]));
+			}
+		}
+	}
+	stbi_image_free(pixels);
+	SDL_DestroySurface(surface);
+	return difference;
+}
+
+/*
+The largest difference from stb_image accepted for a JPEG image. The JPEG
+specification leaves the precision of the IDCT and the color conversion to the
+decoder, and stb_image rounds differently from the native decoder. PNG images
+must decode to exactly the same pixels.
+*/
+static const int JPEG_TOLERANCE = 3;
+
+namespace {
+
+// The layout of a synthetic PNG image, see `synthetic_png()`.
+struct PngLayout {
+	Uint8 color_type;
+	Uint8 depth;
+	bool interlaced;
+	bool transparency;	// Whether to write a tRNS chunk.
+};
+
+}  // namespace
+
+// The value of a channel of a synthetic PNG image, with `depth` bits.
+static std::uint32_t png_sample(int x, int y, int channel, int depth) {
+	// Blocks of equal pixels, so that some match the transparent color and
+	// the filters see runs of zero differences.
+	const std::uint32_t value = noise(x / 4 + channel * 97, y / 4);
+	if (depth == 16) {
+		return value << 8 | noise(x, y + channel);
+	}
+	return value >> (8 - depth);
+}
+
+static void put_png_chunk(std::vector<Uint8>& out, const char* type,
+						  const std::vector<Uint8>& data) {
+	const auto size = static_cast<Uint32>(data.size());
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out.push_back(static_cast<Uint8>(size >> shift));
+	}
+	const std::size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	const Uint32 crc = SDL_crc32(0, out.data() + start, out.size() - start);
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		out.push_back(static_cast<Uint8>(crc >> shift));
+	}
+}
+
+static Uint8 paeth(int a, int b, int c) {
+	const int p = a + b - c;
+	const int pa = std::abs(p - a);
+	const int pb = std::abs(p - b);
+	const int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) {
+		return static_cast<Uint8>(a);
+	}
+	return static_cast<Uint8>(pb <= pc ? b : c);
+}
+
+/*
+Write a PNG image with the given layout, whose rows cycle through the five
+filter types, so that every path of a decoder is taken. Palette images use
+every index the bit depth allows.
+*/
+static std::vector<Uint8> synthetic_png(int width, int height,
+										const PngLayout& layout) {
+	const int channels[] = {1, 0, 3, 1, 2, 0, 4};
+	const int bits = channels[layout.color_type] * layout.depth;
+	const int bytes_per_pixel = std::max(bits / 8, 1);
+	struct Pass {
+		int x, y, dx, dy;
+	};
+	const Pass adam7[] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8},
+						  {2, 0, 4, 4}, {0, 2, 2, 4}, {1, 0, 2, 2},
+						  {0, 1, 1, 2}};
+	const Pass whole{0, 0, 1, 1};
+
+	std::vector<Uint8> filtered;
+	for (int p = 0; p < (layout.interlaced ? 7 : 1); p++) {
+		const Pass& pass = layout.interlaced ? adam7[p] : whole;
+		const int columns = (width - pass.x + pass.dx - 1) / pass.dx;
+		const int rows = (height - pass.y + pass.dy - 1) / pass.dy;
+		if (columns <= 0 || rows <= 0) {
+			continue;
+		}
+		const std::size_t row_size = (std::size_t{1} * columns * bits + 7) / 8;
+		std::vector<Uint8> previous(row_size, 0);
+		std::vector<Uint8> row(row_size);
+		for (int r = 0; r < rows; r++) {
+			std::fill(row.begin(), row.end(), 0);
+			const int y = pass.y + r * pass.dy;
+			for (int c = 0; c < columns; c++) {
+				const int x = pass.x + c * pass.dx;
+				for (int channel = 0; channel < channels[layout.color_type];
+					 channel++) {
+					const std::uint32_t value =
+						png_sample(x, y, channel, layout.depth);
+					const std::size_t bit = (std::size_t{1} * c *
+												 channels[layout.color_type] +
+											 channel) *
+											layout.depth;
+					if (layout.depth == 16) {
+						row[bit / 8] = static_cast<Uint8>(value >> 8);
+						row[bit / 8 + 1] = static_cast<Uint8>(value);
+					} else {
+						row[bit / 8] |= static_cast<Uint8>(
+							value << (8 - layout.depth - bit % 8));
+					}
+				}
+			}
+			const int filter = r % 5;
+			filtered.push_back(static_cast<Uint8>(filter));
+			for (std::size_t i = 0; i < row_size; i++) {
+				const int a = i >= static_cast<std::size_t>(bytes_per_pixel)
+								  ? row[i - bytes_per_pixel]
+								  : 0;
+				const int b = previous[i];
+				const int c = i >= static_cast<std::size_t>(bytes_per_pixel)
+								  ? previous[i - bytes_per_pixel]
+								  : 0;
+				const int predictions[] = {0, a, b, (a + b) / 2,
+										   paeth(a, b, c)};
+				filtered.push_back(
+					static_cast<Uint8>(row[i] - predictions[filter]));
+			}
+			previous.swap(row);
+		}
+	}
+
+	std::vector<Uint8> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	std::vector<Uint8> header;
+	for (int value : {width, height}) {
+		for (int shift = 24; shift >= 0; shift -= 8) {
+			header.push_back(static_cast<Uint8>(value >> shift));
+		}
+	}
+	header.insert(header.end(), {layout.depth, layout.color_type, 0, 0,
+								 static_cast<Uint8>(layout.interlaced)});
+	put_png_chunk(out, "IHDR", header);
+	if (layout.color_type == 3) {
+		std::vector<Uint8> palette;
+		std::vector<Uint8> alpha;
+		for (int i = 0; i < 1 << layout.depth; i++) {
+			palette.insert(palette.end(),
+						   {static_cast<Uint8>(noise(i, 1)),
+							static_cast<Uint8>(noise(i, 2)),
+							static_cast<Uint8>(noise(i, 3))});
+			alpha.push_back(static_cast<Uint8>(noise(i, 4)));
+		}
+		// Leave the last entries opaque, as the tRNS chunk may be shorter.
+		alpha.resize(alpha.size() - alpha.size() / 4);
+		put_png_chunk(out, "PLTE", palette);
+		if (layout.transparency) {
+			put_png_chunk(out, "tRNS", alpha);
+		}
+	} else if (layout.transparency) {
+		// The color of the top left pixel is transparent.
+		std::vector<Uint8> color;
+		for (int channel = 0; channel < channels[layout.color_type];
+			 channel++) {
+			const std::uint32_t value = png_sample(0, 0, channel, layout.depth);
+			color.insert(color.end(), {static_cast<Uint8>(value >> 8),
+									   static_cast<Uint8>(value)});
+		}
+		put_png_chunk(out, "tRNS", color);
+	}
+	std::vector<Uint8> data;
+	zlib_compress(filtered.data(), filtered.size(), data);
+	put_png_chunk(out, "IDAT", data);
+	put_png_chunk(out, "IEND", {});
+	return out;
+}
+
+namespace {
+
+// Writes the entropy-coded segment of a JPEG scan.
+class JpegBitWriter {
+   private:
+	std::vector<Uint8>& out;
+	std::uint32_t buffer = 0;
+	int count = 0;
+
+   public:
+	explicit JpegBitWriter(std::vector<Uint8>& out) : out(out) {}
+
+	// Write the lowest `size` bits of `bits`, most significant first.
+	void put(std::uint32_t bits, int size) {
+		for (int i = size - 1; i >= 0; i--) {
+			buffer = buffer << 1 | ((bits >> i) & 1);
+			if (++count == 8) {
+				out.push_back(static_cast<Uint8>(buffer));
+				if (buffer == 0xff) {
+					out.push_back(0);
+				}
+				buffer = 0;
+				count = 0;
+			}
+		}
+	}
+
+	// Write a value with its Huffman-coded size category first. The synthetic
+	// Huffman table gives every symbol its own value as an 8-bit code.
+	void put_coded(int symbol_high, int value) {
+		const int magnitude = std::abs(value);
+		int size = 0;
+		while (magnitude >> size != 0) {
+			size++;
+		}
+		put(static_cast<std::uint32_t>(symbol_high << 4 | size), 8);
+		put(static_cast<std::uint32_t>(value < 0 ? value + (1 << size) - 1
+												 : value),
+			size);
+	}
+
+	// Pad the last byte with ones.
+	void flush() {
+		if (count > 0) {
+			put(0x7f, 8 - count);
+		}
+	}
+};
+
+}  // namespace
+
+/*
+Write a scan of a synthetic JPEG image, see `synthetic_jpeg()`.
+
+@param coefficients The quantized coefficients of every block of each
+component, in zigzag order.
+@param components The components in the scan.
+@param start The first coefficient in the scan, 0 for DC.
+@param end The last coefficient in the scan.
+@param high The successive approximation bit position of the previous scan of
+these coefficients, 0 for the first scan.
+@param low The successive approximation bit position of this scan.
+*/
+static void put_jpeg_scan(
+	const std::vector<std::vector<std::array<int, 64>>>& coefficients,
+	const std::vector<int>& components, int start, int end, int high, int low,
+	std::vector<Uint8>& out) {
+	const auto size = static_cast<int>(6 + 2 * components.size());
+	out.insert(out.end(), {0xff, 0xda, 0, static_cast<Uint8>(size),
+						   static_cast<Uint8>(components.size())});
+	for (int component : components) {
+		out.insert(out.end(), {static_cast<Uint8>(component + 1), 0});
+	}
+	out.insert(out.end(),
+			   {static_cast<Uint8>(start), static_cast<Uint8>(end),
+				static_cast<Uint8>(high << 4 | low)});
+
+	JpegBitWriter writer(out);
+	int predictions[3] = {};
+	for (std::size_t block = 0; block < coefficients[0].size(); block++) {
+		for (int component : components) {
+			const std::array<int, 64>& values = coefficients[component][block];
+			if (start == 0 && high == 0) {
+				const int dc = values[0] >> low;
+				writer.put_coded(0, dc - predictions[component]);
+				predictions[component] = dc;
+			} else if (start == 0) {
+				writer.put(static_cast<std::uint32_t>(values[0] >> low) & 1, 1);
+			}
+			if (end == 0) {
+				continue;
+			}
+			// Runs of zeros, and the correction bits of coefficients which
+			// were already nonzero in the previous scan, which are written
+			// after the next coded value.
+			// The last coefficient which is coded rather than corrected.
+			int last = 0;
+			for (int k = std::max(start, 1); k <= end; k++) {
+				const int magnitude = std::abs(values[k]) >> low;
+				if (magnitude == 1 || (high == 0 && magnitude != 0)) {
+					last = k;
+				}
+			}
+			int run = 0;
+			std::vector<std::uint32_t> corrections;
+			for (int k = std::max(start, 1); k <= end; k++) {
+				const int magnitude = std::abs(values[k]) >> low;
+				if (magnitude == 0) {
+					run++;
+					continue;
+				}
+				while (run > 15 && k <= last) {
+					writer.put(0xf0, 8);
+					for (std::uint32_t bit : corrections) {
+						writer.put(bit, 1);
+					}
+					corrections.clear();
+					run -= 16;
+				}
+				if (high != 0 && magnitude > 1) {
+					corrections.push_back(
+						static_cast<std::uint32_t>(magnitude & 1));
+					continue;
+				}
+				if (high == 0) {
+					writer.put_coded(run, values[k] < 0 ? -magnitude
+														: magnitude);
+				} else {
+					writer.put(static_cast<std::uint32_t>(run << 4 | 1), 8);
+					writer.put(values[k] < 0 ? 0 : 1, 1);
+				}
+				for (std::uint32_t bit : corrections) {
+					writer.put(bit, 1);
+				}
+				corrections.clear();
+				run = 0;
+			}
+			if (run > 0 || !corrections.empty()) {
+				writer.put(0, 8);  // End of block.
+				for (std::uint32_t bit : corrections) {
+					writer.put(bit, 1);
+				}
+			}
+		}
+	}
+	writer.flush();
+}
+
+/*
+Write a JPEG image with 4:4:4 YCbCr samples, either baseline or progressive
+with the scans libjpeg writes by default, including successive approximation.
+The DCT is computed directly from its definition, and a single Huffman table
+gives every symbol an 8-bit code, which keeps the encoder simple.
+*/
+static std::vector<Uint8> synthetic_jpeg(int width, int height,
+										 bool progressive) {
+	// Zigzag order and a quantization table which keeps some of the highest
+	// frequencies.
+	int zigzag[64];
+	for (int sum = 0, k = 0; sum < 15; sum++) {
+		for (int i = 0; i <= sum; i++) {
+			const int row = sum % 2 == 0 ? sum - i : i;
+			const int column = sum - row;
+			if (row < 8 && column < 8) {
+				zigzag[k++] = row * 8 + column;
+			}
+		}
+	}
+	int quantization[64];
+	for (int k = 0; k < 64; k++) {
+		quantization[k] = k == 0 ? 2 : 3 + k / 3;
+	}
+
+	const int columns = (width + 7) / 8;
+	const int rows = (height + 7) / 8;
+	std::vector<std::vector<std::array<int, 64>>> coefficients(
+		3, std::vector<std::array<int, 64>>(std::size_t{1} * columns * rows));
+	for (int component = 0; component < 3; component++) {
+		for (int block = 0; block < columns * rows; block++) {
+			double samples[64];
+			for (int i = 0; i < 64; i++) {
+				const int x = std::min(block % columns * 8 + i % 8, width - 1);
+				const int y = std::min(block / columns * 8 + i / 8, height - 1);
+				const int smooth = component == 0
+									   ? (x + y) * 255 / (width + height)
+									   : 96 + component * 16 + x * 32 / width;
+				samples[i] =
+					smooth + static_cast<int>(noise(x, y + component) % 32) -
+					16 - 128;
+			}
+			for (int k = 0; k < 64; k++) {
+				const int u = zigzag[k] % 8;
+				const int v = zigzag[k] / 8;
+				double sum = 0;
+				for (int i = 0; i < 64; i++) {
+					sum += samples[i] *
+						   std::cos((2 * (i % 8) + 1) * u * SDL_PI_D / 16) *
+						   std::cos((2 * (i / 8) + 1) * v * SDL_PI_D / 16);
+				}
+				const double scale = std::sqrt(0.5);
+				sum *= (u == 0 ? scale : 1) * (v == 0 ? scale : 1) / 4;
+				coefficients[component][block][k] =
+					static_cast<int>(std::lround(sum / quantization[k]));
+			}
+		}
+	}
+
+	std::vector<Uint8> out = {0xff, 0xd8, 0xff, 0xe0, 0, 16, 'J', 'F', 'I',
+							  'F',	0,	  1,	1,	  0, 0,	 1,	  0,   1,
+							  0,	0};
+	out.insert(out.end(), {0xff, 0xdb, 0, 67, 0});
+	for (int value : quantization) {
+		out.push_back(static_cast<Uint8>(value));
+	}
+	out.insert(out.end(),
+			   {0xff, static_cast<Uint8>(progressive ? 0xc2 : 0xc0), 0, 17, 8,
+				static_cast<Uint8>(height >> 8), static_cast<Uint8>(height),
+				static_cast<Uint8>(width >> 8), static_cast<Uint8>(width), 3});
+	for (Uint8 id = 1; id <= 3; id++) {
+		out.insert(out.end(), {id, 0x11, 0});
+	}
+	for (Uint8 table_class : {0, 1}) {
+		out.insert(out.end(), {0xff, 0xc4, 0x01, 0x12,
+							   static_cast<Uint8>(table_class << 4)});
+		for (int length = 1; length <= 16; length++) {
+			out.push_back(length == 8 ? 255 : 0);
+		}
+		for (int symbol = 0; symbol < 255; symbol++) {
+			out.push_back(static_cast<Uint8>(symbol));
+		}
+	}
+
+	if (!progressive) {
+		put_jpeg_scan(coefficients, {0, 1, 2}, 0, 63, 0, 0, out);
+	} else {
+		put_jpeg_scan(coefficients, {0, 1, 2}, 0, 0, 0, 1, out);
+		put_jpeg_scan(coefficients, {0}, 1, 5, 0, 2, out);
+		put_jpeg_scan(coefficients, {2}, 1, 63, 0, 1, out);
+		put_jpeg_scan(coefficients, {1}, 1, 63, 0, 1, out);
+		put_jpeg_scan(coefficients, {0}, 6, 63, 0, 2, out);
+		put_jpeg_scan(coefficients, {0}, 1, 63, 2, 1, out);
+		put_jpeg_scan(coefficients, {0, 1, 2}, 0, 0, 1, 0, out);
+		put_jpeg_scan(coefficients, {2}, 1, 63, 1, 0, out);
+		put_jpeg_scan(coefficients, {1}, 1, 63, 1, 0, out);
+		put_jpeg_scan(coefficients, {0}, 1, 63, 1, 0, out);
+	}
+	out.insert(out.end(), {0xff, 0xd9});
+	return out;
+}
+
+/*
+Compare the native decoders with stb_image on the benchmarked images, and on
+synthetic images covering every PNG color type and bit depth, with and without
+Adam7 interlacing and tRNS transparency, and baseline and progressive JPEG
+images.
+
+@return `false` if any image decodes differently.
+*/
+static bool check_decoders(const std::vector<BenchImage>& images,
+						   std::vector<BenchResult>& results) {
+	std::printf("\nDecoder conformance (largest channel difference from "
+				"stb_image)\n");
+	struct Case {
+		std::string name;
+		std::vector<Uint8> data;
+		int tolerance;
+	};
+	std::vector<Case> cases;
+	for (const BenchImage& image : images) {
+		cases.push_back({image.name, image.data,
+						 is_jpeg(image.data.data(), image.data.size())
+							 ? JPEG_TOLERANCE
+							 : 0});
+	}
+	const char* color_names[] = {"gray", "", "RGB", "palette", "gray alpha",
+								 "",	 "RGBA"};
+	const std::vector<std::vector<Uint8>> depths = {
+		{1, 2, 4, 8, 16}, {}, {8, 16}, {1, 2, 4, 8}, {8, 16}, {}, {8, 16}};
+	for (Uint8 color_type = 0; color_type < 7; color_type++) {
+		for (Uint8 depth : depths[color_type]) {
+			for (bool interlaced : {false, true}) {
+				// Only colors without alpha can have a tRNS chunk.
+				for (bool transparency : {false, true}) {
+					if (transparency && (color_type & 4) != 0) {
+						continue;
+					}
+					std::string name = "PNG " +
+									   std::string(color_names[color_type]) +
+									   " " + std::to_string(depth) + "-bit";
+					name += transparency ? " tRNS" : "";
+					name += interlaced ? " Adam7" : "";
+					cases.push_back(
+						{name,
+						 synthetic_png(37, 29,
+									   {color_type, depth, interlaced,
+										transparency}),
+						 0});
+				}
+			}
+		}
+	}
+	cases.push_back(
+		{"JPEG baseline 4:4:4", synthetic_jpeg(203, 157, false),
+		 JPEG_TOLERANCE});
+	cases.push_back({"JPEG progressive 4:4:4", synthetic_jpeg(203, 157, true),
+					 JPEG_TOLERANCE});
+
+	bool matched = true;
+	for (const Case& test : cases) {
+		const int difference = decode_difference(test.data);
+		const bool match = difference >= 0 && difference <= test.tolerance;
+		if (difference < 0) {
+			std::printf("%-32s failed: %s\n", test.name.c_str(),
+						SDL_GetError());
+		} else {
+			std::printf("%-32s %5d%s\n", test.name.c_str(), difference,
+						match ? "" : "  MISMATCH");
+			results.push_back({"conformance", test.name,
+							   "max difference from stb_image",
+							   static_cast<double>(difference)});
+		}
+		matched = matched && match;
+	}
+	return matched;
+}
+
+/*
+A zone plate: concentric rings whose frequency increases linearly from the
+center, up to half a cycle per pixel in the corners. Scaling it down shows
+aliasing as rings appearing where there should only be gray.
+*/
+static const double SQRT2 = 1.4142135623730951;
+
+static double zone_plate(double x, double y, int size) {
+	const double r2 = (x - size / 2.0) * (x - size / 2.0) +
+					  (y - size / 2.0) * (y - size / 2.0);
+	return 0.5 + 0.5 * std::cos(SDL_PI_D * r2 / (SQRT2 * size));
+}
+
+static SDL_Surface* synthetic_zone_plate(int size) {
+	SDL_Surface* surface =
+		SDL_CreateSurface(size, size, SDL_PIXELFORMAT_RGBA32);
+	for (int y = 0; y < size; y++) {
+		auto* row = static_cast<Uint8*>(surface->pixels) + y * surface->pitch;
+		for (int x = 0; x < size; x++) {
+			auto value = static_cast<Uint8>(
+				std::lround(255 * zone_plate(x + 0.5, y + 0.5, size)));
+			row[x * 4] = row[x * 4 + 1] = row[x * 4 + 2] = value;
+			row[x * 4 + 3] = 255;
+		}
+	}
+	return surface;
+}
+
+/*
+Compare a zone plate scaled down to `scaled->w` pixels with the ideal result,
+which keeps the rings below half a cycle per pixel of the scaled image and is
+gray everywhere else.
+
+@return The peak signal to noise ratio in decibels.
+*/
+static double zone_plate_psnr(const SDL_Surface* scaled, int size) {
+	const double scale = static_cast<double>(size) / scaled->w;
+	double error = 0;
+	for (int y = 0; y < scaled->h; y++) {
+		const auto* row =
+			static_cast<const Uint8*>(scaled->pixels) + y * scaled->pitch;
+		for (int x = 0; x < scaled->w; x++) {
+			const double sx = (x + 0.5) * scale;
+			const double sy = (y + 0.5) * scale;
+			const double radius =
+				std::hypot(sx - size / 2.0, sy - size / 2.0);
+			const double frequency = radius / (SQRT2 * size) * scale;
+			const double ideal =
+				frequency < 0.5 ? 255 * zone_plate(sx, sy, size) : 127.5;
+			error += (row[x * 4] - ideal) * (row[x * 4] - ideal);
+		}
+	}
+	error /= static_cast<double>(scaled->w) * scaled->h;
+	return 10 * std::log10(255 * 255 / error);
+}
+
+namespace {
+
+// A way of scaling a surface.
+struct Scaler {
+	const char* name;
+	bool (*scale)(SDL_Surface* source, SDL_Surface* destination);
+};
+
+}  // namespace
+
+static const Scaler SCALERS[] = {
+	{"SDL nearest",
+	 [](SDL_Surface* source, SDL_Surface* destination) {
+		 return SDL_StretchSurface(source, nullptr, destination, nullptr,
+								   SDL_SCALEMODE_NEAREST);
+	 }},
+	{"SDL linear",
+	 [](SDL_Surface* source, SDL_Surface* destination) {
+		 return SDL_StretchSurface(source, nullptr, destination, nullptr,
+								   SDL_SCALEMODE_LINEAR);
+	 }},
+	{"area",
+	 [](SDL_Surface* source, SDL_Surface* destination) {
+		 return resample(source, nullptr, destination, RESAMPLE_FILTER_AREA);
+	 }},
+	{"bicubic",
+	 [](SDL_Surface* source, SDL_Surface* destination) {
+		 return resample(source, nullptr, destination,
+						 RESAMPLE_FILTER_BICUBIC);
+	 }},
+	{"lanczos3",
+	 [](SDL_Surface* source, SDL_Surface* destination) {
+		 return resample(source, nullptr, destination,
+						 RESAMPLE_FILTER_LANCZOS3);
+	 }},
+	{"lanczos3, all cores",
+	 [](SDL_Surface* source, SDL_Surface* destination) {
+		 static TaskPool pool(static_cast<unsigned int>(
+			 std::max(SDL_GetNumLogicalCPUCores(), 1) - 1));
+		 return resample(source, nullptr, destination,
+						 RESAMPLE_FILTER_LANCZOS3, &pool);
+	 }},
+};
+
+/*
+Scale images with SDL_StretchSurface and with the resampler: a photo to the
+sizes used for fitting it into a window, for thumbnails and for zooming in, and
+a zone plate to measure aliasing.
+*/
+static void bench_resample(int iterations, std::vector<BenchResult>& results) {
+	struct Size {
+		int width;
+		int height;
+	};
+	const Size photo_sizes[] = {{1920, 1280}, {300, 200}, {6000, 4000}};
+	const int plate_size = 2048;
+	const int plate_sizes[] = {1024, 205};
+
+	SDL_Surface* photo = synthetic_photo(3000, 2000);
+	SDL_Surface* plate = synthetic_zone_plate(plate_size);
+	std::printf("\nResampling (milliseconds for a 3000x2000 photo, PSNR in dB "
+				"of a %dx%d zone plate)\n",
+				plate_size, plate_size);
+	std::printf("%-20s", "scaler");
+	for (const Size& size : photo_sizes) {
+		std::printf(" %11dx%-5d", size.width, size.height);
+	}
+	for (int size : plate_sizes) {
+		std::printf(" %7dx%-5d", size, size);
+	}
+	std::printf("\n");
+
+	for (const Scaler& scaler : SCALERS) {
+		std::printf("%-20s", scaler.name);
+		for (const Size& size : photo_sizes) {
+			SDL_Surface* scaled = SDL_CreateSurface(size.width, size.height,
+													SDL_PIXELFORMAT_RGBA32);
+			double time = median_time(iterations, [&] {
+				return scaled != nullptr && scaler.scale(photo, scaled);
+			});
+			std::printf(" %17.2f", time * 1000);
+			if (time >= 0) {
+				results.push_back({"resample", scaler.name,
+								   size_name(size.width, size.height, "ms"),
+								   time * 1000});
+			}
+			SDL_DestroySurface(scaled);
+		}
+		for (int size : plate_sizes) {
+			SDL_Surface* scaled =
+				SDL_CreateSurface(size, size, SDL_PIXELFORMAT_RGBA32);
+			if (scaled != nullptr && scaler.scale(plate, scaled)) {
+				const double psnr = zone_plate_psnr(scaled, plate_size);
+				std::printf(" %13.1f", psnr);
+				results.push_back({"resample", scaler.name,
+								   size_name(size, size, "zone plate PSNR dB"),
+								   psnr});
+			} else {
+				std::printf(" %13s", "failed");
+			}
+			SDL_DestroySurface(scaled);
+		}
+		std::printf("\n");
+	}
+	SDL_DestroySurface(plate);
+	SDL_DestroySurface(photo);
+}
+
+/*
+Apply adjustments to the areas processed by the viewer: a tile uploaded while
+zoomed in, and the whole image when it is exported.
+*/
+static void bench_adjust(int iterations, std::vector<BenchResult>& results) {
+	struct Area {
+		const char* name;
+		SDL_Rect rect;
+	};
+	const Area areas[] = {{"tile", SDL_Rect{1023, 1023, 514, 514}},
+						  {"image", SDL_Rect{0, 0, 6000, 4000}}};
+	Adjustments tone;
+	tone.exposure = 0.5f;
+	tone.gamma = 1.2f;
+	tone.midtones = 0.05f;
+	tone.saturation = 1.3f;
+	Adjustments all = tone;
+	all.sharpen = 1;
+	struct Setting {
+		const char* name;
+		Adjustments adjustments;
+	};
+	const Setting settings[] = {{"tone and saturation", tone},
+								{"with sharpening", all}};
+
+	const int cores = std::max(SDL_GetNumLogicalCPUCores(), 1);
+	TaskPool pool(static_cast<unsigned int>(cores - 1));
+	SDL_Surface* photo = synthetic_photo(6000, 4000);
+	SDL_Surface* adjusted =
+		SDL_CreateSurface(6000, 4000, SDL_PIXELFORMAT_RGBA32);
+	std::printf("\nAdjustments (milliseconds for a 6000x4000 photo, %d "
+				"threads)\n",
+				cores);
+	std::printf("%-20s", "adjustments");
+	for (const Area& area : areas) {
+		std::printf(" %11dx%-5d", area.rect.w, area.rect.h);
+	}
+	std::printf("\n");
+	for (const Setting& setting : settings) {
+		const AdjustmentGraph graph(setting.adjustments, photo->format);
+		std::printf("%-20s", setting.name);
+		for (const Area& area : areas) {
+			double time = median_time(iterations, [&] {
+				graph.apply(photo, photo->h, area.rect, adjusted, pool);
+				return true;
+			});
+			std::printf(" %17.2f", time * 1000);
+			results.push_back({"adjust", setting.name,
+							   size_name(area.rect.w, area.rect.h, "ms"),
+							   time * 1000});
+		}
+		std::printf("\n");
+	}
+	SDL_DestroySurface(adjusted);
+	SDL_DestroySurface(photo);
+}
+
+/*
+Upload a photo to textures the way the viewer does: every tile of the full size
+image through the tile cache, and the image fitted to a window into a single
+streaming texture.
+
+@param renderer_name Receives the name of the renderer used.
+*/
+static void bench_upload(int iterations, std::vector<BenchResult>& results,
+						 std::string& renderer_name) {
+	// Try the video drivers which need no display in turn. The environment
+	// variable overrides the hint.
+	bool initialized = false;
+	for (const char* driver : {"offscreen", "dummy"}) {
+		SDL_SetHint(SDL_HINT_VIDEO_DRIVER, driver);
+		if (SDL_Init(SDL_INIT_VIDEO)) {
+			initialized = true;
+			break;
+		}
+	}
+	SDL_Window* window = nullptr;
+	SDL_Renderer* renderer = nullptr;
+	if (!initialized ||
+		!SDL_CreateWindowAndRenderer("bench", 64, 64, SDL_WINDOW_HIDDEN,
+									 &window, &renderer)) {
+		std::printf("\nUploads skipped: %s\n", SDL_GetError());
+		SDL_Quit();
+		return;
+	}
+	renderer_name = SDL_GetRendererName(renderer);
+	const SDL_PixelFormat format = texture_format(renderer);
+
+	const int width = 6000;
+	const int height = 4000;
+	SDL_Surface* photo = synthetic_photo(width, height);
+	std::unique_ptr<ImagePyramid> image =
+		ImagePyramid::create(width, height, format);
+	SDL_Surface* fitted = SDL_CreateSurface(1920, 1280, format);
+	SDL_Texture* texture = SDL_CreateTexture(
+		renderer, format, SDL_TEXTUREACCESS_STREAMING, 1920, 1280);
+	if (image == nullptr || fitted == nullptr || texture == nullptr ||
+		!SDL_ConvertPixels(width, height, photo->format, photo->pixels,
+						   photo->pitch, format, image->image()->pixels,
+						   image->image()->pitch)) {
+		std::printf("\nUploads skipped: %s\n", SDL_GetError());
+	} else {
+		image->publish(height);
+		std::printf("\nTexture uploads (milliseconds, %s video driver, %s "
+					"renderer)\n",
+					SDL_GetCurrentVideoDriver(), renderer_name.c_str());
+
+		const int columns =
+			(width + ImagePyramid::TILE_SIZE - 1) / ImagePyramid::TILE_SIZE;
+		const int rows =
+			(height + ImagePyramid::TILE_SIZE - 1) / ImagePyramid::TILE_SIZE;
+		TileCache tiles(renderer, std::size_t{1} << 30, columns * rows);
+		const double tile_time = median_time(iterations, [&] {
+			tiles.release(image.get());
+			tiles.begin_frame();
+			for (int y = 0; y < rows; y++) {
+				for (int x = 0; x < columns; x++) {
+					int ready = 0;
+					if (tiles.request(TileKey{image.get(), 0, x, y}, ready) ==
+						nullptr) {
+						return false;
+					}
+				}
+			}
+			return true;
+		});
+		const double texture_time = median_time(iterations, [&] {
+			return SDL_UpdateTexture(texture, nullptr, fitted->pixels,
+									 fitted->pitch);
+		});
+		std::printf("%-20s %17.2f\n",
+					(std::to_string(columns * rows) + " tiles").c_str(),
+					tile_time * 1000);
+		std::printf("%-20s %17.2f\n", "1920x1280 texture",
+					texture_time * 1000);
+		if (tile_time >= 0) {
+			results.push_back({"upload", "tile cache",
+							   size_name(width, height, "ms"),
+							   tile_time * 1000});
+		}
+		if (texture_time >= 0) {
+			results.push_back({"upload", "streaming texture",
+							   size_name(1920, 1280, "ms"),
+							   texture_time * 1000});
+		}
+	}
+	SDL_DestroyTexture(texture);
+	SDL_DestroySurface(fitted);
+	SDL_DestroySurface(photo);
+	image.reset();
+	SDL_DestroyRenderer(renderer);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+}
+
+// Quote a string for JSON.
+static std::string json_string(const std::string& text) {
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			SDL_snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			quoted += escaped;
+		} else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+// Write the results as a JSON object, one result per line.
+static bool write_json(const char* path, int iterations,
+					   const std::string& renderer,
+					   const std::vector<BenchResult>& results) {
+	std::string json = "{\n  \"iterations\": " + std::to_string(iterations) +
+					   ",\n  \"renderer\": " + json_string(renderer) +
+					   ",\n  \"results\": [";
+	for (std::size_t i = 0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		char value[32];
+		SDL_snprintf(value, sizeof(value), "%.6g", result.value);
+		json += i == 0 ? "\n" : ",\n";
+		json += "    {\"benchmark\": " + json_string(result.benchmark) +
+				", \"subject\": " + json_string(result.subject) +
+				", \"metric\": " + json_string(result.metric) +
+				", \"value\": " + value + "}";
+	}
+	json += "\n  ]\n}\n";
+	return SDL_SaveFile(path, json.data(), json.size());
+}
+
+int main(int argc, char** argv) {
+	int iterations = 5;
+	const char* json_path = nullptr;
+	std::vector<BenchImage> images;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = std::max(1, std::atoi(argv[++i]));
+			continue;
+		}
+		if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			json_path = argv[++i];
+			continue;
+		}
+		size_t size = 0;
+		void* data = SDL_LoadFile(argv[i], &size);
+		if (data == nullptr) {
+			SDL_Log("SDL_LoadFile: %s", SDL_GetError());
+			return EXIT_FAILURE;
+		}
+		BenchImage image;
+		image.name = argv[i];
+		image.data.assign(static_cast<Uint8*>(data),
+						  static_cast<Uint8*>(data) + size);
+		SDL_free(data);
+		images.push_back(std::move(image));
+	}
+
+	if (images.empty() &&
+		(!add_synthetic(images, "synthetic photo",
+						synthetic_photo(3000, 2000)) ||
+		 !add_synthetic(images, "synthetic screenshot",
+						synthetic_screenshot(2560, 1440)))) {
+		return EXIT_FAILURE;
+	}
+
+	std::vector<BenchResult> results;
+	std::string renderer = "none";
+	bench_decode(images, iterations, results);
+	const bool matched = check_decoders(images, results);
+	bench_resample(iterations, results);
+	bench_adjust(iterations, results);
+	bench_upload(iterations, results, renderer);
+	if (json_path != nullptr &&
+		!write_json(json_path, iterations, renderer, results)) {
+		SDL_Log("Failed to write '%s': %s", json_path, SDL_GetError());
+		return EXIT_FAILURE;
+	}
+	return matched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,20 @@
+/*
+The stb_image implementation the benchmarks compare the native decoders with.
+
+SDL vendors stb_image but only compiles it with JPEG support for its own pixel
+format conversions, so the benchmarks compile their own copy with the formats
+the application supports. Note that SDL has patched the header to use SDL's
+types and to report errors through `SDL_SetError()`.
+*/
+#include <SDL3/SDL.h>
+
+#define STBI_ONLY_PNG
+#define STBI_ONLY_JPEG
+#define STBI_NO_STDIO  // Files are read through SDL's I/O functions instead.
+#define STBI_NO_LINEAR
+#define STBI_NO_HDR
+#define STBI_MALLOC SDL_malloc
+#define STBI_REALLOC SDL_realloc
+#define STBI_FREE SDL_free
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
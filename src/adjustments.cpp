@@ -0,0 +1,544 @@
+#include "adjustments.h"
+
+#include <SDL3/SDL_intrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "profiler.h"
+
+bool Adjustments::operator==(const Adjustments& other) const {
+	return exposure == other.exposure && black == other.black &&
+		   white == other.white && gamma == other.gamma &&
+		   shadows == other.shadows && midtones == other.midtones &&
+		   highlights == other.highlights && saturation == other.saturation &&
+		   sharpen == other.sharpen;
+}
+
+/*
+Tone curves, mapping [0, 1] to [0, 1].
+*/
+
+static float srgb_to_linear(float v) {
+	return v <= 0.04045f ? v / 12.92f
+						 : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float v) {
+	v = std::clamp(v, 0.0f, 1.0f);
+	return v <= 0.0031308f ? v * 12.92f
+						   : 1.055f * std::pow(v, 1 / 2.4f) - 0.055f;
+}
+
+/*
+A smooth curve through evenly spaced points, using the monotone cubic
+interpolation of Fritsch and Carlson so that it does not overshoot between
+them.
+*/
+static std::function<float(float)> smooth_curve(std::vector<float> points) {
+	const std::size_t count = points.size();
+	const auto step = 1.0f / static_cast<float>(count - 1);
+	std::vector<float> slopes(count - 1);
+	for (std::size_t k = 0; k + 1 < count; k++) {
+		slopes[k] = (points[k + 1] - points[k]) / step;
+	}
+	std::vector<float> tangents(count);
+	tangents[0] = slopes[0];
+	tangents[count - 1] = slopes[count - 2];
+	for (std::size_t k = 1; k + 1 < count; k++) {
+		tangents[k] = slopes[k - 1] * slopes[k] <= 0
+						  ? 0
+						  : (slopes[k - 1] + slopes[k]) / 2;
+	}
+	for (std::size_t k = 0; k + 1 < count; k++) {
+		if (slopes[k] == 0) {
+			tangents[k] = 0;
+			tangents[k + 1] = 0;
+			continue;
+		}
+		const float a = tangents[k] / slopes[k];
+		const float b = tangents[k + 1] / slopes[k];
+		const float length = std::sqrt(a * a + b * b);
+		if (length > 3) {
+			tangents[k] = 3 / length * a * slopes[k];
+			tangents[k + 1] = 3 / length * b * slopes[k];
+		}
+	}
+	return [points, tangents, step](float v) {
+		const float position = std::clamp(v, 0.0f, 1.0f) / step;
+		const std::size_t k = std::min(static_cast<std::size_t>(position),
+									   points.size() - 2);
+		const float t = position - static_cast<float>(k);
+		const float t2 = t * t;
+		const float t3 = t2 * t;
+		return (2 * t3 - 3 * t2 + 1) * points[k] +
+			   (t3 - 2 * t2 + t) * step * tangents[k] +
+			   (-2 * t3 + 3 * t2) * points[k + 1] +
+			   (t3 - t2) * step * tangents[k + 1];
+	};
+}
+
+std::vector<AdjustmentNode> AdjustmentGraph::nodes(
+	const Adjustments& adjustments) {
+	std::vector<AdjustmentNode> nodes;
+	if (adjustments.exposure != 0) {
+		const float gain = std::exp2(adjustments.exposure);
+		nodes.push_back(AdjustmentNode{
+			ADJUSTMENT_OPERATION_TONE,
+			[gain](float v) {
+				return linear_to_srgb(srgb_to_linear(v) * gain);
+			},
+			0});
+	}
+	if (adjustments.black != 0 || adjustments.white != 1 ||
+		adjustments.gamma != 1) {
+		const float black = adjustments.black;
+		const float range = std::max(adjustments.white - black, 1e-3f);
+		const float exponent = 1 / std::max(adjustments.gamma, 1e-3f);
+		nodes.push_back(AdjustmentNode{
+			ADJUSTMENT_OPERATION_TONE,
+			[black, range, exponent](float v) {
+				return std::pow(std::clamp((v - black) / range, 0.0f, 1.0f),
+								exponent);
+			},
+			0});
+	}
+	if (adjustments.shadows != 0 || adjustments.midtones != 0 ||
+		adjustments.highlights != 0) {
+		nodes.push_back(AdjustmentNode{
+			ADJUSTMENT_OPERATION_TONE,
+			smooth_curve({0, 0.25f + adjustments.shadows,
+						  0.5f + adjustments.midtones,
+						  0.75f + adjustments.highlights, 1}),
+			0});
+	}
+	if (adjustments.saturation != 1) {
+		nodes.push_back(AdjustmentNode{ADJUSTMENT_OPERATION_SATURATION, {},
+									   adjustments.saturation});
+	}
+	if (adjustments.sharpen != 0) {
+		nodes.push_back(AdjustmentNode{ADJUSTMENT_OPERATION_SHARPEN, {},
+									   adjustments.sharpen});
+	}
+	return nodes;
+}
+
+AdjustmentGraph::AdjustmentGraph() : halo{0} {}
+
+AdjustmentGraph::AdjustmentGraph(const Adjustments& adjustments,
+								 SDL_PixelFormat format)
+	: AdjustmentGraph(nodes(adjustments), format) {}
+
+// The index of the byte holding a channel in a pixel of a packed format.
+static int channel_byte(Uint8 shift) {
+	const int index = shift / 8;
+	return SDL_BYTEORDER == SDL_LIL_ENDIAN ? index : 3 - index;
+}
+
+AdjustmentGraph::AdjustmentGraph(const std::vector<AdjustmentNode>& nodes,
+								 SDL_PixelFormat format)
+	: halo{0} {
+	const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails(format);
+	if (details == nullptr) {
+		return;
+	}
+	const int red = channel_byte(details->Rshift);
+	const int green = channel_byte(details->Gshift);
+	const int blue = channel_byte(details->Bshift);
+	const int alpha = 6 - red - green - blue;
+
+	// Tone curves are composed in floating point, and only rounded to bytes
+	// once the whole pass is known.
+	std::vector<std::array<float, 256>> tones;
+	std::vector<float> amounts;
+	auto add_pass = [&](float saturation) {
+		passes.push_back(Pass{});
+		tones.emplace_back();
+		amounts.push_back(saturation);
+		for (int i = 0; i < 256; i++) {
+			tones.back()[i] = static_cast<float>(i) / 255;
+		}
+	};
+	for (const AdjustmentNode& node : nodes) {
+		const bool fusible = !passes.empty() && !passes.back().sharpen;
+		switch (node.operation) {
+			case ADJUSTMENT_OPERATION_TONE:
+				// Curves cannot be moved after a color mix.
+				if (!fusible || passes.back().mix) {
+					add_pass(1);
+				}
+				for (float& value : tones.back()) {
+					value = node.curve(value);
+				}
+				break;
+			case ADJUSTMENT_OPERATION_SATURATION:
+				// Mixing with the luma does not change the luma, so two
+				// mixes are one mix with the product of their amounts.
+				if (!fusible) {
+					add_pass(1);
+				}
+				passes.back().mix = true;
+				amounts.back() *= node.amount;
+				break;
+			case ADJUSTMENT_OPERATION_SHARPEN:
+				add_pass(node.amount);
+				passes.back().sharpen = true;
+				halo++;
+				break;
+		}
+	}
+
+	// Rec. 709 luma weights, applied to the gamma-encoded values.
+	std::array<Sint16, 4> luma{};
+	luma[red] = 3483;
+	luma[green] = 11718;
+	luma[blue] = 1183;
+	for (std::size_t p = 0; p < passes.size(); p++) {
+		Pass& pass = passes[p];
+		pass.alpha = alpha;
+		std::array<Sint16, 4> scaled{};
+		const float factor = pass.sharpen ? 1024 : 512;
+		for (int channel : {red, green, blue}) {
+			scaled[channel] = static_cast<Sint16>(std::clamp(
+				std::lround(amounts[p] * factor), -32768l, 32767l));
+		}
+		for (int i = 0; i < 8; i++) {
+			pass.luma[i] = luma[i % 4];
+			pass.factors[i] = scaled[i % 4];
+		}
+		if (pass.sharpen) {
+			continue;
+		}
+		for (int channel = 0; channel < 4; channel++) {
+			for (int i = 0; i < 256; i++) {
+				const float value =
+					channel == alpha ? static_cast<float>(i) / 255
+									 : tones[p][i];
+				pass.table[channel * 256 + i] = static_cast<Uint8>(
+					std::clamp(std::lround(value * 255), 0l, 255l));
+			}
+		}
+		pass.tone = false;
+		for (int i = 0; i < 4 * 256; i++) {
+			pass.tone = pass.tone || pass.table[i] != (i & 255);
+		}
+	}
+}
+
+/*
+Scalar versions of the passes.
+
+They compute exactly the same values as the SIMD versions, using the rounding
+of _mm_mulhrs_epi16 for the fixed-point products.
+*/
+
+static inline int multiply_round(int x, int y) {
+	return (x * y + 0x4000) >> 15;
+}
+
+static inline Uint8 clamp_byte(int value) {
+	return static_cast<Uint8>(std::clamp(value, 0, 255));
+}
+
+static void lookup_row(Uint8* row, int width, const Uint8* table) {
+	const std::size_t size = static_cast<std::size_t>(width) * 4;
+	for (std::size_t i = 0; i < size; i++) {
+		row[i] = table[(i & 3) * 256 + row[i]];
+	}
+}
+
+/*
+Move each color away from or towards its luma: `luma + factor * (color -
+luma)`, with Q14 luma weights and Q9 factors for each byte of a pixel.
+*/
+static void mix_row(Uint8* row, int width, const Sint16* luma,
+					const Sint16* factors, int alpha) {
+	for (int x = 0; x < width; x++) {
+		Uint8* pixel = row + static_cast<std::size_t>(x) * 4;
+		int sum = 0;
+		for (int i = 0; i < 4; i++) {
+			sum += luma[i] * pixel[i];
+		}
+		const int y = (sum + (1 << 13)) >> 14;
+		for (int i = 0; i < 4; i++) {
+			if (i != alpha) {
+				pixel[i] = clamp_byte(
+					y + multiply_round((pixel[i] - y) * 64, factors[i]));
+			}
+		}
+	}
+}
+
+/*
+Sharpen a row by adding the difference from a 3x3 binomial blur, scaled by Q10
+amounts for each byte of a pixel.
+
+@param above, row, below The input rows, one pixel wider on each side than the
+output.
+*/
+static void sharpen_row(const Uint8* above, const Uint8* row,
+						const Uint8* below, Uint8* out, int width,
+						const Sint16* amounts, std::size_t first) {
+	const std::size_t size = static_cast<std::size_t>(width) * 4;
+	for (std::size_t i = first; i < size; i++) {
+		const int left = above[i] + 2 * row[i] + below[i];
+		const int middle = above[i + 4] + 2 * row[i + 4] + below[i + 4];
+		const int right = above[i + 8] + 2 * row[i + 8] + below[i + 8];
+		const int blur = (left + 2 * middle + right + 8) >> 4;
+		const int center = row[i + 4];
+		out[i] = clamp_byte(center + multiply_round((center - blur) * 32,
+													amounts[i & 3]));
+	}
+}
+
+static void mix_row_scalar(Uint8* row, int width, const Sint16* luma,
+						   const Sint16* factors, int alpha) {
+	mix_row(row, width, luma, factors, alpha);
+}
+
+static void sharpen_row_scalar(const Uint8* above, const Uint8* row,
+							   const Uint8* below, Uint8* out, int width,
+							   const Sint16* amounts) {
+	sharpen_row(above, row, below, out, width, amounts, 0);
+}
+
+#ifdef SDL_SSE4_1_INTRINSICS
+/*
+SSE4.1 versions, working on 16-bit copies of the bytes of four pixels at a
+time.
+*/
+
+SDL_TARGETING("sse4.1")
+static void mix_row_sse41(Uint8* row, int width, const Sint16* luma,
+						  const Sint16* factors, int alpha) {
+	const __m128i weights =
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma));
+	const __m128i scales =
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(factors));
+	const __m128i half = _mm_set1_epi32(1 << 13);
+	const __m128i keep =
+		_mm_set1_epi32(static_cast<int>(0xffu << (alpha * 8)));
+	int x = 0;
+	for (; x + 4 <= width; x += 4) {
+		Uint8* p = row + static_cast<std::size_t>(x) * 4;
+		const __m128i pixels =
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		const __m128i low = _mm_cvtepu8_epi16(pixels);
+		const __m128i high = _mm_cvtepu8_epi16(_mm_srli_si128(pixels, 8));
+
+		// The luma of each pixel, repeated for each of its bytes.
+		__m128i y = _mm_hadd_epi32(_mm_madd_epi16(low, weights),
+								   _mm_madd_epi16(high, weights));
+		y = _mm_srai_epi32(_mm_add_epi32(y, half), 14);
+		y = _mm_packs_epi32(y, y);
+		y = _mm_unpacklo_epi16(y, y);
+		const __m128i y_low = _mm_unpacklo_epi32(y, y);
+		const __m128i y_high = _mm_unpackhi_epi32(y, y);
+
+		const __m128i mixed_low = _mm_add_epi16(
+			y_low,
+			_mm_mulhrs_epi16(_mm_slli_epi16(_mm_sub_epi16(low, y_low), 6),
+							 scales));
+		const __m128i mixed_high = _mm_add_epi16(
+			y_high,
+			_mm_mulhrs_epi16(_mm_slli_epi16(_mm_sub_epi16(high, y_high), 6),
+							 scales));
+		const __m128i mixed = _mm_packus_epi16(mixed_low, mixed_high);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+						 _mm_blendv_epi8(mixed, pixels, keep));
+	}
+	mix_row(row + static_cast<std::size_t>(x) * 4, width - x, luma, factors,
+			alpha);
+}
+
+// Load 8 bytes as 16-bit values.
+SDL_TARGETING("sse4.1")
+static inline __m128i load_wide(const Uint8* p) {
+	return _mm_cvtepu8_epi16(
+		_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+
+// Sharpen 8 bytes of the output, see `sharpen_row()`.
+SDL_TARGETING("sse4.1")
+static inline __m128i sharpen_8(const Uint8* above, const Uint8* row,
+								const Uint8* below, __m128i amounts) {
+	auto column = [&](std::size_t offset) {
+		return _mm_add_epi16(
+			_mm_add_epi16(load_wide(above + offset), load_wide(below + offset)),
+			_mm_slli_epi16(load_wide(row + offset), 1));
+	};
+	const __m128i left = column(0);
+	const __m128i middle = column(4);
+	const __m128i right = column(8);
+	const __m128i blur = _mm_srli_epi16(
+		_mm_add_epi16(_mm_add_epi16(left, right),
+					  _mm_add_epi16(_mm_slli_epi16(middle, 1),
+									_mm_set1_epi16(8))),
+		4);
+	const __m128i center = load_wide(row + 4);
+	return _mm_add_epi16(
+		center,
+		_mm_mulhrs_epi16(_mm_slli_epi16(_mm_sub_epi16(center, blur), 5),
+						 amounts));
+}
+
+SDL_TARGETING("sse4.1")
+static void sharpen_row_sse41(const Uint8* above, const Uint8* row,
+							  const Uint8* below, Uint8* out, int width,
+							  const Sint16* amounts) {
+	const __m128i scales =
+		_mm_loadu_si128(reinterpret_cast<const __m128i*>(amounts));
+	const std::size_t size = static_cast<std::size_t>(width) * 4;
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		const __m128i low = sharpen_8(above + i, row + i, below + i, scales);
+		const __m128i high =
+			sharpen_8(above + i + 8, row + i + 8, below + i + 8, scales);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+						 _mm_packus_epi16(low, high));
+	}
+	sharpen_row(above, row, below, out, width, amounts, i);
+}
+#endif	// SDL_SSE4_1_INTRINSICS
+
+namespace {
+
+// Pick the fastest versions the CPU supports.
+struct AdjustFunctions {
+	void (*mix)(Uint8* row, int width, const Sint16* luma,
+				const Sint16* factors, int alpha);
+	void (*sharpen)(const Uint8* above, const Uint8* row, const Uint8* below,
+					Uint8* out, int width, const Sint16* amounts);
+
+	AdjustFunctions() : mix{mix_row_scalar}, sharpen{sharpen_row_scalar} {
+#ifdef SDL_SSE4_1_INTRINSICS
+		if (SDL_HasSSE41()) {
+			mix = mix_row_sse41;
+			sharpen = sharpen_row_sse41;
+		}
+#endif
+	}
+};
+
+}  // namespace
+
+/*
+Process one block. The rows of the block go through the passes one stage at a
+time, where a stage is a sharpening pass (or reading the source for the first
+stage) followed by the per-pixel passes after it, which run on each row while
+it is still in the cache.
+
+@param area The block, in pixels of `source`.
+@param left, top Where the block goes in `destination`.
+*/
+void AdjustmentGraph::process_block(const SDL_Surface* source, int ready,
+									const SDL_Rect& area,
+									SDL_Surface* destination, int left,
+									int top) const {
+	static const AdjustFunctions functions;
+	thread_local std::vector<Uint8> buffers[2];
+
+	auto run_pixel_passes = [this](std::size_t& next, Uint8* row, int width) {
+		for (; next < passes.size() && !passes[next].sharpen; next++) {
+			const Pass& pass = passes[next];
+			if (pass.tone) {
+				lookup_row(row, width, pass.table.data());
+			}
+			if (pass.mix) {
+				functions.mix(row, width, pass.luma.data(),
+							  pass.factors.data(), pass.alpha);
+			}
+		}
+	};
+	auto output_row = [&](int y) {
+		return static_cast<Uint8*>(destination->pixels) +
+			   static_cast<std::size_t>(top + y) * destination->pitch +
+			   static_cast<std::size_t>(left) * 4;
+	};
+
+	// Read the block and the pixels around it needed for sharpening,
+	// repeating the edges of the readable part of the source.
+	int width = area.w + 2 * halo;
+	int height = area.h + 2 * halo;
+	std::size_t pitch = static_cast<std::size_t>(width) * 4;
+	if (halo > 0) {
+		buffers[0].resize(pitch * height);
+	}
+	const int x0 = area.x - halo;
+	const int y0 = area.y - halo;
+	const int inside_first = std::clamp(-x0, 0, width);
+	const int inside_end = std::clamp(source->w - x0, inside_first, width);
+	std::size_t next = 0;
+	for (int row = 0; row < height; row++) {
+		const int y = std::clamp(y0 + row, 0, ready - 1);
+		const Uint8* in = static_cast<const Uint8*>(source->pixels) +
+						  static_cast<std::size_t>(y) * source->pitch;
+		Uint8* out =
+			halo > 0 ? buffers[0].data() + row * pitch : output_row(row);
+		for (int x = 0; x < inside_first; x++) {
+			std::memcpy(out + x * 4, in, 4);
+		}
+		if (inside_end > inside_first) {
+			std::memcpy(
+				out + inside_first * 4,
+				in + static_cast<std::size_t>(x0 + inside_first) * 4,
+				static_cast<std::size_t>(inside_end - inside_first) * 4);
+		}
+		for (int x = inside_end; x < width; x++) {
+			std::memcpy(out + x * 4,
+						in + static_cast<std::size_t>(source->w - 1) * 4, 4);
+		}
+		std::size_t pass = 0;
+		run_pixel_passes(pass, out, width);
+		next = pass;
+	}
+
+	// Each sharpening pass shrinks the block by a pixel on every side.
+	int current = 0;
+	while (next < passes.size()) {
+		const Pass& pass = passes[next];
+		const int out_width = width - 2;
+		const int out_height = height - 2;
+		const std::size_t out_pitch = static_cast<std::size_t>(out_width) * 4;
+		const bool last = out_width == area.w;
+		if (!last) {
+			buffers[1 - current].resize(out_pitch * out_height);
+		}
+		const Uint8* in = buffers[current].data();
+		std::size_t after = next + 1;
+		for (int row = 0; row < out_height; row++) {
+			Uint8* out = last ? output_row(row)
+							  : buffers[1 - current].data() + row * out_pitch;
+			functions.sharpen(in + row * pitch, in + (row + 1) * pitch,
+							  in + (row + 2) * pitch, out, out_width,
+							  pass.factors.data());
+			after = next + 1;
+			run_pixel_passes(after, out, out_width);
+		}
+		next = after;
+		current = 1 - current;
+		width = out_width;
+		height = out_height;
+		pitch = out_pitch;
+	}
+}
+
+void AdjustmentGraph::apply(const SDL_Surface* source, int ready,
+							const SDL_Rect& area, SDL_Surface* destination,
+							TaskPool& pool) const {
+	ProfileScope profile(PROFILE_STAGE_ADJUST);
+	if (ready <= 0 || area.w <= 0 || area.h <= 0) {
+		return;
+	}
+	const int columns = (area.w + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const int rows = (area.h + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	pool.run(static_cast<std::size_t>(columns) * rows, [&](std::size_t i) {
+		const int left = static_cast<int>(i % columns) * BLOCK_SIZE;
+		const int top = static_cast<int>(i / columns) * BLOCK_SIZE;
+		const SDL_Rect block{area.x + left, area.y + top,
+							 std::min(BLOCK_SIZE, area.w - left),
+							 std::min(BLOCK_SIZE, area.h - top)};
+		process_block(source, ready, block, destination, left, top);
+	});
+}
@@ -0,0 +1,142 @@
+#ifndef SRC_ADJUSTMENTS_H_
+#define SRC_ADJUSTMENTS_H_
+
+#include <SDL3/SDL.h>
+
+#include <array>
+#include <functional>
+#include <vector>
+
+#include "task_pool.h"
+
+/*
+Non-destructive adjustments of an image, applied in the order of the members.
+The default values leave the image unchanged.
+*/
+struct Adjustments {
+	float exposure = 0;	 // In stops, applied in linear light.
+
+	// Levels: the input values mapped to black and white, and the gamma
+	// applied in between.
+	float black = 0;
+	float white = 1;
+	float gamma = 1;
+
+	// Curves: how far the tone curve is raised at a quarter, half and three
+	// quarters of the range.
+	float shadows = 0;
+	float midtones = 0;
+	float highlights = 0;
+
+	float saturation = 1;  // 0 is greyscale, 1 leaves colors unchanged.
+	float sharpen = 0;	   // Amount of unsharp masking.
+
+	bool operator==(const Adjustments& other) const;
+	bool operator!=(const Adjustments& other) const {
+		return !(*this == other);
+	}
+
+	bool is_identity() const { return *this == Adjustments{}; }
+};
+
+// The operations an adjustment graph is made of.
+enum AdjustmentOperation {
+	// Maps each color channel through the same curve.
+	ADJUSTMENT_OPERATION_TONE,
+	// Moves colors away from or towards their luma.
+	ADJUSTMENT_OPERATION_SATURATION,
+	// Unsharp masking with a 3x3 blur, the only operation looking at the
+	// neighbours of a pixel.
+	ADJUSTMENT_OPERATION_SHARPEN
+};
+
+// One operation of an adjustment graph.
+struct AdjustmentNode {
+	AdjustmentOperation operation;
+	std::function<float(float)> curve;	// For tone operations, maps [0, 1].
+	float amount = 0;  // The saturation or the amount of sharpening.
+};
+
+/*
+A chain of adjustment operations compiled into as few passes over the pixels
+as possible.
+
+Consecutive per-pixel operations are fused into a single pass: tone curves are
+composed into one lookup table and saturation changes are multiplied, so that
+exposure, levels, curves and saturation together cost one table lookup and
+one color mix per pixel. Only sharpening, which needs the neighbours of each
+pixel, takes a pass of its own.
+
+Images are processed in blocks small enough to stay in the cache, the rows of
+a block going through every pass before the next rows are read, and the color
+mix and sharpening use SSE4.1 when the CPU supports it.
+
+A graph is immutable once compiled and may be used by several threads at once.
+*/
+class AdjustmentGraph {
+   private:
+	// A per-pixel pass, looking up each byte of a pixel in a table if `tone`
+	// is set and then mixing colors with their luma if `mix` is set, or a
+	// sharpening pass. Values for each byte of a pixel are repeated for two
+	// pixels.
+	struct Pass {
+		bool sharpen;
+		bool tone;
+		bool mix;
+		int alpha;	// The byte holding alpha, which is left unchanged.
+		std::array<Uint8, 4 * 256> table;
+		std::array<Sint16, 8> luma;	 // Q14 weights of each byte in the luma.
+		std::array<Sint16, 8> factors;	// Q9 saturation, or Q10 amount of
+										// sharpening.
+	};
+
+	std::vector<Pass> passes;
+	int halo;  // The number of sharpening passes, which each need one more
+			   // pixel around the output.
+
+	void process_block(const SDL_Surface* source, int ready,
+					   const SDL_Rect& area, SDL_Surface* destination,
+					   int left, int top) const;
+
+   public:
+	// Width and height of the blocks processed by separate tasks.
+	static constexpr int BLOCK_SIZE = 128;
+
+	// A graph which leaves images unchanged.
+	AdjustmentGraph();
+
+	/*
+	Compile a graph.
+
+	@param nodes The operations, in the order they are applied.
+	@param format The pixel format of the images to process, which must be a
+	packed 32-bit format with 8 bits per channel.
+	*/
+	AdjustmentGraph(const std::vector<AdjustmentNode>& nodes,
+					SDL_PixelFormat format);
+
+	// Compile the graph of a set of adjustments.
+	AdjustmentGraph(const Adjustments& adjustments, SDL_PixelFormat format);
+
+	// The operations making up a set of adjustments, skipping those that
+	// leave the image unchanged.
+	static std::vector<AdjustmentNode> nodes(const Adjustments& adjustments);
+
+	bool is_identity() const { return passes.empty(); }
+
+	/*
+	Apply the graph to part of an image, in blocks run on a task pool.
+
+	@param source The image, in the pixel format the graph was compiled for.
+	@param ready The number of rows at the top of `source` which can be read.
+	@param area The part of `source` to process. It may extend past the edges
+	of the image or beyond `ready`, where the nearest pixel is repeated.
+	@param destination Receives the processed pixels, starting at its top left
+	corner. It must be at least as large as `area` and share the format of
+	`source`.
+	*/
+	void apply(const SDL_Surface* source, int ready, const SDL_Rect& area,
+			   SDL_Surface* destination, TaskPool& pool) const;
+};
+
+#endif	// SRC_ADJUSTMENTS_H_
@@ -0,0 +1,845 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+#include "image_loader.h"
+#include "jpeg_decoder.h"
+#include "jpeg_encoder.h"
+#include "mapped_file.h"
+#include "png_decoder.h"
+#include "png_encoder.h"
+#include "resampler.h"
+#include "task_pool.h"
+
+// The pixel format images are converted in, which the encoders read without
+// converting it first.
+static const SDL_PixelFormat BATCH_PIXEL_FORMAT = SDL_PIXELFORMAT_RGBA32;
+
+// Alignment of the surfaces carved out of an arena, a cache line.
+static const std::size_t ARENA_ALIGNMENT = 64;
+
+// Arenas grow in steps of this many bytes, so that images of slightly
+// different sizes reuse the same memory.
+static const std::size_t ARENA_GRANULARITY = std::size_t{1} << 20;
+
+// Room for the headers of an encoded image, on top of its pixels.
+static const std::size_t ENCODED_HEADER_SIZE = 1024;
+
+// The bytes per pixel charged for a JPEG image before it is encoded, more than
+// even noise takes at quality 100.
+static const std::size_t JPEG_BYTES_PER_PIXEL = 3;
+
+const char* const BATCH_USAGE =
+	"Usage: --batch --output <directory> [options] <files or directories>\n"
+	"  --format png|jpeg|bmp  Output format, jpeg by default.\n"
+	"  --size <pixels>        Longest side of the output, 0 keeps the size.\n"
+	"  --quality <1-100>      JPEG quality, 90 by default.\n"
+	"  --threads <count>      Worker threads, 0 for one per core.\n"
+	"  --memory <MiB>         Memory budget, 512 by default.\n"
+	"  --exposure <-4-4>, --black <0-0.5>, --white <0.5-1>, --gamma <0.25-4>,\n"
+	"  --shadows, --midtones, --highlights <-0.2-0.2>, --saturation <0-2>,\n"
+	"  --sharpen <0-4>        Adjustments, as in the Adjustments window.";
+
+namespace {
+
+// A command line option setting one of the adjustments, with the range of the
+// matching slider of the viewer.
+struct AdjustmentOption {
+	const char* name;
+	float Adjustments::*value;
+	float min;
+	float max;
+};
+
+}  // namespace
+
+static const std::array<AdjustmentOption, 9> ADJUSTMENT_OPTIONS = {{
+	{"--exposure", &Adjustments::exposure, -4, 4},
+	{"--black", &Adjustments::black, 0, 0.5f},
+	{"--white", &Adjustments::white, 0.5f, 1},
+	{"--gamma", &Adjustments::gamma, 0.25f, 4},
+	{"--shadows", &Adjustments::shadows, -0.2f, 0.2f},
+	{"--midtones", &Adjustments::midtones, -0.2f, 0.2f},
+	{"--highlights", &Adjustments::highlights, -0.2f, 0.2f},
+	{"--saturation", &Adjustments::saturation, 0, 2},
+	{"--sharpen", &Adjustments::sharpen, 0, 4},
+}};
+
+static bool parse_integer(const char* option, const char* text, Sint64 min,
+						  Sint64 max, Sint64& value) {
+	char* end = nullptr;
+	value = SDL_strtoll(text, &end, 10);
+	if (end == text || *end != '\0' || value < min || value > max) {
+		return SDL_SetError("Invalid value '%s' for %s, expected %" SDL_PRIs64
+							" to %" SDL_PRIs64,
+							text, option, min, max);
+	}
+	return true;
+}
+
+static bool parse_number(const char* option, const char* text, float min,
+						 float max, float& value) {
+	char* end = nullptr;
+	value = static_cast<float>(SDL_strtod(text, &end));
+	if (end == text || *end != '\0' || !(value >= min && value <= max)) {
+		return SDL_SetError("Invalid value '%s' for %s, expected %g to %g",
+							text, option, static_cast<double>(min),
+							static_cast<double>(max));
+	}
+	return true;
+}
+
+// Parse an option taking a value, other than an adjustment.
+static bool parse_option(const char* option, const char* value,
+						 BatchOptions& options) {
+	Sint64 number = 0;
+	if (SDL_strcmp(option, "--output") == 0) {
+		options.output = value;
+	} else if (SDL_strcmp(option, "--format") == 0) {
+		if (SDL_strcasecmp(value, "png") == 0) {
+			options.format = BATCH_FORMAT_PNG;
+		} else if (SDL_strcasecmp(value, "jpeg") == 0 ||
+				   SDL_strcasecmp(value, "jpg") == 0) {
+			options.format = BATCH_FORMAT_JPEG;
+		} else if (SDL_strcasecmp(value, "bmp") == 0) {
+			options.format = BATCH_FORMAT_BMP;
+		} else {
+			return SDL_SetError("Unknown format '%s'", value);
+		}
+	} else if (SDL_strcmp(option, "--size") == 0) {
+		if (!parse_integer(option, value, 0, 65535, number)) {
+			return false;
+		}
+		options.size = static_cast<int>(number);
+	} else if (SDL_strcmp(option, "--quality") == 0) {
+		if (!parse_integer(option, value, 1, 100, number)) {
+			return false;
+		}
+		options.quality = static_cast<int>(number);
+	} else if (SDL_strcmp(option, "--threads") == 0) {
+		if (!parse_integer(option, value, 0, 1024, number)) {
+			return false;
+		}
+		options.threads = static_cast<unsigned int>(number);
+	} else if (SDL_strcmp(option, "--memory") == 0) {
+		if (!parse_integer(option, value, 1, 1 << 20, number)) {
+			return false;
+		}
+		options.memory = static_cast<std::size_t>(number);
+	} else {
+		return SDL_SetError("Unknown option '%s'", option);
+	}
+	return true;
+}
+
+bool parse_batch_arguments(int argc, const char* const* argv,
+						   BatchOptions& options) {
+	for (int i = 0; i < argc; i++) {
+		const char* argument = argv[i];
+		if (SDL_strncmp(argument, "--", 2) != 0) {
+			options.inputs.emplace_back(argument);
+			continue;
+		}
+		if (i + 1 >= argc) {
+			return SDL_SetError("Missing value after %s", argument);
+		}
+		const char* value = argv[++i];
+		auto adjustment = std::find_if(
+			ADJUSTMENT_OPTIONS.begin(), ADJUSTMENT_OPTIONS.end(),
+			[argument](const AdjustmentOption& option) {
+				return SDL_strcmp(option.name, argument) == 0;
+			});
+		if (adjustment != ADJUSTMENT_OPTIONS.end()) {
+			if (!parse_number(argument, value, adjustment->min,
+							  adjustment->max,
+							  options.adjustments.*adjustment->value)) {
+				return false;
+			}
+		} else if (!parse_option(argument, value, options)) {
+			return false;
+		}
+	}
+	if (options.output.empty()) {
+		return SDL_SetError("No output directory given with --output");
+	}
+	if (options.inputs.empty()) {
+		return SDL_SetError("No images to convert");
+	}
+	return true;
+}
+
+static bool is_image_path(const char* path) {
+	const char* extension = SDL_strrchr(path, '.');
+	return extension != nullptr && (SDL_strcasecmp(extension, ".png") == 0 ||
+									SDL_strcasecmp(extension, ".jpg") == 0 ||
+									SDL_strcasecmp(extension, ".jpeg") == 0);
+}
+
+static SDL_EnumerationResult SDLCALL add_image_path(void* userdata,
+													const char* directory,
+													const char* name) {
+	if (is_image_path(name)) {
+		static_cast<std::vector<std::string>*>(userdata)->push_back(
+			std::string(directory) + name);
+	}
+	return SDL_ENUM_CONTINUE;
+}
+
+/*
+List the images to convert: files given as inputs, whatever their name, and
+the PNG and JPEG files in directories given as inputs, sorted by name. Images
+listed more than once are only converted once.
+
+@return `false` if an input does not exist, in which case `SDL_GetError()`
+describes the error.
+*/
+static bool list_images(const std::vector<std::string>& inputs,
+						std::vector<std::string>& paths) {
+	std::unordered_set<std::string> listed;
+	auto add = [&paths, &listed](const std::string& path) {
+		if (listed.insert(path).second) {
+			paths.push_back(path);
+		}
+	};
+	for (const std::string& input : inputs) {
+		SDL_PathInfo info;
+		if (!SDL_GetPathInfo(input.c_str(), &info)) {
+			return SDL_SetError("Cannot read '%s'", input.c_str());
+		}
+		if (info.type != SDL_PATHTYPE_DIRECTORY) {
+			add(input);
+			continue;
+		}
+		std::vector<std::string> images;
+		if (!SDL_EnumerateDirectory(input.c_str(), add_image_path, &images)) {
+			return false;
+		}
+		std::sort(images.begin(), images.end());
+		std::for_each(images.begin(), images.end(), add);
+	}
+	return true;
+}
+
+/*
+The paths the images are written to: their names in the output directory, with
+the extension of the output format. Images which would get the same name, e.g.
+`a/img.png` and `b/img.png`, or `photo.png` and `photo.jpg`, get a number after
+their name, as in `img-2.png`, rather than overwriting each other. Names are
+compared ignoring case, since the output may be on a case-insensitive file
+system.
+*/
+static std::vector<std::string> output_paths(
+	const BatchOptions& options, const std::vector<std::string>& paths) {
+	static const std::array<const char*, 3> EXTENSIONS = {".png", ".jpg",
+														  ".bmp"};
+	const std::string extension = EXTENSIONS[options.format];
+	std::unordered_set<std::string> taken;	// Lowercase names.
+	auto take = [&taken](const std::string& name) {
+		std::string key = name;
+		for (char& c : key) {
+			c = static_cast<char>(SDL_tolower(static_cast<unsigned char>(c)));
+		}
+		return taken.insert(key).second;
+	};
+
+	std::vector<std::string> outputs;
+	outputs.reserve(paths.size());
+	for (const std::string& path : paths) {
+		const std::size_t separator = path.find_last_of("/\\");
+		std::string stem = separator == std::string::npos
+							   ? path
+							   : path.substr(separator + 1);
+		const std::size_t dot = stem.rfind('.');
+		if (dot != std::string::npos && dot > 0) {
+			stem.erase(dot);
+		}
+		std::string name = stem + extension;
+		if (!take(name)) {
+			int number = 2;
+			do {
+				name = stem + "-" + std::to_string(number++) + extension;
+			} while (!take(name));
+			SDL_Log("Writing '%s' as %s, another image has the same name",
+					path.c_str(), name.c_str());
+		}
+		outputs.push_back(options.output + "/" + name);
+	}
+	return outputs;
+}
+
+namespace {
+
+/*
+A bounded queue passing work from one stage of a batch to the next. Producers
+wait while it is full and consumers while it is empty, so that a fast stage
+cannot run far ahead of a slow one.
+*/
+template <typename T>
+class BatchQueue {
+   private:
+	std::mutex mutex;
+	std::condition_variable not_full;
+	std::condition_variable not_empty;
+	std::deque<T> items;
+	std::size_t capacity;
+	bool closed;
+
+   public:
+	explicit BatchQueue(std::size_t capacity)
+		: capacity{std::max(capacity, std::size_t{1})}, closed{false} {}
+
+	void push(T item) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_full.wait(lock, [this] { return items.size() < capacity; });
+			items.push_back(std::move(item));
+		}
+		not_empty.notify_one();
+	}
+
+	/*
+	Wait for the next item.
+
+	@return `false` once the queue has been closed and emptied.
+	*/
+	bool pop(T& item) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_empty.wait(lock, [this] { return closed || !items.empty(); });
+			if (items.empty()) {
+				return false;
+			}
+			item = std::move(items.front());
+			items.pop_front();
+		}
+		not_full.notify_one();
+		return true;
+	}
+
+	// Tell consumers that nothing more will be pushed.
+	void close() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		not_empty.notify_all();
+	}
+};
+
+/*
+The memory a batch may have in flight, shared by its threads, and released
+once it has been freed. Memory is charged before it is allocated, using
+conservative estimates where its size is only known afterwards, so the budget
+bounds the memory of a batch except for a JPEG image larger than its estimate,
+which is charged once it has been encoded. The mapped input files and the small
+buffers of the adjustments are not charged.
+*/
+class MemoryBudget {
+   private:
+	std::mutex mutex;
+	std::condition_variable released;
+	std::size_t limit;
+	std::size_t used;
+	std::size_t waiting;  // Threads waiting in `acquire()`.
+
+   public:
+	explicit MemoryBudget(std::size_t limit)
+		: limit{limit}, used{0}, waiting{0} {}
+
+	/*
+	Wait until some memory fits in the budget and charge it. Memory larger than
+	the whole budget is granted once nothing else is charged, so that a single
+	huge image can still be converted.
+
+	Threads should release any memory they keep before waiting, otherwise
+	threads waiting for each other would never be woken up.
+	*/
+	void acquire(std::size_t bytes) {
+		std::unique_lock<std::mutex> lock(mutex);
+		waiting++;
+		released.wait(lock,
+					  [&] { return used + bytes <= limit || used == 0; });
+		waiting--;
+		used += bytes;
+	}
+
+	// Charge some memory if it fits in the budget without waiting.
+	bool try_acquire(std::size_t bytes) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (used + bytes > limit && used > 0) {
+			return false;
+		}
+		used += bytes;
+		return true;
+	}
+
+	// Charge memory which has already been allocated, even beyond the budget.
+	void charge(std::size_t bytes) {
+		std::lock_guard<std::mutex> lock(mutex);
+		used += bytes;
+	}
+
+	void release(std::size_t bytes) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			used -= bytes;
+		}
+		released.notify_all();
+	}
+
+	// Whether a thread is waiting for memory.
+	bool contended() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return waiting > 0;
+	}
+};
+
+/*
+Scratch memory of a worker thread, out of which the surfaces of one image at a
+time are carved by bumping an offset. The memory is kept from one image to the
+next, and only grows when an image needs more of it.
+*/
+class ScratchArena {
+   private:
+	MemoryBudget& budget;
+	Uint8* block;
+	std::size_t capacity;
+	std::size_t used;
+	std::vector<SDL_Surface*> surfaces;	 // Carved out of `block`.
+
+	static std::size_t align(std::size_t bytes) {
+		return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT *
+			   ARENA_ALIGNMENT;
+	}
+
+	// Destroy the surfaces, which does not free their pixels.
+	void clear() {
+		for (SDL_Surface* surface : surfaces) {
+			SDL_DestroySurface(surface);
+		}
+		surfaces.clear();
+		used = 0;
+	}
+
+   public:
+	explicit ScratchArena(MemoryBudget& budget)
+		: budget(budget), block{nullptr}, capacity{0}, used{0} {}
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	// The memory a surface takes out of an arena.
+	static std::size_t surface_size(int width, int height) {
+		return align(static_cast<std::size_t>(width) * 4) *
+			   static_cast<std::size_t>(height);
+	}
+
+	/*
+	Destroy the surfaces of the previous image and make room for new ones,
+	charging the memory budget for the arena if it has to grow and for memory
+	the caller allocates outside of it. Waiting for the budget frees the arena
+	first, so that workers never wait while keeping memory.
+
+	@param bytes The sum of the `surface_size()` of the surfaces to create.
+	@param extra Memory to charge besides the arena, which the caller has to
+	release once it has been freed.
+	@return `false` if the memory could not be allocated, in which case
+	`SDL_GetError()` describes the error and nothing has been charged.
+	*/
+	bool reserve(std::size_t bytes, std::size_t extra) {
+		clear();
+		if (bytes <= capacity && budget.try_acquire(extra)) {
+			return true;
+		}
+		trim(0);
+		const std::size_t size = (bytes + ARENA_GRANULARITY - 1) /
+								 ARENA_GRANULARITY * ARENA_GRANULARITY;
+		budget.acquire(size + extra);
+		block = static_cast<Uint8*>(SDL_aligned_alloc(ARENA_ALIGNMENT, size));
+		if (block == nullptr) {
+			budget.release(size + extra);
+			return false;
+		}
+		capacity = size;
+		return true;
+	}
+
+	/*
+	Create a surface in the reserved memory, which stays valid until the next
+	call to `reserve()` or `trim()`.
+
+	@return The surface, owned by the arena, or `nullptr` on failure, in which
+	case `SDL_GetError()` describes the error.
+	*/
+	SDL_Surface* create_surface(int width, int height, SDL_PixelFormat format) {
+		const std::size_t size = surface_size(width, height);
+		if (size > capacity - used) {
+			SDL_SetError("Not enough scratch memory reserved");
+			return nullptr;
+		}
+		SDL_Surface* surface = SDL_CreateSurfaceFrom(
+			width, height, format, block + used,
+			static_cast<int>(align(static_cast<std::size_t>(width) * 4)));
+		if (surface != nullptr) {
+			surfaces.push_back(surface);
+			used += size;
+		}
+		return surface;
+	}
+
+	// Destroy the surfaces, and free the memory if more than `keep` bytes are
+	// reserved.
+	void trim(std::size_t keep) {
+		clear();
+		if (capacity > keep) {
+			SDL_aligned_free(block);
+			budget.release(capacity);
+			block = nullptr;
+			capacity = 0;
+		}
+	}
+
+	~ScratchArena() { trim(0); }
+};
+
+// An image file opened by the reader thread, waiting for a worker.
+struct BatchInput {
+	std::string path;
+	std::string output;	 // Where the converted image goes.
+	std::unique_ptr<MappedFile> file;
+};
+
+// An encoded image waiting for the writer thread, charged to the budget.
+struct BatchOutput {
+	std::string path;
+	std::vector<Uint8> bytes;
+};
+
+// State shared by the threads converting a batch.
+struct BatchState {
+	const BatchOptions& options;
+	AdjustmentGraph graph;
+	MemoryBudget budget;
+	std::size_t arena_share;  // Memory an arena may keep between images.
+	BatchQueue<BatchInput> inputs;
+	BatchQueue<BatchOutput> outputs;
+	std::atomic<std::size_t> converted;
+	std::atomic<std::size_t> failed;
+
+	BatchState(const BatchOptions& options, unsigned int workers)
+		: options(options),
+		  graph(options.adjustments, BATCH_PIXEL_FORMAT),
+		  budget(options.memory << 20),
+		  arena_share{(options.memory << 20) / workers},
+		  inputs(workers),
+		  outputs(workers),
+		  converted{0},
+		  failed{0} {}
+};
+
+}  // namespace
+
+// Open the images ahead of the workers, asking the system to read them in the
+// background while the workers are busy with the previous ones.
+static void read_images(BatchState& state,
+						const std::vector<std::string>& paths,
+						const std::vector<std::string>& outputs) {
+	for (std::size_t i = 0; i < paths.size(); i++) {
+		const std::string& path = paths[i];
+		auto file = std::make_unique<MappedFile>();
+		if (!file->open(path.c_str())) {
+			SDL_Log("Failed to read '%s': %s", path.c_str(), SDL_GetError());
+			state.failed++;
+			continue;
+		}
+		file->prefetch();
+		state.inputs.push(BatchInput{path, outputs[i], std::move(file)});
+	}
+	state.inputs.close();
+}
+
+// The largest BMP file `SDL_SaveBMP_IO()` writes for an image of a given size,
+// with 32 bits per pixel.
+static std::size_t bmp_encoded_size_bound(int width, int height) {
+	return static_cast<std::size_t>(width) * static_cast<std::size_t>(height) *
+			   4 +
+		   ENCODED_HEADER_SIZE;
+}
+
+// Encode a surface as a BMP file.
+static bool encode_bmp(SDL_Surface* surface, std::vector<Uint8>& out) {
+	SDL_IOStream* stream = SDL_IOFromDynamicMem();
+	if (stream == nullptr) {
+		return false;
+	}
+	// Grow the stream once to the whole file instead of a KiB at a time.
+	SDL_SetNumberProperty(
+		SDL_GetIOProperties(stream), SDL_PROP_IOSTREAM_DYNAMIC_CHUNKSIZE_NUMBER,
+		static_cast<Sint64>(bmp_encoded_size_bound(surface->w, surface->h)));
+	const bool saved = SDL_SaveBMP_IO(surface, stream, false);
+	if (saved) {
+		const Uint8* bytes = static_cast<const Uint8*>(
+			SDL_GetPointerProperty(SDL_GetIOProperties(stream),
+								   SDL_PROP_IOSTREAM_DYNAMIC_MEMORY_POINTER,
+								   nullptr));
+		out.insert(out.end(), bytes,
+				   bytes + static_cast<std::size_t>(SDL_TellIO(stream)));
+	}
+	SDL_CloseIO(stream);
+	return saved;
+}
+
+// The most memory the decoder of an image allocates besides the surface it
+// decodes into, 0 if its header cannot be read and decoding fails anyway.
+static std::size_t decoder_memory(const MappedFile& file) {
+	std::size_t bytes = 0;
+	if (is_png(file.data(), file.size())) {
+		if (!get_png_decoder_memory(file.data(), file.size(), bytes)) {
+			return 0;
+		}
+	} else if (is_jpeg(file.data(), file.size())) {
+		if (!get_jpeg_decoder_memory(file.data(), file.size(), bytes)) {
+			return 0;
+		}
+	}
+	return bytes;
+}
+
+/*
+Estimate the encoded size of an image and the memory its encoder works in
+besides it. PNG and BMP files are bounded by their pixels and headers, JPEG
+files are estimated at `JPEG_BYTES_PER_PIXEL`. Shrinking the encoded image to
+its size copies it, which the working memory covers as well.
+*/
+static void estimate_encoding(BatchFormat format, int width, int height,
+							  std::size_t& encoded, std::size_t& working) {
+	const std::size_t pixels =
+		static_cast<std::size_t>(width) * static_cast<std::size_t>(height);
+	switch (format) {
+		case BATCH_FORMAT_PNG:
+			encoded = png_encoded_size_bound(width, height);
+			working = png_encoder_memory(width, height);
+			break;
+		case BATCH_FORMAT_JPEG:
+			encoded = pixels * JPEG_BYTES_PER_PIXEL + ENCODED_HEADER_SIZE;
+			working = jpeg_encoder_memory(width) + encoded;
+			break;
+		case BATCH_FORMAT_BMP:
+			// The stream the file is written to and a copy of the surface in
+			// the pixel format of the file.
+			encoded = bmp_encoded_size_bound(width, height);
+			working = encoded + pixels * 4;
+			break;
+	}
+}
+
+/*
+Decode, scale, adjust and encode an image, closing its file once it has been
+decoded.
+
+Besides the arena, the working memory of the decoder, the resampler and the
+encoder and the encoded image are charged to the budget as soon as the decoder
+has read the size of the image, before any of them is allocated. Once the image
+has been encoded, only its capacity stays charged, to be released by the
+writer.
+
+@return `false` on failure, in which case `SDL_GetError()` describes the error.
+*/
+static bool convert_image(BatchState& state, BatchInput& input,
+						  ScratchArena& arena, TaskPool& tasks,
+						  std::vector<Uint8>& bytes) {
+	const BatchOptions& options = state.options;
+	SDL_Surface* decoded = nullptr;
+	SDL_Surface* scaled = nullptr;
+	SDL_Surface* adjusted = nullptr;
+	const std::size_t decoding = decoder_memory(*input.file);
+	std::size_t encoded = 0;
+	std::size_t charged = 0;  // Charged on top of the arena.
+
+	// Every surface of the image comes from the arena, reserved in one go.
+	DecodeOutput output;
+	output.create = [&](int width, int height) -> SDL_Surface* {
+		int scaled_width = width;
+		int scaled_height = height;
+		const double longest = std::max(width, height);
+		if (options.size > 0 && longest > options.size) {
+			scaled_width = std::max(
+				static_cast<int>(std::lround(width * options.size / longest)),
+				1);
+			scaled_height = std::max(
+				static_cast<int>(std::lround(height * options.size / longest)),
+				1);
+		}
+		const bool scaling = scaled_width != width || scaled_height != height;
+		const std::size_t scaled_size =
+			ScratchArena::surface_size(scaled_width, scaled_height);
+		std::size_t working = 0;
+		estimate_encoding(options.format, scaled_width, scaled_height, encoded,
+						  working);
+		const std::size_t extra =
+			decoding + encoded + working +
+			(scaling ? resample_memory(width, height, scaled_width,
+									   scaled_height, RESAMPLE_FILTER_LANCZOS3)
+					 : 0);
+		if (!arena.reserve(ScratchArena::surface_size(width, height) +
+							   (scaling ? scaled_size : 0) +
+							   (state.graph.is_identity() ? 0 : scaled_size),
+						   extra)) {
+			return nullptr;
+		}
+		charged = extra;
+		decoded = arena.create_surface(width, height, BATCH_PIXEL_FORMAT);
+		scaled = scaling ? arena.create_surface(scaled_width, scaled_height,
+												BATCH_PIXEL_FORMAT)
+						 : decoded;
+		adjusted = state.graph.is_identity()
+					   ? scaled
+					   : arena.create_surface(scaled_width, scaled_height,
+											  BATCH_PIXEL_FORMAT);
+		return decoded != nullptr && scaled != nullptr && adjusted != nullptr
+				   ? decoded
+				   : nullptr;
+	};
+	const bool loaded = decode_file(input.path.c_str(), *input.file,
+									BATCH_PIXEL_FORMAT, output, options.size);
+	input.file.reset();
+	if (!loaded) {
+		state.budget.release(charged);
+		return false;
+	}
+	state.budget.release(decoding);
+	charged -= decoding;
+
+	bool converted =
+		scaled == decoded ||
+		resample(decoded, nullptr, scaled, RESAMPLE_FILTER_LANCZOS3);
+	if (converted && adjusted != scaled) {
+		state.graph.apply(scaled, scaled->h,
+						  SDL_Rect{0, 0, scaled->w, scaled->h}, adjusted,
+						  tasks);
+	}
+	if (converted) {
+		bytes.reserve(encoded);
+		switch (options.format) {
+			case BATCH_FORMAT_PNG:
+				converted = encode_png(adjusted, bytes);
+				break;
+			case BATCH_FORMAT_JPEG:
+				converted = encode_jpeg(adjusted, options.quality, bytes);
+				break;
+			case BATCH_FORMAT_BMP:
+				converted = encode_bmp(adjusted, bytes);
+				break;
+		}
+	}
+	if (!converted) {
+		state.budget.release(charged);
+		std::string reason = SDL_GetError();
+		SDL_SetError("Failed to convert '%s': %s", input.path.c_str(),
+					 reason.c_str());
+		return false;
+	}
+
+	// Keep the encoded image charged, and release the rest of the estimates.
+	bytes.shrink_to_fit();
+	if (bytes.capacity() <= charged) {
+		state.budget.release(charged - bytes.capacity());
+	} else {
+		state.budget.charge(bytes.capacity() - charged);
+	}
+	return true;
+}
+
+// Convert images until the reader has run out of them.
+static void convert_images(BatchState& state) {
+	ScratchArena arena(state.budget);
+	// Every core already has a worker, so adjustments run on the worker alone.
+	TaskPool tasks(0);
+	BatchInput input;
+	while (state.inputs.pop(input)) {
+		BatchOutput output;
+		output.path = std::move(input.output);
+		const bool converted =
+			convert_image(state, input, arena, tasks, output.bytes);
+
+		// Keep the arena for the next image, unless others are short of
+		// memory.
+		arena.trim(state.budget.contended() ? 0 : state.arena_share);
+		if (!converted) {
+			SDL_Log("%s", SDL_GetError());
+			state.failed++;
+			continue;
+		}
+		state.outputs.push(std::move(output));
+	}
+}
+
+// Write the encoded images as the workers finish them.
+static void write_images(BatchState& state) {
+	BatchOutput output;
+	while (state.outputs.pop(output)) {
+		if (SDL_SaveFile(output.path.c_str(), output.bytes.data(),
+						 output.bytes.size())) {
+			state.converted++;
+		} else {
+			SDL_Log("Failed to write '%s': %s", output.path.c_str(),
+					SDL_GetError());
+			state.failed++;
+		}
+		const std::size_t size = output.bytes.capacity();
+		output.bytes = std::vector<Uint8>();
+		state.budget.release(size);
+	}
+}
+
+bool run_batch(const BatchOptions& options) {
+	std::vector<std::string> paths;
+	if (!list_images(options.inputs, paths)) {
+		SDL_Log("%s", SDL_GetError());
+		return false;
+	}
+	if (!SDL_CreateDirectory(options.output.c_str())) {
+		SDL_Log("Failed to create '%s': %s", options.output.c_str(),
+				SDL_GetError());
+		return false;
+	}
+
+	const unsigned int workers =
+		options.threads > 0
+			? options.threads
+			: static_cast<unsigned int>(
+				  std::max(SDL_GetNumLogicalCPUCores(), 1));
+	BatchState state(options, workers);
+	const std::vector<std::string> outputs = output_paths(options, paths);
+	const Uint64 start = SDL_GetTicks();
+	std::thread reader(read_images, std::ref(state), std::cref(paths),
+					   std::cref(outputs));
+	std::thread writer(write_images, std::ref(state));
+	std::vector<std::thread> threads;
+	threads.reserve(workers);
+	for (unsigned int i = 0; i < workers; i++) {
+		threads.emplace_back(convert_images, std::ref(state));
+	}
+	reader.join();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	state.outputs.close();
+	writer.join();
+
+	SDL_Log("Converted %zu of %zu images in %.2f s with %u workers.",
+			state.converted.load(), paths.size(),
+			static_cast<double>(SDL_GetTicks() - start) / 1000, workers);
+	return state.failed.load() == 0;
+}
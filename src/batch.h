@@ -0,0 +1,73 @@
+#ifndef SRC_BATCH_H_
+#define SRC_BATCH_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "adjustments.h"
+
+// File formats batch conversion can write.
+enum BatchFormat { BATCH_FORMAT_PNG, BATCH_FORMAT_JPEG, BATCH_FORMAT_BMP };
+
+// What to convert and how, see `parse_batch_arguments()`.
+struct BatchOptions {
+	std::vector<std::string> inputs;  // Image files, or directories whose PNG
+									  // and JPEG files are converted.
+	std::string output;	 // The directory the converted images are written to.
+	BatchFormat format = BATCH_FORMAT_JPEG;
+	int size = 0;  // The longest side of the converted images, which are never
+				   // enlarged. 0 keeps their size.
+	int quality = 90;  // JPEG quality, from 1 to 100.
+	Adjustments adjustments;
+	unsigned int threads = 0;  // Number of workers, 0 for one per core.
+	std::size_t memory = 512;  // Memory budget in MiB, see `run_batch()`.
+};
+
+// Usage of the batch mode's arguments, for printing after a parse error.
+extern const char* const BATCH_USAGE;
+
+/*
+Parse the arguments of the batch mode, e.g.
+`--output out --size 1600 --format jpeg --sharpen 0.5 photos/`.
+
+@param argc The number of arguments, not counting the program name and the
+`--batch` flag selecting the mode.
+@return `false` if an argument is invalid, in which case `SDL_GetError()`
+describes the error.
+*/
+bool parse_batch_arguments(int argc, const char* const* argv,
+						   BatchOptions& options);
+
+/*
+Convert images without a window, using the decoders, resampler, adjustments
+and encoders of the viewer.
+
+Every worker thread takes one image at a time through the whole pipeline:
+JPEG images are decoded at the smallest scale still covering the output size,
+scaled down with `RESAMPLE_FILTER_LANCZOS3`, adjusted and encoded. Adjusting
+after scaling keeps sharpening at the resolution the images are viewed at.
+A reader thread opens and prefetches the next files while the workers decode,
+and a writer thread saves the encoded images, so the disk and the CPU stay
+busy at the same time.
+
+Each worker carves its surfaces out of an arena, reserved once the size of an
+image is known and kept for the next image, so converting many images does
+not keep allocating and freeing large buffers. Along with its arena, a worker
+charges the memory budget for conservative estimates of the working memory of
+the decoder, the resampler and the encoder and of the encoded image, waiting
+for the budget unless nothing else is in flight. What the encoded image does
+not take is released once it has been encoded, and the rest once it has been
+written. The budget thus bounds the memory of a batch, except for the mapped
+input files, the small buffers of the adjustments and JPEG images above 3 bytes
+per pixel, which are charged once they have been encoded.
+
+Errors are logged and the remaining images are still converted.
+
+@return `true` if every image was converted.
+*/
+bool run_batch(const BatchOptions& options);
+
+#endif	// SRC_BATCH_H_
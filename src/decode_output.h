@@ -0,0 +1,32 @@
+#ifndef SRC_DECODE_OUTPUT_H_
+#define SRC_DECODE_OUTPUT_H_
+
+#include <SDL3/SDL.h>
+
+#include <functional>
+
+/*
+Where a decoder writes the pixels of an image, and whom it tells about its
+progress, so that an image can be displayed while it is being decoded.
+*/
+struct DecodeOutput {
+	/*
+	Called once the size of the image is known.
+
+	@return The surface the image is decoded into, which stays owned by the
+	caller, or `nullptr` to stop decoding (in which case `SDL_GetError()` should
+	describe why).
+	*/
+	std::function<SDL_Surface*(int width, int height)> create;
+
+	/*
+	Called whenever more rows are final, may be empty. Once decoding has
+	succeeded, all rows are final even if they were not reported.
+
+	@param rows The number of rows at the top of the surface which are final.
+	@return `false` to stop decoding.
+	*/
+	std::function<bool(int rows)> progress;
+};
+
+#endif	// SRC_DECODE_OUTPUT_H_
@@ -0,0 +1,181 @@
+#include "decode_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "image_loader.h"
+#include "profiler.h"
+
+// Number of finished jobs that may wait for the main thread at once. Workers
+// back off if the main thread falls this far behind.
+static const std::size_t FINISHED_CAPACITY = 256;
+
+DecodePool::DecodePool(unsigned int thread_count, SDL_PixelFormat format,
+					   std::function<void()> wake)
+	: next_id{1},
+	  next_sequence{0},
+	  stopping{false},
+	  finished(FINISHED_CAPACITY),
+	  format{format},
+	  wake(std::move(wake)) {
+	thread_count = std::max(thread_count, 1u);
+	workers.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		workers.emplace_back(&DecodePool::work, this);
+	}
+}
+
+std::uint64_t DecodePool::submit(const std::string& path,
+								 DecodePriority priority) {
+	auto job = std::make_shared<Job>();
+	job->path = path;
+	job->priority = priority;
+	job->started = false;
+	job->cancelled.store(false);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job->id = next_id++;
+		jobs.emplace(job->id, job);
+		pending.push(PendingEntry{priority, next_sequence++, job});
+	}
+	work_available.notify_one();
+	return job->id;
+}
+
+void DecodePool::set_priority(std::uint64_t job, DecodePriority priority) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = jobs.find(job);
+	if (it == jobs.end() || it->second->started ||
+		it->second->priority == priority) {
+		return;
+	}
+	// The old heap entry becomes stale, see `PendingEntry`.
+	it->second->priority = priority;
+	pending.push(PendingEntry{priority, next_sequence++, it->second});
+}
+
+void DecodePool::cancel(std::uint64_t job) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = jobs.find(job);
+	if (it != jobs.end()) {
+		it->second->cancelled.store(true);
+		jobs.erase(it);
+	}
+}
+
+void DecodePool::cancel_all() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& [id, job] : jobs) {
+		job->cancelled.store(true);
+	}
+	jobs.clear();
+	pending = {};
+}
+
+bool DecodePool::poll(DecodeResult& result) { return finished.try_pop(result); }
+
+void DecodePool::work() {
+	for (;;) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (job == nullptr) {
+				work_available.wait(
+					lock, [this] { return stopping || !pending.empty(); });
+				if (stopping) {
+					return;
+				}
+				PendingEntry entry = pending.top();
+				pending.pop();
+				if (!entry.job->cancelled.load() && !entry.job->started &&
+					entry.priority == entry.job->priority) {
+					job = std::move(entry.job);
+					job->started = true;
+				}
+			}
+		}
+
+		// The image is handed over as soon as its size is known, and its rows
+		// are published as they are decoded.
+		std::shared_ptr<ImagePyramid> image;
+		DecodeOutput output;
+		output.create = [this, &job, &image](int width,
+											 int height) -> SDL_Surface* {
+			image = ImagePyramid::create(width, height, format);
+			if (image == nullptr) {
+				return nullptr;
+			}
+			DecodeResult started;
+			started.job = job->id;
+			started.image = image;
+			if (!deliver(*job, started)) {
+				SDL_SetError("Decoding was cancelled");
+				return nullptr;
+			}
+			return image->image();
+		};
+		output.progress = [&job, &image](int rows) {
+			image->publish(rows);
+			return !job->cancelled.load();
+		};
+
+		DecodeResult result;
+		result.job = job->id;
+		result.finished = true;
+		bool loaded = false;
+		{
+			ProfileScope profile(PROFILE_STAGE_DECODE);
+			loaded = load_image(job->path.c_str(), format, output);
+		}
+		if (loaded) {
+			image->publish(image->height());
+			result.image = std::move(image);
+		} else {
+			result.error = SDL_GetError();
+		}
+		deliver(*job, result);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.erase(job->id);
+	}
+}
+
+/*
+Hand a result over to the main thread unless nobody wants it anymore, backing
+off while the queue is full.
+
+@return `true` if the result was delivered.
+*/
+bool DecodePool::deliver(const Job& job, DecodeResult& result) {
+	while (!job.cancelled.load()) {
+		if (finished.try_push(result)) {
+			if (wake) {
+				wake();
+			}
+			return true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping) {
+				return false;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+DecodePool::~DecodePool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		for (auto& [id, job] : jobs) {
+			job->cancelled.store(true);
+		}
+	}
+	work_available.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
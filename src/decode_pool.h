@@ -0,0 +1,142 @@
+#ifndef SRC_DECODE_POOL_H_
+#define SRC_DECODE_POOL_H_
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "image_pyramid.h"
+#include "ring_queue.h"
+
+// Priorities of decode jobs, jobs with a higher priority are started first.
+enum DecodePriority {
+	DECODE_PRIORITY_PREFETCH,  // Images the user is likely to look at soon.
+	DECODE_PRIORITY_VISIBLE	   // The image that is currently being viewed.
+};
+
+/*
+Progress of a decode job. Every job produces a result once the size of its
+image is known, which lets the image be displayed while it is being decoded,
+and a final result once decoding has succeeded or failed.
+*/
+struct DecodeResult {
+	std::uint64_t job = 0;	// Identifier returned by `DecodePool::submit()`.
+	bool finished = false;	// Whether this is the final result of the job.
+	std::shared_ptr<ImagePyramid> image;  // The image being decoded, which is
+										  // `nullptr` if decoding failed.
+	std::string error;	// Describes why decoding failed, if it did.
+};
+
+/*
+A pool of worker threads decoding image files in the background. Workers also
+build the mip levels of every image as its rows are decoded, so that the main
+thread only has to upload tiles.
+
+Jobs may be submitted, reprioritized and cancelled from any thread, but
+finished jobs should only be collected by a single thread (the main thread)
+using `poll()`. Finished images are handed over through a lock-free queue, so
+polling never blocks on the workers.
+*/
+class DecodePool {
+   private:
+	struct Job {
+		std::uint64_t id;
+		std::string path;
+		DecodePriority priority;	  // Guarded by `mutex`.
+		bool started;				  // Guarded by `mutex`.
+		std::atomic<bool> cancelled;  // May be read without `mutex`.
+	};
+
+	// Entry in the pending job heap. Changing the priority of a job pushes a
+	// new entry, so entries whose priority does not match the job, or whose
+	// job has been started, are stale and skipped by the workers.
+	struct PendingEntry {
+		DecodePriority priority;
+		std::uint64_t sequence;	 // Submission order, lower is older.
+		std::shared_ptr<Job> job;
+
+		bool operator<(const PendingEntry& other) const {
+			if (priority != other.priority) {
+				return priority < other.priority;
+			}
+			return sequence > other.sequence;
+		}
+	};
+
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::priority_queue<PendingEntry> pending;
+	std::unordered_map<std::uint64_t, std::shared_ptr<Job>>
+		jobs;  // Jobs that are either pending or being decoded.
+	std::uint64_t next_id;
+	std::uint64_t next_sequence;
+	bool stopping;
+	std::vector<std::thread> workers;
+	RingQueue<DecodeResult> finished;
+	SDL_PixelFormat format;
+	std::function<void()> wake;
+
+	void work();
+	bool deliver(const Job& job, DecodeResult& result);
+
+   public:
+	/*
+	Start the worker threads.
+
+	@param thread_count The number of worker threads, at least one thread is
+	always started.
+	@param format The pixel format of decoded surfaces, see `load_image()`.
+	@param wake Called from a worker thread whenever a result is ready to be
+	polled, e.g. to wake up an event loop waiting for input. May be empty.
+	*/
+	DecodePool(unsigned int thread_count, SDL_PixelFormat format,
+			   std::function<void()> wake = nullptr);
+
+	DecodePool(const DecodePool&) = delete;
+	DecodePool& operator=(const DecodePool&) = delete;
+
+	/*
+	Queue an image file for decoding.
+
+	@return An identifier for the job, which is never 0.
+	*/
+	std::uint64_t submit(const std::string& path, DecodePriority priority);
+
+	/*
+	Change the priority of a job. Has no effect if the job has already been
+	started, finished or cancelled.
+	*/
+	void set_priority(std::uint64_t job, DecodePriority priority);
+
+	/*
+	Cancel a job. A pending job is never started, and a job that is being
+	decoded stops at the next row and returns no further results.
+	*/
+	void cancel(std::uint64_t job);
+
+	// Cancel all pending and running jobs.
+	void cancel_all();
+
+	/*
+	Collect the progress of a job without blocking.
+
+	@return `true` if `result` was filled in, `false` if no job has made
+	progress since the last call.
+	*/
+	bool poll(DecodeResult& result);
+
+	// Cancel all jobs and wait for the worker threads to exit.
+	~DecodePool();
+};
+
+#endif	// SRC_DECODE_POOL_H_
@@ -0,0 +1,263 @@
+#include "deflate.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+static const std::size_t WINDOW_SIZE = 32768;
+static const std::size_t MIN_MATCH = 3;
+static const std::size_t MAX_MATCH = 258;
+static const unsigned int HASH_BITS = 15;
+
+// How many earlier positions with the same hash are tried for every match.
+// Longer chains find longer matches but take more time.
+static const unsigned int MAX_CHAIN = 32;
+
+static const std::size_t NO_POSITION = SIZE_MAX;
+
+namespace {
+
+// A Huffman code with its bits reversed, ready to be written LSB first.
+struct Code {
+	std::uint16_t bits;
+	std::uint8_t length;
+};
+
+// Fixed Huffman codes and the tables mapping lengths and distances to
+// symbols and extra bits.
+struct FixedCodes {
+	std::array<Code, 288> literal;
+	std::array<Code, 30> distance;
+	std::array<std::uint8_t, MAX_MATCH + 1> length_symbol;	// Minus 257.
+	std::array<std::uint8_t, WINDOW_SIZE + 1> distance_symbol;
+
+	std::array<std::uint16_t, 29> length_base;
+	std::array<std::uint8_t, 29> length_extra;
+	std::array<std::uint16_t, 30> distance_base;
+	std::array<std::uint8_t, 30> distance_extra;
+
+	static Code reversed(unsigned int code, unsigned int length) {
+		unsigned int bits = 0;
+		for (unsigned int i = 0; i < length; i++) {
+			bits = (bits << 1) | ((code >> i) & 1);
+		}
+		return Code{static_cast<std::uint16_t>(bits),
+					static_cast<std::uint8_t>(length)};
+	}
+
+	FixedCodes()
+		: literal{},
+		  distance{},
+		  length_symbol{},
+		  distance_symbol{},
+		  length_base{3,  4,  5,	6,	 7,	  8,   9,	10,	 11, 13,
+					  15, 17, 19,	23,	 27,  31,  35,	43,	 51, 59,
+					  67, 83, 99,	115, 131, 163, 195, 227, 258},
+		  length_extra{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+					   2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0},
+		  distance_base{1,	  2,	3,	  4,	5,	  7,	9,	  13,
+						17,	  25,	33,	  49,	65,	  97,	129,  193,
+						257,  385,	513,  769,	1025, 1537, 2049, 3073,
+						4097, 6145, 8193, 12289, 16385, 24577},
+		  distance_extra{0, 0, 0, 0, 1, 1, 2,  2,  3,	3,	4,	4,	5,	5,	6,
+						 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13} {
+		for (unsigned int i = 0; i < 288; i++) {
+			if (i < 144) {
+				literal[i] = reversed(0x30 + i, 8);
+			} else if (i < 256) {
+				literal[i] = reversed(0x190 + i - 144, 9);
+			} else if (i < 280) {
+				literal[i] = reversed(i - 256, 7);
+			} else {
+				literal[i] = reversed(0xc0 + i - 280, 8);
+			}
+		}
+		for (unsigned int i = 0; i < 30; i++) {
+			distance[i] = reversed(i, 5);
+		}
+		for (unsigned int i = 0; i < 29; i++) {
+			unsigned int end =
+				i == 28 ? MAX_MATCH + 1
+						: length_base[i] + (1u << length_extra[i]);
+			for (unsigned int length = length_base[i]; length < end; length++) {
+				length_symbol[length] = static_cast<std::uint8_t>(i);
+			}
+		}
+		// Length 258 has a symbol of its own, even though 284 could encode it.
+		length_symbol[MAX_MATCH] = 28;
+		for (unsigned int i = 0; i < 30; i++) {
+			unsigned int end = distance_base[i] + (1u << distance_extra[i]);
+			for (unsigned int d = distance_base[i]; d < end && d <= WINDOW_SIZE;
+				 d++) {
+				distance_symbol[d] = static_cast<std::uint8_t>(i);
+			}
+		}
+	}
+};
+
+// Writes bits least significant bit first, as DEFLATE expects.
+class BitWriter {
+   private:
+	std::vector<Uint8>& out;
+	std::uint64_t bits;
+	unsigned int count;
+
+   public:
+	explicit BitWriter(std::vector<Uint8>& out) : out(out), bits{0}, count{0} {}
+
+	void put(std::uint32_t value, unsigned int length) {
+		bits |= static_cast<std::uint64_t>(value) << count;
+		count += length;
+		while (count >= 8) {
+			out.push_back(static_cast<Uint8>(bits));
+			bits >>= 8;
+			count -= 8;
+		}
+	}
+
+	void flush() {
+		if (count > 0) {
+			out.push_back(static_cast<Uint8>(bits));
+			bits = 0;
+			count = 0;
+		}
+	}
+};
+
+}  // namespace
+
+static std::uint32_t adler32(const Uint8* data, std::size_t size) {
+	// The largest number of bytes that can be summed before the sums must be
+	// reduced to avoid overflowing 32 bits.
+	static const std::size_t BLOCK = 5552;
+	std::uint32_t a = 1;
+	std::uint32_t b = 0;
+	while (size > 0) {
+		std::size_t block = std::min(size, BLOCK);
+		for (std::size_t i = 0; i < block; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += block;
+		size -= block;
+	}
+	return (b << 16) | a;
+}
+
+static inline std::uint32_t hash(const Uint8* p) {
+	std::uint32_t value = (static_cast<std::uint32_t>(p[0]) << 16) |
+						  (static_cast<std::uint32_t>(p[1]) << 8) | p[2];
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+std::size_t zlib_compress_bound(std::size_t size) {
+	// A literal takes at most 9 bits, and every match at most 25 bits per 3
+	// bytes, so nothing is encoded in more than 9 bits per byte. The header,
+	// the block header, the end of block code and the checksum add the rest.
+	return size + size / 8 + 16;
+}
+
+std::size_t zlib_compress_memory(std::size_t size) {
+	return zlib_compress_bound(size) +
+		   ((std::size_t{1} << HASH_BITS) + WINDOW_SIZE) * sizeof(std::size_t);
+}
+
+void zlib_compress(const Uint8* data, std::size_t size,
+				   std::vector<Uint8>& out) {
+	static const FixedCodes codes;
+	out.reserve(out.size() + zlib_compress_bound(size));
+
+	// zlib header: DEFLATE with a 32 KiB window, fastest compression level.
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	BitWriter writer(out);
+	writer.put(1, 1);  // Final block.
+	writer.put(1, 2);  // Fixed Huffman codes.
+
+	std::vector<std::size_t> head(std::size_t{1} << HASH_BITS, NO_POSITION);
+	std::vector<std::size_t> previous(WINDOW_SIZE, NO_POSITION);
+	auto insert = [&](std::size_t position) {
+		std::uint32_t h = hash(data + position);
+		previous[position & (WINDOW_SIZE - 1)] = head[h];
+		head[h] = position;
+	};
+
+	std::size_t i = 0;
+	while (i < size) {
+		std::size_t best_length = 0;
+		std::size_t best_distance = 0;
+		if (size - i >= MIN_MATCH) {
+			const std::size_t max_length = std::min(MAX_MATCH, size - i);
+			std::size_t candidate = head[hash(data + i)];
+			for (unsigned int chain = 0;
+				 chain < MAX_CHAIN && candidate != NO_POSITION &&
+				 i - candidate <= WINDOW_SIZE;
+				 chain++) {
+				// Check the byte that would make the match longer first.
+				if (data[candidate + best_length] == data[i + best_length]) {
+					std::size_t length = 0;
+					while (length < max_length &&
+						   data[candidate + length] == data[i + length]) {
+						length++;
+					}
+					if (length > best_length) {
+						best_length = length;
+						best_distance = i - candidate;
+						if (length == max_length) {
+							break;
+						}
+					}
+				}
+				// Entries are overwritten once they leave the window, so make
+				// sure the chain keeps going backwards.
+				std::size_t next = previous[candidate & (WINDOW_SIZE - 1)];
+				if (next == NO_POSITION || next >= candidate) {
+					break;
+				}
+				candidate = next;
+			}
+			insert(i);
+		}
+
+		if (best_length < MIN_MATCH) {
+			const Code& code = codes.literal[data[i]];
+			writer.put(code.bits, code.length);
+			i++;
+			continue;
+		}
+
+		unsigned int symbol = codes.length_symbol[best_length];
+		const Code& length_code = codes.literal[257 + symbol];
+		writer.put(length_code.bits, length_code.length);
+		writer.put(static_cast<std::uint32_t>(best_length -
+											  codes.length_base[symbol]),
+				   codes.length_extra[symbol]);
+		symbol = codes.distance_symbol[best_distance];
+		const Code& distance_code = codes.distance[symbol];
+		writer.put(distance_code.bits, distance_code.length);
+		writer.put(static_cast<std::uint32_t>(best_distance -
+											  codes.distance_base[symbol]),
+				   codes.distance_extra[symbol]);
+
+		// Make the positions inside the match available for later matches.
+		for (std::size_t j = i + 1; j < i + best_length; j++) {
+			if (size - j >= MIN_MATCH) {
+				insert(j);
+			}
+		}
+		i += best_length;
+	}
+
+	const Code& end = codes.literal[256];
+	writer.put(end.bits, end.length);
+	writer.flush();
+
+	std::uint32_t checksum = adler32(data, size);
+	out.push_back(static_cast<Uint8>(checksum >> 24));
+	out.push_back(static_cast<Uint8>(checksum >> 16));
+	out.push_back(static_cast<Uint8>(checksum >> 8));
+	out.push_back(static_cast<Uint8>(checksum));
+}
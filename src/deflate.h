@@ -0,0 +1,34 @@
+#ifndef SRC_DEFLATE_H_
+#define SRC_DEFLATE_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <vector>
+
+/*
+Compress data into a zlib (RFC 1950) stream.
+
+Matches are found greedily using hash chains of limited length and encoded with
+the fixed Huffman codes of DEFLATE. This favors speed and simplicity over
+compression ratio, which is a reasonable trade-off for the images the
+application writes.
+
+@param data The data to compress.
+@param size The number of bytes at `data`.
+@param out The compressed stream is appended to this vector, which is grown
+once to `zlib_compress_bound()` more bytes.
+*/
+void zlib_compress(const Uint8* data, std::size_t size,
+				   std::vector<Uint8>& out);
+
+// The largest number of bytes `zlib_compress()` appends for `size` bytes.
+std::size_t zlib_compress_bound(std::size_t size);
+
+/*
+The most memory `zlib_compress()` allocates for `size` bytes, counting the
+room it reserves in `out` and its hash chains.
+*/
+std::size_t zlib_compress_memory(std::size_t size);
+
+#endif	// SRC_DEFLATE_H_
@@ -0,0 +1,196 @@
+#include "gallery.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "pixel_packing.h"
+
+Gallery::Gallery(SDL_Renderer* renderer, unsigned int thread_count,
+				 std::string directory, std::function<void()> wake)
+	: atlas(renderer),
+	  pool(thread_count, ThumbnailAtlas::SLOT_SIZE,
+		   texture_format(renderer), std::move(directory), std::move(wake)),
+	  frame{0},
+	  results_left{false} {}
+
+void Gallery::clear() {
+	pool.cancel_all();
+	atlas.clear();
+	entries.clear();
+	job_entries.clear();
+}
+
+void Gallery::open(const std::vector<std::string>& paths) {
+	clear();
+	entries.reserve(paths.size());
+	for (const std::string& path : paths) {
+		Entry entry;
+		entry.path = path;
+		std::size_t separator = path.find_last_of("/\\");
+		entry.name = separator == std::string::npos
+						 ? path
+						 : path.substr(separator + 1);
+		entries.push_back(std::move(entry));
+	}
+}
+
+bool Gallery::update() {
+	atlas.begin_frame();
+	frame++;
+
+	bool changed = false;
+	ThumbnailResult result;
+	int uploads = 0;
+	while (uploads < UPLOADS_PER_FRAME && pool.poll(result)) {
+		changed = true;
+		auto it = job_entries.find(result.job);
+		if (it == job_entries.end()) {
+			continue;  // The cell scrolled out of view in the meantime.
+		}
+		const std::size_t index = it->second;
+		Entry& entry = entries[index];
+		job_entries.erase(it);
+		entry.job = 0;
+
+		if (result.thumbnail == nullptr) {
+			SDL_Log("Failed to make a thumbnail of '%s': %s",
+					entry.path.c_str(), result.error.c_str());
+			entry.error = result.error;
+			continue;
+		}
+		// If every slot is in use, the cell requests the thumbnail again
+		// once there is room.
+		atlas.insert(index, result.thumbnail.get());
+		uploads++;
+	}
+	results_left = uploads == UPLOADS_PER_FRAME;
+	return changed;
+}
+
+/*
+Draw the cell of an image: its thumbnail, or a placeholder while the thumbnail
+is being made, above its file name.
+
+@return `true` if the cell was clicked.
+*/
+bool Gallery::draw_cell(std::size_t index, float label_height) {
+	Entry& entry = entries[index];
+	entry.frame = frame;
+
+	ImGui::PushID(static_cast<int>(index));
+	const ImVec2 min = ImGui::GetCursorScreenPos();
+	const ImVec2 max(min.x + CELL_SIZE, min.y + CELL_SIZE + label_height);
+	const bool clicked =
+		ImGui::InvisibleButton("cell", ImVec2(max.x - min.x, max.y - min.y));
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	if (ImGui::IsItemHovered()) {
+		draw_list->AddRectFilled(min, max,
+								 ImGui::GetColorU32(ImGuiCol_HeaderHovered));
+		ImGui::SetTooltip("%s", entry.error.empty() ? entry.path.c_str()
+													: entry.error.c_str());
+	}
+
+	AtlasEntry thumbnail;
+	if (atlas.find(index, thumbnail)) {
+		// Fit the thumbnail in the cell, without enlarging thumbnails of
+		// small images beyond one pixel per pixel of the screen.
+		const float pixel_scale = ImGui::GetIO().DisplayFramebufferScale.x;
+		const auto width = static_cast<float>(thumbnail.width);
+		const auto height = static_cast<float>(thumbnail.height);
+		const float scale =
+			std::min({CELL_SIZE / width, CELL_SIZE / height, 1 / pixel_scale});
+		const ImVec2 image_min(
+			std::round(min.x + (CELL_SIZE - width * scale) / 2),
+			std::round(min.y + (CELL_SIZE - height * scale) / 2));
+		draw_list->AddImage(
+			static_cast<ImTextureID>(
+				reinterpret_cast<std::intptr_t>(thumbnail.texture)),
+			image_min,
+			ImVec2(image_min.x + width * scale, image_min.y + height * scale),
+			ImVec2(thumbnail.uv_min.x, thumbnail.uv_min.y),
+			ImVec2(thumbnail.uv_max.x, thumbnail.uv_max.y));
+	} else {
+		if (entry.job == 0 && entry.error.empty()) {
+			entry.job = pool.submit(entry.path);
+			job_entries.emplace(entry.job, index);
+		}
+		draw_list->AddRectFilled(min, ImVec2(max.x, min.y + CELL_SIZE),
+								 ImGui::GetColorU32(ImGuiCol_FrameBg));
+	}
+
+	// The file name, centered and cut off at the edges of the cell.
+	const float text_width = ImGui::CalcTextSize(entry.name.c_str()).x;
+	draw_list->PushClipRect(ImVec2(min.x, min.y + CELL_SIZE), max, true);
+	draw_list->AddText(
+		ImVec2(min.x + std::max((CELL_SIZE - text_width) / 2, 0.0f),
+			   min.y + CELL_SIZE),
+		ImGui::GetColorU32(entry.error.empty() ? ImGuiCol_Text
+											   : ImGuiCol_TextDisabled),
+		entry.name.c_str());
+	draw_list->PopClipRect();
+	ImGui::PopID();
+	return clicked;
+}
+
+// Cancel the thumbnails of cells which were not drawn in this frame.
+void Gallery::cancel_hidden() {
+	for (auto it = job_entries.begin(); it != job_entries.end();) {
+		Entry& entry = entries[it->second];
+		if (entry.frame == frame) {
+			++it;
+			continue;
+		}
+		pool.cancel(it->first);
+		entry.job = 0;
+		it = job_entries.erase(it);
+	}
+}
+
+bool Gallery::draw(std::size_t& selected) {
+	ImGui::SetNextWindowSize(ImVec2(640, 480), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Gallery");
+	if (entries.empty()) {
+		ImGui::Text("No images have been opened.");
+		ImGui::End();
+		return false;
+	}
+
+	// Lay out as many columns as fit, and only the rows that are visible.
+	const ImGuiStyle& style = ImGui::GetStyle();
+	const float label_height = ImGui::GetTextLineHeightWithSpacing();
+	const std::size_t columns = static_cast<std::size_t>(std::max(
+		std::floor((ImGui::GetContentRegionAvail().x + style.ItemSpacing.x) /
+				   (CELL_SIZE + style.ItemSpacing.x)),
+		1.0f));
+	const std::size_t rows = (entries.size() + columns - 1) / columns;
+	bool clicked = false;
+	ImGuiListClipper clipper;
+	clipper.Begin(static_cast<int>(rows),
+				  CELL_SIZE + label_height + style.ItemSpacing.y);
+	while (clipper.Step()) {
+		for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+			for (std::size_t column = 0; column < columns; column++) {
+				const std::size_t index =
+					static_cast<std::size_t>(row) * columns + column;
+				if (index >= entries.size()) {
+					break;
+				}
+				if (column > 0) {
+					ImGui::SameLine();
+				}
+				if (draw_cell(index, label_height)) {
+					selected = index;
+					clicked = true;
+				}
+			}
+		}
+	}
+	clipper.End();
+	ImGui::End();
+
+	cancel_hidden();
+	return clicked;
+}
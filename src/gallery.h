@@ -0,0 +1,110 @@
+#ifndef SRC_GALLERY_H_
+#define SRC_GALLERY_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "thumbnail_atlas.h"
+#include "thumbnail_pool.h"
+
+/*
+ImGui window showing a grid of thumbnails of a list of image files.
+
+The grid is virtualized: only the rows scrolled into view are laid out, and
+thumbnails are only requested for the cells being drawn, so a list of
+thousands of images costs no more per frame than a screenful. Requests for
+cells that scroll out of view before their thumbnail is ready are cancelled.
+
+Thumbnails are made in the background by a `ThumbnailPool`, which keeps them
+in a `ThumbnailStore` on disk so that opening the same folder again only reads
+the small stored thumbnails, and they are drawn from a shared
+`ThumbnailAtlas`.
+
+All member functions must be called from the thread owning the renderer.
+*/
+class Gallery {
+   private:
+	// Width and height of the thumbnail of a cell, in screen points.
+	static constexpr float CELL_SIZE = 128;
+
+	// Largest number of thumbnails uploaded per frame, which bounds the time
+	// a frame spends uploading while a folder is opened.
+	static constexpr int UPLOADS_PER_FRAME = 16;
+
+	struct Entry {
+		std::string path;
+		std::string name;		// The file name, shown under the thumbnail.
+		std::uint64_t job = 0;	// The pending thumbnail job, 0 if there is
+								// none.
+		std::uint64_t frame = 0;  // The frame the cell was last drawn in.
+		std::string error;	// Non-empty if the image could not be decoded.
+	};
+
+	ThumbnailAtlas atlas;
+	ThumbnailPool pool;
+	std::vector<Entry> entries;
+	std::unordered_map<std::uint64_t, std::size_t>
+		job_entries;  // Maps pending jobs to indices in `entries`.
+	std::uint64_t frame;
+	bool results_left;	// Whether `update()` stopped at the upload limit
+						// with thumbnails possibly left to collect.
+
+	void clear();
+	bool draw_cell(std::size_t index, float label_height);
+	void cancel_hidden();
+
+   public:
+	/*
+	Create an empty gallery.
+
+	@param renderer The renderer used to create textures, which must outlive
+	the gallery.
+	@param thread_count The number of threads making thumbnails, see
+	`ThumbnailPool`.
+	@param directory The directory thumbnails are stored in, see
+	`ThumbnailStore`.
+	@param wake Called from a worker thread when a thumbnail is ready, see
+	`ThumbnailPool`.
+	*/
+	Gallery(SDL_Renderer* renderer, unsigned int thread_count,
+			std::string directory = ThumbnailStore::default_directory(),
+			std::function<void()> wake = nullptr);
+
+	Gallery(const Gallery&) = delete;
+	Gallery& operator=(const Gallery&) = delete;
+
+	// Replace the list of images.
+	void open(const std::vector<std::string>& paths);
+
+	/*
+	Upload thumbnails finished since the last frame. Must be called once per
+	frame, before `draw()`.
+
+	@return `true` if any thumbnail has finished, in which case the gallery
+	should be redrawn.
+	*/
+	bool update();
+
+	/*
+	Whether the gallery should be redrawn without any input, because finished
+	thumbnails are left for the next frames to upload.
+	*/
+	bool needs_redraw() const { return results_left; }
+
+	/*
+	Draw the gallery window, must be called between `ImGui::NewFrame()` and
+	`ImGui::Render()`.
+
+	@param selected Receives the index of the image the user clicked on.
+	@return `true` if the user clicked on an image.
+	*/
+	bool draw(std::size_t& selected);
+};
+
+#endif	// SRC_GALLERY_H_
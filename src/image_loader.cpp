@@ -0,0 +1,99 @@
+#include "image_loader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "jpeg_decoder.h"
+#include "mapped_file.h"
+#include "png_decoder.h"
+#include "resampler.h"
+
+bool decode_file(const char* path, const MappedFile& file,
+				 SDL_PixelFormat format, const DecodeOutput& output,
+				 int min_size) {
+	bool decoded = false;
+	if (is_png(file.data(), file.size())) {
+		decoded = decode_png(file.data(), file.size(), format, output);
+	} else if (is_jpeg(file.data(), file.size())) {
+		int width = 0;
+		int height = 0;
+		int scale = 1;
+		if (min_size > 0 &&
+			get_jpeg_size(file.data(), file.size(), width, height)) {
+			const int longest = std::max(width, height);
+			while (scale < 8 && longest / (scale * 2) >= min_size) {
+				scale *= 2;
+			}
+		}
+		decoded =
+			decode_jpeg(file.data(), file.size(), format, output, scale);
+	} else {
+		SDL_SetError("Unknown image format");
+	}
+	if (!decoded) {
+		std::string reason = SDL_GetError();
+		SDL_SetError("Failed to decode '%s': %s", path, reason.c_str());
+	}
+	return decoded;
+}
+
+bool load_image(const char* path, SDL_PixelFormat format,
+				const DecodeOutput& output) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	return decode_file(path, file, format, output, 0);
+}
+
+// Output creating a new surface, which the caller has to free.
+static DecodeOutput surface_output(SDL_Surface*& surface,
+								   SDL_PixelFormat format) {
+	DecodeOutput output;
+	output.create = [&surface, format](int width, int height) {
+		surface = SDL_CreateSurface(width, height, format);
+		return surface;
+	};
+	return output;
+}
+
+SDL_Surface* load_image(const char* path, SDL_PixelFormat format) {
+	SDL_Surface* surface = nullptr;
+	if (!load_image(path, format, surface_output(surface, format))) {
+		SDL_DestroySurface(surface);
+		return nullptr;
+	}
+	return surface;
+}
+
+SDL_Surface* load_thumbnail(const char* path, int size,
+							SDL_PixelFormat format) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return nullptr;
+	}
+	SDL_Surface* image = nullptr;
+	if (!decode_file(path, file, format, surface_output(image, format),
+					 size)) {
+		SDL_DestroySurface(image);
+		return nullptr;
+	}
+
+	const double longest = std::max(image->w, image->h);
+	if (longest <= size) {
+		return image;
+	}
+	const int width = std::max(
+		static_cast<int>(std::lround(image->w * size / longest)), 1);
+	const int height = std::max(
+		static_cast<int>(std::lround(image->h * size / longest)), 1);
+	SDL_Surface* thumbnail = SDL_CreateSurface(width, height, format);
+	if (thumbnail == nullptr ||
+		!resample(image, nullptr, thumbnail, RESAMPLE_FILTER_AREA)) {
+		SDL_DestroySurface(thumbnail);
+		thumbnail = nullptr;
+	}
+	SDL_DestroySurface(image);
+	return thumbnail;
+}
@@ -0,0 +1,69 @@
+#ifndef SRC_IMAGE_LOADER_H_
+#define SRC_IMAGE_LOADER_H_
+
+#include <SDL3/SDL.h>
+
+#include "decode_output.h"
+#include "mapped_file.h"
+
+/*
+Decode a PNG or JPEG image file.
+
+The file is memory-mapped and decoded straight into the output surface, so
+that loading an image needs little more memory than the decoded image itself,
+and the rows at the top of the image are available long before the whole
+image is decoded.
+
+The function only touches its arguments and thread-local state, so it may be
+called from any thread.
+
+@param path Path to the image file (UTF-8).
+@param format The pixel format of the surface returned by `output.create`,
+which must be a packed 32-bit format with 8 bits per color channel. Using the
+format preferred by the renderer makes creating a texture from the surface a
+plain copy.
+@param output Receives the decoded image.
+
+@return `true` if the whole image was decoded, or `false` if it could not be,
+in which case `SDL_GetError()` describes the error.
+*/
+bool load_image(const char* path, SDL_PixelFormat format,
+				const DecodeOutput& output);
+
+/*
+Decode a PNG or JPEG image file which has already been opened, prefixing errors
+with its path.
+
+@param min_size JPEG images are decoded at the smallest of 1/2, 1/4 or 1/8 of
+their size whose longest side is still at least this large (see
+`decode_jpeg()`). 0 decodes images at their full size.
+*/
+bool decode_file(const char* path, const MappedFile& file,
+				 SDL_PixelFormat format, const DecodeOutput& output,
+				 int min_size = 0);
+
+/*
+Decode a PNG or JPEG image file into a new surface.
+
+@return A surface owned by the caller, or `nullptr` if the image could not be
+decoded, in which case `SDL_GetError()` describes the error.
+*/
+SDL_Surface* load_image(const char* path, SDL_PixelFormat format);
+
+/*
+Decode a PNG or JPEG image file scaled down to fit in a square, keeping its
+aspect ratio. Images that already fit are returned at their size.
+
+JPEG images are decoded at the smallest of 1/2, 1/4 or 1/8 of their size that
+still covers the square (see `decode_jpeg()`), so that making a thumbnail of a
+photo costs a fraction of decoding it. The result is scaled down the rest of
+the way with `RESAMPLE_FILTER_AREA`.
+
+@param size The width and height of the square, in pixels.
+
+@return A surface owned by the caller, or `nullptr` if the image could not be
+decoded, in which case `SDL_GetError()` describes the error.
+*/
+SDL_Surface* load_thumbnail(const char* path, int size, SDL_PixelFormat format);
+
+#endif	// SRC_IMAGE_LOADER_H_
@@ -0,0 +1,93 @@
+#include "image_pyramid.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// Average four packed pixels channel by channel, two channels at a time.
+static inline std::uint32_t average(std::uint32_t a, std::uint32_t b,
+									std::uint32_t c, std::uint32_t d) {
+	const std::uint32_t mask = 0x00ff00ff;
+	std::uint32_t low =
+		(a & mask) + (b & mask) + (c & mask) + (d & mask) + 0x00020002;
+	std::uint32_t high = ((a >> 8) & mask) + ((b >> 8) & mask) +
+						 ((c >> 8) & mask) + ((d >> 8) & mask) + 0x00020002;
+	return ((low >> 2) & mask) | (((high >> 2) & mask) << 8);
+}
+
+/*
+Build rows of a level from the level above it with a box filter. Odd
+dimensions are rounded up, and the last row or column is then averaged with
+itself.
+
+@param first The first row of `target` to build.
+@param last One past the last row of `target` to build.
+*/
+static void downsample(const SDL_Surface* source, SDL_Surface* target,
+					   int first, int last) {
+	const auto* pixels = static_cast<const Uint8*>(source->pixels);
+	const int pairs = source->w / 2;
+	for (int y = first; y < last; y++) {
+		const auto* top = reinterpret_cast<const std::uint32_t*>(
+			pixels + static_cast<std::size_t>(2 * y) * source->pitch);
+		const int next_row = std::min(2 * y + 1, source->h - 1);
+		const auto* bottom = reinterpret_cast<const std::uint32_t*>(
+			pixels + static_cast<std::size_t>(next_row) * source->pitch);
+		auto* out = reinterpret_cast<std::uint32_t*>(
+			static_cast<Uint8*>(target->pixels) +
+			static_cast<std::size_t>(y) * target->pitch);
+		for (int x = 0; x < pairs; x++) {
+			out[x] = average(top[2 * x], top[2 * x + 1], bottom[2 * x],
+							 bottom[2 * x + 1]);
+		}
+		if (pairs < target->w) {
+			std::uint32_t upper = top[2 * pairs];
+			std::uint32_t lower = bottom[2 * pairs];
+			out[pairs] = average(upper, upper, lower, lower);
+		}
+	}
+}
+
+std::unique_ptr<ImagePyramid> ImagePyramid::create(int width, int height,
+												   SDL_PixelFormat format) {
+	std::unique_ptr<ImagePyramid> pyramid(new ImagePyramid());
+	for (;;) {
+		SDL_Surface* level = SDL_CreateSurface(width, height, format);
+		if (level == nullptr) {
+			return nullptr;
+		}
+		pyramid->levels.push_back(level);
+		if (width <= TILE_SIZE && height <= TILE_SIZE) {
+			break;
+		}
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+	pyramid->ready.reset(new std::atomic<int>[pyramid->levels.size()]);
+	for (std::size_t i = 0; i < pyramid->levels.size(); i++) {
+		pyramid->ready[i].store(0, std::memory_order_relaxed);
+	}
+	return pyramid;
+}
+
+void ImagePyramid::publish(int rows) {
+	ready[0].store(rows, std::memory_order_release);
+	for (std::size_t i = 1; i < levels.size(); i++) {
+		// A row needs both rows above it, except for the last row of a level
+		// with an odd number of rows.
+		const SDL_Surface* source = levels[i - 1];
+		const int first = ready[i].load(std::memory_order_relaxed);
+		const int last = rows == source->h ? levels[i]->h : rows / 2;
+		if (last <= first) {
+			break;
+		}
+		downsample(source, levels[i], first, last);
+		ready[i].store(last, std::memory_order_release);
+		rows = last;
+	}
+}
+
+ImagePyramid::~ImagePyramid() {
+	for (SDL_Surface* level : levels) {
+		SDL_DestroySurface(level);
+	}
+}
@@ -0,0 +1,83 @@
+#ifndef SRC_IMAGE_PYRAMID_H_
+#define SRC_IMAGE_PYRAMID_H_
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+An image together with its mip levels, each level being half the size of the
+previous one.
+
+Levels are generated down to the first level fitting in a single tile, so an
+image of any size can be drawn at any zoom level by uploading only the tiles of
+one level covering the screen (see `TileCache`).
+
+The pyramid is filled while the image is being decoded: the decoding thread
+writes rows into `image()` and publishes them with `publish()`, which also
+builds the matching rows of the other levels. Other threads may read the rows
+reported by `ready_rows()` at any time.
+*/
+class ImagePyramid {
+   private:
+	std::vector<SDL_Surface*> levels;  // Level 0 is the full size image.
+	std::unique_ptr<std::atomic<int>[]> ready;	// Final rows of each level.
+
+	ImagePyramid() = default;
+
+   public:
+	// Width and height of a tile in pixels, at every level.
+	static constexpr int TILE_SIZE = 512;
+
+	/*
+	Allocate a pyramid for an image whose pixels have not been decoded yet.
+
+	@param format The pixel format of the image, which must be a packed 32-bit
+	format with 8 bits per channel.
+
+	@return The pyramid, or `nullptr` if it could not be allocated, in which
+	case `SDL_GetError()` describes the error.
+	*/
+	static std::unique_ptr<ImagePyramid> create(int width, int height,
+												SDL_PixelFormat format);
+
+	ImagePyramid(const ImagePyramid&) = delete;
+	ImagePyramid& operator=(const ImagePyramid&) = delete;
+
+	int width() const { return levels[0]->w; }
+	int height() const { return levels[0]->h; }
+	SDL_PixelFormat format() const { return levels[0]->format; }
+
+	int level_count() const { return static_cast<int>(levels.size()); }
+
+	// Get a mip level, where level `n` is `2^n` times smaller than the image.
+	const SDL_Surface* level(int n) const { return levels[n]; }
+
+	// The full size image, which the decoder writes to.
+	SDL_Surface* image() { return levels[0]; }
+
+	/*
+	Make rows of the full size image visible to other threads, and build the
+	rows of the smaller levels which can be built from them. Must only be
+	called by the thread decoding the image.
+
+	@param rows The number of rows at the top of the image that are final.
+	*/
+	void publish(int rows);
+
+	// The number of rows at the top of a level which are final.
+	int ready_rows(int level) const {
+		return ready[level].load(std::memory_order_acquire);
+	}
+
+	// Whether every level is final.
+	bool complete() const {
+		return ready_rows(level_count() - 1) == levels.back()->h;
+	}
+
+	~ImagePyramid();
+};
+
+#endif	// SRC_IMAGE_PYRAMID_H_
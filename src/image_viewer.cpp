@@ -0,0 +1,758 @@
+#include "image_viewer.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <utility>
+
+#include "jpeg_encoder.h"
+#include "pixel_packing.h"
+#include "png_encoder.h"
+#include "resampler.h"
+
+ImageViewer::ImageViewer(SDL_Renderer* renderer, unsigned int decode_threads,
+						 unsigned int task_threads, std::size_t tile_budget,
+						 std::function<void()> wake)
+	: renderer{renderer},
+	  wake{std::move(wake)},
+	  pool(decode_threads, texture_format(renderer), this->wake),
+	  tiles(renderer, tile_budget, TILE_UPLOADS_PER_FRAME),
+	  tasks(task_threads),
+	  current{0},
+	  center_x{0},
+	  center_y{0},
+	  zoom{1},
+	  fit{true},
+	  next_fitted_job{1},
+	  latest_fitted_job{0},
+	  finished_job{0},
+	  finished{nullptr},
+	  raise{false},
+	  version{0},
+	  next_version{1},
+	  adjusting{false} {}
+
+// Drop the decoded image of an entry and its tiles.
+void ImageViewer::release(Entry& entry) {
+	if (entry.image != nullptr) {
+		if (fitted.image == entry.image.get()) {
+			release_fitted();
+		}
+		tiles.release(entry.image.get());
+		entry.image.reset();
+	}
+}
+
+void ImageViewer::clear() {
+	pool.cancel_all();
+	for (Entry& entry : entries) {
+		release(entry);
+	}
+	entries.clear();
+	job_entries.clear();
+	current = 0;
+	fit = true;
+}
+
+void ImageViewer::open(std::vector<std::string> paths) {
+	clear();
+	entries.reserve(paths.size());
+	for (std::string& path : paths) {
+		Entry entry;
+		entry.path = std::move(path);
+		entries.push_back(std::move(entry));
+	}
+	schedule();
+}
+
+/*
+Make sure that the images within `PREFETCH_RADIUS` of the current image are
+decoded, with the current image first, and release everything else.
+*/
+void ImageViewer::schedule() {
+	for (std::size_t i = 0; i < entries.size(); i++) {
+		std::size_t distance = i > current ? i - current : current - i;
+		if (distance <= PREFETCH_RADIUS) {
+			continue;
+		}
+		Entry& entry = entries[i];
+		if (entry.job != 0) {
+			pool.cancel(entry.job);
+			job_entries.erase(entry.job);
+			entry.job = 0;
+		}
+		release(entry);
+	}
+
+	// Visit the images in order of distance from the current image, since
+	// prefetched images are decoded in the order they were submitted.
+	auto request = [this](std::size_t index, DecodePriority priority) {
+		Entry& entry = entries[index];
+		if (entry.job != 0) {
+			pool.set_priority(entry.job, priority);
+		} else if (entry.image == nullptr && entry.error.empty()) {
+			entry.job = pool.submit(entry.path, priority);
+			job_entries.emplace(entry.job, index);
+		}
+	};
+	if (entries.empty()) {
+		return;
+	}
+	request(current, DECODE_PRIORITY_VISIBLE);
+	for (std::size_t distance = 1; distance <= PREFETCH_RADIUS; distance++) {
+		if (current + distance < entries.size()) {
+			request(current + distance, DECODE_PRIORITY_PREFETCH);
+		}
+		if (current >= distance) {
+			request(current - distance, DECODE_PRIORITY_PREFETCH);
+		}
+	}
+}
+
+void ImageViewer::select(std::size_t index) {
+	if (index >= entries.size() || index == current) {
+		return;
+	}
+	current = index;
+	fit = true;
+	schedule();
+}
+
+void ImageViewer::show(std::size_t index) {
+	select(index);
+	raise = true;
+}
+
+/*
+Change the adjustments applied to the images. Tiles adjusted with the previous
+adjustments are left for the tile cache to evict. Recently used adjustments
+keep their version, so going back to them reuses the tiles that are still
+cached.
+*/
+void ImageViewer::set_adjustments(const Adjustments& new_adjustments) {
+	if (new_adjustments == adjustments) {
+		return;
+	}
+	adjustments = new_adjustments;
+	graph = AdjustmentGraph(adjustments, texture_format(renderer));
+	if (graph.is_identity()) {
+		version = 0;
+		return;
+	}
+	auto used = std::find_if(
+		versions.begin(), versions.end(),
+		[this](const std::pair<Adjustments, std::uint64_t>& entry) {
+			return entry.first == adjustments;
+		});
+	if (used != versions.end()) {
+		version = used->second;
+		versions.erase(used);
+	} else {
+		version = next_version++;
+		if (versions.size() == REMEMBERED_ADJUSTMENTS) {
+			versions.erase(versions.begin());
+		}
+	}
+	versions.emplace_back(adjustments, version);
+}
+
+bool ImageViewer::update() {
+	tiles.begin_frame();
+
+	bool changed = false;
+	DecodeResult result;
+	while (pool.poll(result)) {
+		changed = true;
+		auto it = job_entries.find(result.job);
+		if (it == job_entries.end()) {
+			continue;  // The image was released while it was being decoded.
+		}
+		Entry& entry = entries[it->second];
+		if (result.image != nullptr && result.image != entry.image) {
+			// Drop the tiles of the previous image before it is freed, or an
+			// image allocated at the same address would be drawn with them.
+			release(entry);
+			entry.image = result.image;
+		}
+		if (!result.finished) {
+			continue;  // The image is shown while the rest is being decoded.
+		}
+		job_entries.erase(it);
+		entry.job = 0;
+
+		if (result.image == nullptr) {
+			SDL_Log("Failed to load '%s': %s", entry.path.c_str(),
+					result.error.c_str());
+			release(entry);
+			entry.error = result.error;
+		}
+	}
+	return changed;
+}
+
+bool ImageViewer::needs_redraw() const {
+	if (entries.empty()) {
+		return false;
+	}
+	const Entry& entry = entries[current];
+	return (entry.image != nullptr && !entry.image->complete()) ||
+		   tiles.uploads_deferred();
+}
+
+namespace {
+
+// The tiles of a mip level intersecting the visible part of an image.
+struct TileRange {
+	int first_x;
+	int first_y;
+	int last_x;	 // Inclusive.
+	int last_y;
+};
+
+}  // namespace
+
+/*
+Find the tiles of a mip level which are visible.
+
+@param size The width and height of the level, in pixels.
+@param origin The screen position of the top left corner of the image.
+@param scale The number of screen points per pixel of the level.
+@param clip_min The top left corner of the visible area on the screen.
+@param clip_max The bottom right corner of the visible area on the screen.
+*/
+static TileRange visible_tiles(ImVec2 size, ImVec2 origin, float scale,
+							   ImVec2 clip_min, ImVec2 clip_max) {
+	const float tile = ImagePyramid::TILE_SIZE * scale;
+	const int columns =
+		(static_cast<int>(size.x) + ImagePyramid::TILE_SIZE - 1) /
+		ImagePyramid::TILE_SIZE;
+	const int rows = (static_cast<int>(size.y) + ImagePyramid::TILE_SIZE - 1) /
+					 ImagePyramid::TILE_SIZE;
+	auto first = [tile](float min, float origin, int count) {
+		return std::clamp(static_cast<int>(std::floor((min - origin) / tile)),
+						  0, count);
+	};
+	auto last = [tile](float max, float origin, int count) {
+		int end = static_cast<int>(std::ceil((max - origin) / tile));
+		return std::clamp(end - 1, -1, count - 1);
+	};
+	return TileRange{first(clip_min.x, origin.x, columns),
+					 first(clip_min.y, origin.y, rows),
+					 last(clip_max.x, origin.x, columns),
+					 last(clip_max.y, origin.y, rows)};
+}
+
+/*
+Draw a textured rectangle cut down to a clipping rectangle, adjusting the
+texture coordinates to match. Tiles can get very large when zooming in, and not
+all renderers clip them before rasterizing them.
+*/
+static void add_clipped_image(ImDrawList* draw_list, SDL_Texture* texture,
+							  ImVec2 p_min, ImVec2 p_max, ImVec2 uv_min,
+							  ImVec2 uv_max, ImVec2 clip_min, ImVec2 clip_max) {
+	const ImVec2 min(std::max(p_min.x, clip_min.x),
+					 std::max(p_min.y, clip_min.y));
+	const ImVec2 max(std::min(p_max.x, clip_max.x),
+					 std::min(p_max.y, clip_max.y));
+	if (min.x >= max.x || min.y >= max.y) {
+		return;
+	}
+	const float du = (uv_max.x - uv_min.x) / (p_max.x - p_min.x);
+	const float dv = (uv_max.y - uv_min.y) / (p_max.y - p_min.y);
+	draw_list->AddImage(
+		static_cast<ImTextureID>(reinterpret_cast<std::intptr_t>(texture)), min,
+		max,
+		ImVec2(uv_min.x + (min.x - p_min.x) * du,
+			   uv_min.y + (min.y - p_min.y) * dv),
+		ImVec2(uv_min.x + (max.x - p_min.x) * du,
+			   uv_min.y + (max.y - p_min.y) * dv));
+}
+
+/*
+Draw the decoded rows of part of a tile.
+
+@param part The part of the tile to draw, in pixels of its level.
+@param rows The number of rows at the top of the tile which are decoded.
+@param position The screen position of the top left corner of the part.
+@param scale The number of screen points per pixel of the tile's level.
+*/
+static void draw_tile(ImDrawList* draw_list, SDL_Texture* texture,
+					  SDL_FRect part, int rows, ImVec2 position, float scale,
+					  ImVec2 clip_min, ImVec2 clip_max) {
+	part.h = std::min(part.h, static_cast<float>(rows) - part.y);
+	if (part.h <= 0) {
+		return;
+	}
+	SDL_FPoint uv_min;
+	SDL_FPoint uv_max;
+	TileCache::uv(part, uv_min, uv_max);
+	add_clipped_image(
+		draw_list, texture, position,
+		ImVec2(position.x + part.w * scale, position.y + part.h * scale),
+		ImVec2(uv_min.x, uv_min.y), ImVec2(uv_max.x, uv_max.y), clip_min,
+		clip_max);
+}
+
+void ImageViewer::release_fitted() {
+	SDL_DestroySurface(fitted.resampled);
+	if (fitted.texture != nullptr) {
+		SDL_DestroyTexture(fitted.texture);
+	}
+	fitted = FittedImage{};
+
+	// Drop the result of a job still running or not collected yet.
+	std::lock_guard<std::mutex> lock(fitted_mutex);
+	latest_fitted_job.store(0);
+	SDL_DestroySurface(finished);
+	finished = nullptr;
+	finished_job = 0;
+}
+
+/*
+Resample an image to fit the view, on the worker thread, and store the result
+for `draw_fitted()` to collect unless a later job has been started since.
+*/
+void ImageViewer::resample_fitted(const ImagePyramid& image, int width,
+								  int height, std::uint64_t job) {
+	if (latest_fitted_job.load() != job) {
+		return;
+	}
+	// Start from the smallest level at least twice as large, where the box
+	// filter of the mip levels does not blur the result noticeably.
+	int level = 0;
+	while (level + 1 < image.level_count() &&
+		   image.level(level + 1)->w >= 2 * width &&
+		   image.level(level + 1)->h >= 2 * height) {
+		level++;
+	}
+	SDL_Surface* resampled = SDL_CreateSurface(width, height, image.format());
+	if (resampled == nullptr ||
+		!resample(image.level(level), nullptr, resampled,
+				  RESAMPLE_FILTER_LANCZOS3, &tasks)) {
+		SDL_Log("Failed to resample image: %s", SDL_GetError());
+		SDL_DestroySurface(resampled);
+		resampled = nullptr;
+	}
+	{
+		std::lock_guard<std::mutex> lock(fitted_mutex);
+		if (latest_fitted_job.load() == job) {
+			SDL_DestroySurface(finished);
+			finished = resampled;
+			finished_job = job;
+			resampled = nullptr;
+		}
+	}
+	SDL_DestroySurface(resampled);
+	if (wake) {
+		wake();
+	}
+}
+
+/*
+Draw an image from a texture holding it resampled to its size on the screen,
+at the current zoom level. The image is resampled again on the worker thread
+whenever the size changes, and the adjustments are applied to the resampled
+image again whenever they change.
+
+@param left The screen position of the left edge of the image.
+@param top The screen position of the top edge of the image.
+
+@return `false` if the image is not resampled yet or could not be, in which
+case it has to be drawn from tiles.
+*/
+bool ImageViewer::draw_fitted(const std::shared_ptr<ImagePyramid>& image,
+							  float left, float top) {
+	const float pixel_scale = ImGui::GetIO().DisplayFramebufferScale.x;
+	const auto pixel_zoom = static_cast<double>(zoom * pixel_scale);
+	const int width = std::max(
+		static_cast<int>(std::lround(image->width() * pixel_zoom)), 1);
+	const int height = std::max(
+		static_cast<int>(std::lround(image->height() * pixel_zoom)), 1);
+	bool adjust = fitted.version != version;
+	if (fitted.image != image.get() || fitted.width != width ||
+		fitted.height != height) {
+		release_fitted();
+		fitted.image = image.get();
+		fitted.width = width;
+		fitted.height = height;
+		fitted.job = next_fitted_job++;
+		latest_fitted_job.store(fitted.job);
+		// The job keeps the image alive even if it is released meanwhile.
+		worker.submit([this, image, width, height, job = fitted.job] {
+			resample_fitted(*image, width, height, job);
+		});
+	}
+	if (fitted.job != 0) {
+		{
+			std::lock_guard<std::mutex> lock(fitted_mutex);
+			if (finished_job != fitted.job) {
+				return false;
+			}
+			fitted.resampled = finished;
+			finished = nullptr;
+			finished_job = 0;
+		}
+		fitted.job = 0;
+		if (fitted.resampled == nullptr) {
+			return false;
+		}
+		fitted.texture =
+			SDL_CreateTexture(renderer, image->format(),
+							  SDL_TEXTUREACCESS_STREAMING, width, height);
+		if (fitted.texture == nullptr) {
+			SDL_Log("Failed to create a texture for resampling: %s",
+					SDL_GetError());
+			return false;
+		}
+		SDL_SetTextureScaleMode(fitted.texture, SDL_SCALEMODE_NEAREST);
+		adjust = true;
+	}
+	if (fitted.texture == nullptr) {
+		return false;
+	}
+	if (adjust) {
+		SDL_Surface* surface = nullptr;
+		if (!SDL_LockTextureToSurface(fitted.texture, nullptr, &surface)) {
+			SDL_Log("Failed to lock texture: %s", SDL_GetError());
+			SDL_DestroyTexture(fitted.texture);
+			fitted.texture = nullptr;
+			return false;
+		}
+		graph.apply(fitted.resampled, height, SDL_Rect{0, 0, width, height},
+					surface, tasks);
+		SDL_UnlockTexture(fitted.texture);
+		fitted.version = version;
+	}
+
+	// Align the texture with the pixels of the screen.
+	const ImVec2 min(std::round(left * pixel_scale) / pixel_scale,
+					 std::round(top * pixel_scale) / pixel_scale);
+	const ImVec2 max(min.x + static_cast<float>(width) / pixel_scale,
+					 min.y + static_cast<float>(height) / pixel_scale);
+	ImGui::GetWindowDrawList()->AddImage(
+		static_cast<ImTextureID>(
+			reinterpret_cast<std::intptr_t>(fitted.texture)),
+		min, max);
+	return true;
+}
+
+/*
+Draw an image filling the rest of the window, at the current zoom level and
+position, and handle zooming and panning with the mouse. Every visible tile is
+drawn from the mip level matching the zoom level, on top of the first smaller
+level that has the covering tile uploaded if the tile is not uploaded or only
+partly decoded yet. Tiles are adjusted as they are uploaded.
+*/
+void ImageViewer::draw_image(const ImagePyramid& image) {
+	ImGuiIO& io = ImGui::GetIO();
+	const ImVec2 view_min = ImGui::GetCursorScreenPos();
+	const ImVec2 available = ImGui::GetContentRegionAvail();
+	const ImVec2 view_size(std::max(available.x, 1.0f),
+						   std::max(available.y, 1.0f));
+	const ImVec2 view_max(view_min.x + view_size.x, view_min.y + view_size.y);
+	const auto width = static_cast<float>(image.width());
+	const auto height = static_cast<float>(image.height());
+
+	// Zoom with the mouse wheel around the cursor, pan by dragging and go back
+	// to fitting the image by double clicking.
+	ImGui::InvisibleButton("image", view_size);
+	const float fit_zoom =
+		std::min(view_size.x / width, view_size.y / height);
+	if (fit) {
+		zoom = fit_zoom;
+		center_x = width / 2;
+		center_y = height / 2;
+	}
+	const ImVec2 view_center(view_min.x + view_size.x / 2,
+							 view_min.y + view_size.y / 2);
+	if (ImGui::IsItemHovered() && io.MouseWheel != 0) {
+		// Keep the image point under the cursor in place.
+		const float x = center_x + (io.MousePos.x - view_center.x) / zoom;
+		const float y = center_y + (io.MousePos.y - view_center.y) / zoom;
+		zoom = std::clamp(zoom * std::pow(1.25f, io.MouseWheel),
+						  std::min(fit_zoom, 1.0f) / 4, MAX_ZOOM);
+		center_x = x - (io.MousePos.x - view_center.x) / zoom;
+		center_y = y - (io.MousePos.y - view_center.y) / zoom;
+		fit = false;
+	}
+	if (ImGui::IsItemActive() &&
+		ImGui::IsMouseDragging(ImGuiMouseButton_Left)) {
+		center_x -= io.MouseDelta.x / zoom;
+		center_y -= io.MouseDelta.y / zoom;
+		fit = false;
+	}
+	if (ImGui::IsItemHovered() &&
+		ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left)) {
+		fit = true;
+	}
+	center_x = std::clamp(center_x, 0.0f, width);
+	center_y = std::clamp(center_y, 0.0f, height);
+	const ImVec2 origin(view_center.x - center_x * zoom,
+						view_center.y - center_y * zoom);
+
+	// Scaled down images fitting in the view are drawn in one piece once they
+	// are decoded and resampled.
+	const float pixel_zoom = zoom * io.DisplayFramebufferScale.x;
+	if (fit && pixel_zoom < 1 && image.complete() &&
+		draw_fitted(entries[current].image, origin.x, origin.y)) {
+		return;
+	}
+
+	auto range_of = [&](int n) {
+		const SDL_Surface* surface = image.level(n);
+		return visible_tiles(ImVec2(static_cast<float>(surface->w),
+									static_cast<float>(surface->h)),
+							 origin, zoom * static_cast<float>(1 << n),
+							 view_min, view_max);
+	};
+	const int top = image.level_count() - 1;
+
+	// Use the smallest level that still has at least one pixel per pixel of
+	// the screen. While the adjustments are being dragged, the tiles are out
+	// of date by the next frame, so use a level whose visible tiles can all
+	// be adjusted within the upload limit of a frame instead, leaving room
+	// for the smallest level.
+	int level = 0;
+	while (level + 1 < image.level_count() &&
+		   pixel_zoom * static_cast<float>(2 << level) <= 1) {
+		level++;
+	}
+	while (adjusting && level < top) {
+		const TileRange range = range_of(level);
+		const int count = (range.last_x - range.first_x + 1) *
+						  (range.last_y - range.first_y + 1);
+		if (count <= TILE_UPLOADS_PER_FRAME / 2) {
+			break;
+		}
+		level++;
+	}
+
+	// Adjusted tiles are made from the pixels of their level.
+	TileSource source;
+	if (version != 0) {
+		source = [this](const TileKey& key, const SDL_Rect& area, int ready,
+						SDL_Surface* tile) {
+			graph.apply(key.image->level(key.level), ready, area, tile, tasks);
+		};
+	}
+
+	// Make sure the smallest level is uploaded first, so that there always is
+	// something to draw while the tiles of the chosen level are uploaded.
+	const TileRange top_range = range_of(top);
+	int rows = 0;
+	for (int y = top_range.first_y; y <= top_range.last_y; y++) {
+		for (int x = top_range.first_x; x <= top_range.last_x; x++) {
+			tiles.request(TileKey{&image, top, x, y, version}, rows, source);
+		}
+	}
+
+	ImDrawList* draw_list = ImGui::GetWindowDrawList();
+	const SDL_Surface* surface = image.level(level);
+	const float scale = zoom * static_cast<float>(1 << level);
+	const TileRange range = range_of(level);
+	for (int y = range.first_y; y <= range.last_y; y++) {
+		for (int x = range.first_x; x <= range.last_x; x++) {
+			// The tile, in pixels of its level.
+			SDL_FRect rect{
+				static_cast<float>(x * ImagePyramid::TILE_SIZE),
+				static_cast<float>(y * ImagePyramid::TILE_SIZE), 0, 0};
+			rect.w = std::min(static_cast<float>(ImagePyramid::TILE_SIZE),
+							  static_cast<float>(surface->w) - rect.x);
+			rect.h = std::min(static_cast<float>(ImagePyramid::TILE_SIZE),
+							  static_cast<float>(surface->h) - rect.y);
+
+			// Draw the part of a tile of a smaller level covering the same
+			// area first, in case the tile itself is missing or only partly
+			// decoded.
+			SDL_Texture* texture = tiles.request(
+				TileKey{&image, level, x, y, version}, rows, source);
+			if (texture == nullptr || rows < rect.h) {
+				for (int n = level + 1; n <= top; n++) {
+					const int shift = n - level;
+					const TileKey key{&image, n, x >> shift, y >> shift,
+									  version};
+					int coarse_rows = 0;
+					SDL_Texture* coarse = tiles.find(key, coarse_rows);
+					if (coarse != nullptr) {
+						const float factor = static_cast<float>(1 << shift);
+						const auto tile_left = static_cast<float>(
+							key.x * ImagePyramid::TILE_SIZE);
+						const auto tile_top = static_cast<float>(
+							key.y * ImagePyramid::TILE_SIZE);
+						const SDL_FRect part{rect.x / factor - tile_left,
+											 rect.y / factor - tile_top,
+											 rect.w / factor, rect.h / factor};
+						draw_tile(draw_list, coarse, part, coarse_rows,
+								  ImVec2(origin.x + rect.x * scale,
+										 origin.y + rect.y * scale),
+								  scale * factor, view_min, view_max);
+						break;
+					}
+				}
+			}
+			if (texture != nullptr) {
+				const SDL_FRect part{0, 0, rect.w, rect.h};
+				draw_tile(draw_list, texture, part, rows,
+						  ImVec2(origin.x + rect.x * scale,
+								 origin.y + rect.y * scale),
+						  scale, view_min, view_max);
+			}
+		}
+	}
+}
+
+void ImageViewer::draw() {
+	ImGui::SetNextWindowSize(ImVec2(640, 480), ImGuiCond_FirstUseEver);
+	if (raise) {
+		ImGui::SetNextWindowFocus();
+		raise = false;
+	}
+	ImGui::Begin("Viewer");
+	if (entries.empty()) {
+		ImGui::Text("No images have been opened.");
+		ImGui::End();
+		return;
+	}
+
+	// Navigation, either using the buttons or the arrow keys.
+	bool focused =
+		ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
+	if ((ImGui::Button("Previous") ||
+		 (focused && ImGui::IsKeyPressed(ImGuiKey_LeftArrow))) &&
+		current > 0) {
+		select(current - 1);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Next") ||
+		(focused && ImGui::IsKeyPressed(ImGuiKey_RightArrow))) {
+		select(current + 1);
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("Fit")) {
+		fit = true;
+	}
+	ImGui::SameLine();
+	if (ImGui::Button("1:1")) {
+		// One pixel of the image per pixel of the screen.
+		zoom = 1 / ImGui::GetIO().DisplayFramebufferScale.x;
+		fit = false;
+	}
+	const Entry& entry = entries[current];
+	std::size_t separator = entry.path.find_last_of("/\\");
+	const char* name = entry.path.c_str() +
+					   (separator == std::string::npos ? 0 : separator + 1);
+	ImGui::SameLine();
+	ImGui::Text("%zu / %zu: %s", current + 1, entries.size(), name);
+	if (entry.image != nullptr) {
+		ImGui::SameLine();
+		ImGui::Text("(%dx%d, %.0f%%%s)", entry.image->width(),
+					entry.image->height(),
+					zoom * ImGui::GetIO().DisplayFramebufferScale.x * 100,
+					entry.image->complete() ? "" : ", decoding");
+	}
+
+	if (entry.image != nullptr) {
+		draw_image(*entry.image);
+	} else if (!entry.error.empty()) {
+		ImGui::TextWrapped("Failed to load image: %s", entry.error.c_str());
+	} else {
+		ImGui::Text("Decoding...");
+	}
+	ImGui::End();
+}
+
+bool ImageViewer::draw_adjustments() {
+	ImGui::SetNextWindowSize(ImVec2(320, 0), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Adjustments");
+	Adjustments edited = adjustments;
+	bool active = false;
+	auto slider = [&active](const char* label, float& value, float min,
+							float max, const char* format,
+							ImGuiSliderFlags flags = 0) {
+		ImGui::SliderFloat(label, &value, min, max, format, flags);
+		active = active || ImGui::IsItemActive();
+	};
+	slider("Exposure", edited.exposure, -4, 4, "%+.2f EV");
+	ImGui::SeparatorText("Levels");
+	slider("Black", edited.black, 0, 0.5f, "%.3f");
+	slider("White", edited.white, 0.5f, 1, "%.3f");
+	slider("Gamma", edited.gamma, 0.25f, 4, "%.2f",
+		   ImGuiSliderFlags_Logarithmic);
+	ImGui::SeparatorText("Curves");
+	slider("Shadows", edited.shadows, -0.2f, 0.2f, "%+.3f");
+	slider("Midtones", edited.midtones, -0.2f, 0.2f, "%+.3f");
+	slider("Highlights", edited.highlights, -0.2f, 0.2f, "%+.3f");
+	ImGui::SeparatorText("Detail");
+	slider("Saturation", edited.saturation, 0, 2, "%.2f");
+	slider("Sharpen", edited.sharpen, 0, 4, "%.2f");
+	ImGui::Separator();
+	if (ImGui::Button("Reset")) {
+		edited = Adjustments{};
+	}
+	ImGui::SameLine();
+	const bool exportable = !entries.empty() &&
+							entries[current].image != nullptr &&
+							entries[current].image->complete();
+	ImGui::BeginDisabled(!exportable);
+	const bool export_requested = ImGui::Button("Export...");
+	ImGui::EndDisabled();
+	ImGui::End();
+
+	adjusting = active;
+	set_adjustments(edited);
+	return export_requested;
+}
+
+/*
+Save an image at full resolution with adjustments applied, see
+`export_image()`. Runs on `exporter`.
+*/
+bool ImageViewer::save_export(const ImagePyramid& image,
+							  const AdjustmentGraph& graph,
+							  const std::string& path) {
+	SDL_Surface* adjusted =
+		SDL_CreateSurface(image.width(), image.height(), image.format());
+	if (adjusted == nullptr) {
+		return false;
+	}
+	graph.apply(image.level(0), image.height(),
+				SDL_Rect{0, 0, image.width(), image.height()}, adjusted, tasks);
+
+	const char* extension = SDL_strrchr(path.c_str(), '.');
+	const bool jpeg = extension != nullptr &&
+					  (SDL_strcasecmp(extension, ".jpg") == 0 ||
+					   SDL_strcasecmp(extension, ".jpeg") == 0);
+	std::vector<Uint8> file;
+	const bool encoded = jpeg
+							 ? encode_jpeg(adjusted, EXPORT_JPEG_QUALITY, file)
+							 : encode_png(adjusted, file);
+	SDL_DestroySurface(adjusted);
+	return encoded && SDL_SaveFile(path.c_str(), file.data(), file.size());
+}
+
+bool ImageViewer::export_image(
+	std::string path,
+	std::function<void(bool exported, const std::string& error)> done) {
+	if (entries.empty() || entries[current].image == nullptr ||
+		!entries[current].image->complete()) {
+		return SDL_SetError("The image has not been decoded yet");
+	}
+	// The job keeps the image alive and uses the adjustments of the moment,
+	// however the viewer changes in the meantime.
+	exporter.submit([this, image = entries[current].image, graph = graph,
+					 path = std::move(path), done = std::move(done)] {
+		if (save_export(*image, graph, path)) {
+			done(true, std::string());
+		} else {
+			done(false, SDL_GetError());
+		}
+	});
+	return true;
+}
+
+ImageViewer::~ImageViewer() {
+	clear();
+	release_fitted();
+}
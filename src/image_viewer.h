@@ -0,0 +1,241 @@
+#ifndef SRC_IMAGE_VIEWER_H_
+#define SRC_IMAGE_VIEWER_H_
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "adjustments.h"
+#include "decode_pool.h"
+#include "image_pyramid.h"
+#include "task_pool.h"
+#include "tile_cache.h"
+#include "worker_thread.h"
+
+/*
+ImGui window showing one image out of a list of image files at a time.
+
+Images are decoded in the background by a `DecodePool`. The image being viewed
+is decoded first, followed by its neighbours so that stepping through the list
+is instant. Only the images close to the current one are kept in memory, so
+opening a folder with hundreds of images costs no more than opening a few.
+
+Images are drawn from tiles of the mip level closest to the zoom level, so
+images larger than the renderer's texture size limit can be viewed, and the
+cost of drawing a frame depends on the size of the window rather than on the
+size of the image. Tiles are uploaded as they become visible and the least
+recently drawn ones are evicted once the memory budget is used up. While the
+whole image is shown scaled down, it is drawn from a single texture resampled
+to its exact size on the screen instead, which is sharper than the mip levels
+and avoids the aliasing of filtering them bilinearly. The image is resampled
+on a worker thread, and drawn from tiles until it is done.
+
+Images are shown while they are being decoded, with the rows decoded so far
+filling in from the top.
+
+Adjustments are applied to tiles as they are uploaded, so only the visible
+tiles at the resolution being drawn are processed, and changing the
+adjustments only makes the tiles uploaded from then on use the new ones. While
+the adjustments are being dragged, the image is drawn from a level small
+enough to process in a single frame. Exported images are adjusted and encoded
+on another worker thread, so the viewer keeps responding in the meantime.
+
+All member functions must be called from the thread owning the renderer.
+*/
+class ImageViewer {
+   private:
+	// Number of images on each side of the current image that are decoded
+	// ahead of time and kept in memory.
+	static constexpr std::size_t PREFETCH_RADIUS = 4;
+
+	// Largest number of tiles uploaded per frame. Tiles that are not uploaded
+	// yet are drawn from a smaller mip level in the meantime.
+	static constexpr int TILE_UPLOADS_PER_FRAME = 8;
+
+	// Largest zoom level, in screen points per image pixel.
+	static constexpr float MAX_ZOOM = 32;
+
+	// Number of recently used adjustments whose versions are remembered, so
+	// that going back to them reuses their tiles still in the cache.
+	static constexpr std::size_t REMEMBERED_ADJUSTMENTS = 32;
+
+	// Quality of exported JPEG images, see `encode_jpeg()`.
+	static constexpr int EXPORT_JPEG_QUALITY = 90;
+
+	struct Entry {
+		std::string path;
+		std::uint64_t job = 0;	// The pending decode job, 0 if there is none.
+		std::shared_ptr<ImagePyramid> image;  // Shared with the decoder until
+											  // the job has finished.
+		std::string error;	// Non-empty if the image could not be decoded.
+	};
+
+	// An image resampled to fit the view.
+	struct FittedImage {
+		const ImagePyramid* image = nullptr;
+		int width = 0;	// The size of the texture, in pixels.
+		int height = 0;
+		std::uint64_t job = 0;	// The job resampling the image, 0 once its
+								// result has been collected.
+		SDL_Surface* resampled = nullptr;  // Before adjustments.
+		SDL_Texture* texture = nullptr;	 // nullptr if resampling failed.
+		std::uint64_t version = 0;	// The adjustments applied to `texture`.
+	};
+
+	SDL_Renderer* renderer;
+	std::function<void()> wake;
+
+	DecodePool pool;
+	TileCache tiles;
+	TaskPool tasks;	 // Applies adjustments and resamples fitted images.
+	std::vector<Entry> entries;
+	std::unordered_map<std::uint64_t, std::size_t>
+		job_entries;  // Maps pending jobs to indices in `entries`.
+	std::size_t current;
+
+	// The view of the current image: the image point shown at the center of
+	// the view, in pixels, and the number of screen points per image pixel.
+	// While `fit` is set, the whole image is shown and the other values are
+	// recomputed every frame.
+	float center_x;
+	float center_y;
+	float zoom;
+	bool fit;
+	FittedImage fitted;
+	// Jobs resampling fitted images on `worker`. Only the latest job stores
+	// its result, the others are skipped or dropped.
+	std::uint64_t next_fitted_job;
+	std::atomic<std::uint64_t> latest_fitted_job;  // 0 if there is none.
+	std::mutex fitted_mutex;  // Guards `finished_job` and `finished`.
+	std::uint64_t finished_job;
+	SDL_Surface* finished;	// The result of `finished_job`, not collected yet.
+	bool raise;	 // Bring the window to the front in the next frame.
+
+	// The adjustments applied to every image, compiled into `graph`, and the
+	// version of the adjustments used in the keys of adjusted tiles. Version
+	// 0 is the unadjusted image.
+	Adjustments adjustments;
+	AdjustmentGraph graph;
+	std::uint64_t version;
+	std::uint64_t next_version;
+	std::vector<std::pair<Adjustments, std::uint64_t>>
+		versions;  // Recently used adjustments and their versions, the most
+				   // recently used last.
+	bool adjusting;	 // Whether an adjustment is being dragged.
+
+	// Declared last, so that their jobs finish before anything they use is
+	// destroyed. Exports run on their own thread so that they do not hold up
+	// resampling fitted images.
+	WorkerThread worker;
+	WorkerThread exporter;
+
+	void clear();
+	void release(Entry& entry);
+	void schedule();
+	void select(std::size_t index);
+	void set_adjustments(const Adjustments& new_adjustments);
+	void release_fitted();
+	void resample_fitted(const ImagePyramid& image, int width, int height,
+						 std::uint64_t job);
+	bool draw_fitted(const std::shared_ptr<ImagePyramid>& image, float left,
+					 float top);
+	void draw_image(const ImagePyramid& image);
+	bool save_export(const ImagePyramid& image, const AdjustmentGraph& graph,
+					 const std::string& path);
+
+   public:
+	// Default budget of texture memory for tiles, in bytes.
+	static constexpr std::size_t TILE_MEMORY_BUDGET = 256 << 20;
+
+	/*
+	Create an empty viewer.
+
+	@param renderer The renderer used to create textures, which must outlive
+	the viewer.
+	@param decode_threads The number of threads decoding images, see
+	`DecodePool`.
+	@param task_threads The number of workers applying adjustments and
+	resampling fitted images, see `TaskPool`. The main thread joins them when
+	it applies adjustments.
+	@param tile_budget The largest number of bytes of texture memory used for
+	tiles, see `TileCache`.
+	@param wake Called from a worker thread when an image has made progress,
+	see `DecodePool`, or a fitted image has been resampled.
+	*/
+	ImageViewer(SDL_Renderer* renderer, unsigned int decode_threads,
+				unsigned int task_threads,
+				std::size_t tile_budget = TILE_MEMORY_BUDGET,
+				std::function<void()> wake = nullptr);
+
+	ImageViewer(const ImageViewer&) = delete;
+	ImageViewer& operator=(const ImageViewer&) = delete;
+
+	/*
+	Replace the list of viewed images and start decoding the first one.
+	*/
+	void open(std::vector<std::string> paths);
+
+	/*
+	Collect images that have started or finished decoding. Must be called once
+	per frame, before `draw()`.
+
+	@return `true` if any image has made progress, in which case the viewer
+	should be redrawn.
+	*/
+	bool update();
+
+	/*
+	Whether the last frame drawn is already out of date without any input,
+	because the current image is still being decoded or some of its tiles have
+	not been uploaded yet.
+	*/
+	bool needs_redraw() const;
+
+	/*
+	Show an image of the list and bring the viewer window to the front.
+
+	@param index The index of the image in the list passed to `open()`.
+	*/
+	void show(std::size_t index);
+
+	// Draw the viewer window, must be called between `ImGui::NewFrame()` and
+	// `ImGui::Render()`.
+	void draw();
+
+	/*
+	Draw the window with the adjustments applied to the images, must be called
+	between `ImGui::NewFrame()` and `ImGui::Render()`.
+
+	@return `true` if the user asked to export the current image.
+	*/
+	bool draw_adjustments();
+
+	/*
+	Start saving the current image at full resolution with the adjustments
+	applied, on a worker thread. The image must have finished decoding.
+
+	@param path The file to write, as JPEG if its extension is .jpg or .jpeg
+	and as PNG otherwise.
+	@param done Called from the worker thread once the image is saved, with
+	`true`, or once saving it has failed, with `false` and a description of the
+	error.
+	@return `false` if the export could not be started, in which case
+	`SDL_GetError()` describes the error.
+	*/
+	bool export_image(
+		std::string path,
+		std::function<void(bool exported, const std::string& error)> done);
+
+	~ImageViewer();
+};
+
+#endif	// SRC_IMAGE_VIEWER_H_
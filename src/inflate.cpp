@@ -0,0 +1,638 @@
+#include "inflate.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+/*
+Decoding tables.
+
+A table is indexed by the next `PRIMARY_BITS` bits of the input (in DEFLATE bit
+order) and every entry describes the symbol those bits start with:
+
+	bits 0-7    Number of bits in the code.
+	bits 8-11   Number of extra bits following the code (lengths/distances).
+	bits 12-15  Flags, see below.
+	bits 16-31  The literal byte, or the base value of a length/distance.
+
+Codes longer than `PRIMARY_BITS` are resolved with a second lookup in a
+subtable placed after the primary table. The primary entry then has
+`FLAG_SUBTABLE` set, the subtable offset in bits 16-31, the number of bits
+indexing the subtable in bits 8-11 and `PRIMARY_BITS` in bits 0-7.
+*/
+static const std::uint32_t FLAG_LITERAL = 0x1000;
+static const std::uint32_t FLAG_END = 0x2000;
+static const std::uint32_t FLAG_SUBTABLE = 0x4000;
+static const std::uint32_t FLAG_INVALID = 0x8000;
+
+static const unsigned int LITERAL_PRIMARY_BITS = 10;
+static const unsigned int DISTANCE_PRIMARY_BITS = 8;
+static const unsigned int CODE_LENGTH_PRIMARY_BITS = 7;
+
+static const unsigned int MAX_CODE_LENGTH = 15;
+static const unsigned int LITERAL_SYMBOLS = 288;
+static const unsigned int DISTANCE_SYMBOLS = 32;
+static const unsigned int CODE_LENGTH_SYMBOLS = 19;
+
+// Space after the end of the output buffer that match copies may scribble
+// over, since they copy eight bytes at a time.
+static const std::size_t COPY_SLACK = 16;
+
+namespace {
+
+// Entries of each alphabet without the code length, see `build_table()`.
+struct SymbolTemplates {
+	std::array<std::uint32_t, LITERAL_SYMBOLS> literal;
+	std::array<std::uint32_t, DISTANCE_SYMBOLS> distance;
+	std::array<std::uint32_t, CODE_LENGTH_SYMBOLS> code_length;
+
+	SymbolTemplates() : literal{}, distance{}, code_length{} {
+		static const std::uint16_t LENGTH_BASE[29] = {
+			3,	4,	5,	6,	7,	8,	9,	10, 11,	 13,  15,  17,	19,	 23, 27,
+			31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+		static const std::uint8_t LENGTH_EXTRA[29] = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+			2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+		static const std::uint16_t DISTANCE_BASE[30] = {
+			1,	  2,	3,	  4,	5,	  7,	9,	  13,	 17,  25,
+			33,	  49,	65,	  97,	129,  193,	257,  385,	 513, 769,
+			1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+		static const std::uint8_t DISTANCE_EXTRA[30] = {
+			0, 0, 0, 0, 1, 1, 2, 2,	  3,  3,  4,  4,  5,  5,  6,
+			6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+		for (std::uint32_t i = 0; i < 256; i++) {
+			literal[i] = FLAG_LITERAL | (i << 16);
+		}
+		literal[256] = FLAG_END;
+		for (std::uint32_t i = 0; i < 29; i++) {
+			literal[257 + i] =
+				(static_cast<std::uint32_t>(LENGTH_BASE[i]) << 16) |
+				(static_cast<std::uint32_t>(LENGTH_EXTRA[i]) << 8);
+		}
+		literal[286] = literal[287] = FLAG_INVALID;
+		for (std::uint32_t i = 0; i < 30; i++) {
+			distance[i] = (static_cast<std::uint32_t>(DISTANCE_BASE[i]) << 16) |
+						  (static_cast<std::uint32_t>(DISTANCE_EXTRA[i]) << 8);
+		}
+		distance[30] = distance[31] = FLAG_INVALID;
+		for (std::uint32_t i = 0; i < CODE_LENGTH_SYMBOLS; i++) {
+			code_length[i] = i << 16;
+		}
+	}
+};
+
+}  // namespace
+
+static const SymbolTemplates& symbol_templates() {
+	static const SymbolTemplates templates;
+	return templates;
+}
+
+/*
+Build a decoding table for a canonical Huffman code.
+
+@param lengths The code length of every symbol, 0 for unused symbols.
+@param templates Table entries for every symbol, without the code length.
+
+@return `false` if the code lengths do not describe a valid prefix code.
+Incomplete codes are accepted, their unused entries are marked as invalid.
+*/
+static bool build_table(const Uint8* lengths, unsigned int count,
+						const std::uint32_t* templates,
+						unsigned int primary_bits,
+						std::vector<std::uint32_t>& table) {
+	std::array<unsigned int, MAX_CODE_LENGTH + 1> counts{};
+	for (unsigned int i = 0; i < count; i++) {
+		counts[lengths[i]]++;
+	}
+	counts[0] = 0;
+
+	// Reject over-subscribed codes.
+	int left = 1;
+	for (unsigned int length = 1; length <= MAX_CODE_LENGTH; length++) {
+		left = left * 2 - static_cast<int>(counts[length]);
+		if (left < 0) {
+			return false;
+		}
+	}
+
+	// Assign canonical codes and reverse them, since DEFLATE stores Huffman
+	// codes starting with the most significant bit.
+	std::array<unsigned int, MAX_CODE_LENGTH + 1> next_code{};
+	unsigned int code = 0;
+	for (unsigned int length = 1; length <= MAX_CODE_LENGTH; length++) {
+		code = (code + counts[length - 1]) << 1;
+		next_code[length] = code;
+	}
+	std::array<unsigned int, LITERAL_SYMBOLS> codes{};
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int length = lengths[i];
+		if (length == 0) {
+			continue;
+		}
+		unsigned int forward = next_code[length]++;
+		unsigned int reversed = 0;
+		for (unsigned int bit = 0; bit < length; bit++) {
+			reversed = (reversed << 1) | ((forward >> bit) & 1);
+		}
+		codes[i] = reversed;
+	}
+
+	// Size the subtables, one per primary index shared by long codes.
+	const unsigned int primary_size = 1u << primary_bits;
+	const unsigned int primary_mask = primary_size - 1;
+	table.assign(primary_size, FLAG_INVALID);
+	std::array<Uint8, 1u << LITERAL_PRIMARY_BITS> subtable_bits{};
+	for (unsigned int i = 0; i < count; i++) {
+		if (lengths[i] > primary_bits) {
+			Uint8& bits = subtable_bits[codes[i] & primary_mask];
+			bits =
+				std::max(bits, static_cast<Uint8>(lengths[i] - primary_bits));
+		}
+	}
+	for (unsigned int index = 0; index < primary_size; index++) {
+		if (subtable_bits[index] != 0) {
+			auto offset = static_cast<std::uint32_t>(table.size());
+			table[index] = FLAG_SUBTABLE | (offset << 16) |
+						   (static_cast<std::uint32_t>(subtable_bits[index])
+							<< 8) |
+						   primary_bits;
+			table.resize(table.size() + (1u << subtable_bits[index]),
+						 FLAG_INVALID);
+		}
+	}
+
+	// Fill in every index starting with each code.
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int length = lengths[i];
+		if (length == 0) {
+			continue;
+		}
+		if (length <= primary_bits) {
+			for (unsigned int index = codes[i]; index < primary_size;
+				 index += 1u << length) {
+				table[index] = templates[i] | length;
+			}
+		} else {
+			std::uint32_t pointer = table[codes[i] & primary_mask];
+			unsigned int offset = pointer >> 16;
+			unsigned int size = 1u << ((pointer >> 8) & 0xf);
+			unsigned int remaining = length - primary_bits;
+			for (unsigned int index = codes[i] >> primary_bits; index < size;
+				 index += 1u << remaining) {
+				table[offset + index] = templates[i] | remaining;
+			}
+		}
+	}
+	return true;
+}
+
+namespace {
+
+// Decoding tables of the fixed Huffman codes of DEFLATE.
+struct FixedTables {
+	std::vector<std::uint32_t> literal;
+	std::vector<std::uint32_t> distance;
+
+	FixedTables() {
+		std::array<Uint8, LITERAL_SYMBOLS> lengths{};
+		std::fill(lengths.begin(), lengths.begin() + 144, 8);
+		std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+		std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+		std::fill(lengths.begin() + 280, lengths.end(), 8);
+		build_table(lengths.data(), LITERAL_SYMBOLS,
+					symbol_templates().literal.data(), LITERAL_PRIMARY_BITS,
+					literal);
+		lengths.fill(5);
+		build_table(lengths.data(), DISTANCE_SYMBOLS,
+					symbol_templates().distance.data(), DISTANCE_PRIMARY_BITS,
+					distance);
+	}
+};
+
+}  // namespace
+
+static const FixedTables& fixed_tables() {
+	static const FixedTables tables;
+	return tables;
+}
+
+std::size_t Inflater::buffer_limit_for(std::size_t max_request) {
+	// Decode in chunks of at least 256 KiB to keep the cost of sliding the
+	// window down small compared to the cost of decoding.
+	const std::size_t chunk = std::max<std::size_t>(max_request, 262144);
+	return WINDOW_SIZE + 2 * chunk + MAX_MATCH;
+}
+
+Inflater::Inflater(Input input, std::size_t max_request)
+	: input(std::move(input)),
+	  in{nullptr},
+	  in_end{nullptr},
+	  input_done{false},
+	  overrun{0},
+	  bits{0},
+	  bit_count{0},
+	  state{STATE_ZLIB_HEADER},
+	  final_block{false},
+	  stored_remaining{0},
+	  literal_codes{nullptr},
+	  distance_codes{nullptr},
+	  read_position{0},
+	  write_position{0} {
+	buffer_limit = buffer_limit_for(max_request);
+	buffer.resize(buffer_limit + COPY_SLACK);
+}
+
+std::size_t Inflater::memory(std::size_t max_request) {
+	// Every code longer than the primary bits may add a subtable as large as
+	// the longest code allows, and the tables may be twice their size after
+	// growing.
+	const std::size_t table_entries =
+		(std::size_t{1} << LITERAL_PRIMARY_BITS) +
+		LITERAL_SYMBOLS * (std::size_t{1}
+						   << (MAX_CODE_LENGTH - LITERAL_PRIMARY_BITS)) +
+		(std::size_t{1} << DISTANCE_PRIMARY_BITS) +
+		DISTANCE_SYMBOLS * (std::size_t{1}
+							<< (MAX_CODE_LENGTH - DISTANCE_PRIMARY_BITS)) +
+		(std::size_t{1} << CODE_LENGTH_PRIMARY_BITS);
+	return buffer_limit_for(max_request) + COPY_SLACK +
+		   2 * table_entries * sizeof(std::uint32_t);
+}
+
+InflateStatus Inflater::fail(const char* message) {
+	state = STATE_ERROR;
+	SDL_SetError("Invalid compressed data: %s", message);
+	return INFLATE_ERROR;
+}
+
+// Top up the bit buffer one byte at a time, moving on to the next piece of
+// input when needed. Zero bits are used once the input runs out.
+void Inflater::refill_slow() {
+	while (bit_count <= 56) {
+		if (in == in_end) {
+			std::size_t size = 0;
+			if (!input_done && input(in, size)) {
+				in_end = in + size;
+				continue;
+			}
+			input_done = true;
+			in = in_end = nullptr;
+			overrun++;
+			bit_count += 8;
+			continue;
+		}
+		bits |= static_cast<std::uint64_t>(*in++) << bit_count;
+		bit_count += 8;
+	}
+}
+
+// Make sure that there are at least 56 bits in the bit buffer.
+inline void Inflater::refill() {
+	if (in_end - in >= 8) {
+		std::uint64_t word = 0;
+		std::memcpy(&word, in, sizeof(word));
+		bits |= SDL_Swap64LE(word) << bit_count;
+		in += (63 - bit_count) >> 3;
+		bit_count |= 56;
+	} else {
+		refill_slow();
+	}
+}
+
+// Move the data that is still needed to the start of the buffer.
+void Inflater::slide() {
+	std::size_t keep = write_position > WINDOW_SIZE
+						   ? write_position - WINDOW_SIZE
+						   : 0;
+	keep = std::min(keep, read_position);
+	if (keep == 0) {
+		return;
+	}
+	std::memmove(buffer.data(), buffer.data() + keep, write_position - keep);
+	read_position -= keep;
+	write_position -= keep;
+}
+
+bool Inflater::read_zlib_header() {
+	refill();
+	unsigned int cmf = bits & 0xff;
+	unsigned int flg = (bits >> 8) & 0xff;
+	bits >>= 16;
+	bit_count -= 16;
+	if ((cmf & 0xf) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31 != 0) {
+		fail("bad zlib header");
+		return false;
+	}
+	if (flg & 0x20) {
+		fail("preset dictionaries are not supported");
+		return false;
+	}
+	state = STATE_BLOCK_HEADER;
+	return true;
+}
+
+bool Inflater::read_block_header() {
+	refill();
+	final_block = bits & 1;
+	unsigned int type = (bits >> 1) & 3;
+	bits >>= 3;
+	bit_count -= 3;
+
+	switch (type) {
+		case 0: {
+			// Skip to the next byte boundary.
+			bits >>= bit_count & 7;
+			bit_count -= bit_count & 7;
+			refill();
+			unsigned int length = bits & 0xffff;
+			unsigned int complement = (bits >> 16) & 0xffff;
+			bits >>= 32;
+			bit_count -= 32;
+			if ((length ^ 0xffff) != complement) {
+				fail("corrupt stored block length");
+				return false;
+			}
+			stored_remaining = length;
+			state = STATE_STORED;
+			return true;
+		}
+		case 1:
+			literal_codes = fixed_tables().literal.data();
+			distance_codes = fixed_tables().distance.data();
+			state = STATE_HUFFMAN;
+			return true;
+		case 2:
+			if (!read_dynamic_tables()) {
+				return false;
+			}
+			literal_codes = literal_table.data();
+			distance_codes = distance_table.data();
+			state = STATE_HUFFMAN;
+			return true;
+		default:
+			fail("invalid block type");
+			return false;
+	}
+}
+
+bool Inflater::read_dynamic_tables() {
+	static const Uint8 ORDER[CODE_LENGTH_SYMBOLS] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+	refill();
+	unsigned int literal_count = (bits & 31) + 257;
+	unsigned int distance_count = ((bits >> 5) & 31) + 1;
+	unsigned int code_length_count = ((bits >> 10) & 15) + 4;
+	bits >>= 14;
+	bit_count -= 14;
+	if (literal_count > 286 || distance_count > 30) {
+		fail("too many length or distance codes");
+		return false;
+	}
+
+	std::array<Uint8, CODE_LENGTH_SYMBOLS> code_lengths{};
+	for (unsigned int i = 0; i < code_length_count; i++) {
+		refill();
+		code_lengths[ORDER[i]] = bits & 7;
+		bits >>= 3;
+		bit_count -= 3;
+	}
+	std::vector<std::uint32_t> code_length_table;
+	if (!build_table(code_lengths.data(), CODE_LENGTH_SYMBOLS,
+					 symbol_templates().code_length.data(),
+					 CODE_LENGTH_PRIMARY_BITS, code_length_table)) {
+		fail("invalid code length code");
+		return false;
+	}
+
+	// Literal/length and distance code lengths form a single sequence.
+	std::array<Uint8, LITERAL_SYMBOLS + DISTANCE_SYMBOLS> lengths{};
+	const unsigned int total = literal_count + distance_count;
+	unsigned int i = 0;
+	while (i < total) {
+		refill();
+		std::uint32_t entry =
+			code_length_table[bits & ((1u << CODE_LENGTH_PRIMARY_BITS) - 1)];
+		if (entry & FLAG_INVALID) {
+			fail("invalid code length");
+			return false;
+		}
+		bits >>= entry & 0xff;
+		bit_count -= entry & 0xff;
+
+		unsigned int symbol = entry >> 16;
+		if (symbol < 16) {
+			lengths[i++] = static_cast<Uint8>(symbol);
+			continue;
+		}
+		Uint8 value = 0;
+		unsigned int repeat = 0;
+		if (symbol == 16) {
+			if (i == 0) {
+				fail("repeated code length without a previous length");
+				return false;
+			}
+			value = lengths[i - 1];
+			repeat = 3 + (bits & 3);
+			bits >>= 2;
+			bit_count -= 2;
+		} else if (symbol == 17) {
+			repeat = 3 + (bits & 7);
+			bits >>= 3;
+			bit_count -= 3;
+		} else {
+			repeat = 11 + (bits & 127);
+			bits >>= 7;
+			bit_count -= 7;
+		}
+		if (i + repeat > total) {
+			fail("too many code lengths");
+			return false;
+		}
+		std::fill(lengths.begin() + i, lengths.begin() + i + repeat, value);
+		i += repeat;
+	}
+
+	if (lengths[256] == 0) {
+		fail("missing end-of-block code");
+		return false;
+	}
+	if (!build_table(lengths.data(), literal_count,
+					 symbol_templates().literal.data(), LITERAL_PRIMARY_BITS,
+					 literal_table) ||
+		!build_table(lengths.data() + literal_count, distance_count,
+					 symbol_templates().distance.data(), DISTANCE_PRIMARY_BITS,
+					 distance_table)) {
+		fail("invalid literal/length or distance code");
+		return false;
+	}
+	return true;
+}
+
+bool Inflater::copy_stored() {
+	Uint8* out = buffer.data();
+	while (stored_remaining > 0 && write_position < buffer_limit) {
+		// Bytes that are already in the bit buffer come first.
+		if (bit_count >= 8) {
+			out[write_position++] = bits & 0xff;
+			bits >>= 8;
+			bit_count -= 8;
+			stored_remaining--;
+			continue;
+		}
+		// The bit buffer may hold bits of bytes past the ones it has consumed
+		// (see `refill()`), which are about to be copied directly.
+		bits = 0;
+		if (in == in_end) {
+			std::size_t size = 0;
+			if (input_done || !input(in, size)) {
+				fail("unexpected end of data");
+				return false;
+			}
+			in_end = in + size;
+			continue;
+		}
+		std::size_t size = std::min({stored_remaining,
+									 buffer_limit - write_position,
+									 static_cast<std::size_t>(in_end - in)});
+		std::memcpy(out + write_position, in, size);
+		write_position += size;
+		in += size;
+		stored_remaining -= size;
+	}
+	if (stored_remaining == 0) {
+		state = STATE_BLOCK_HEADER;
+	}
+	return true;
+}
+
+/*
+Decode symbols of a Huffman-coded block until the block ends or the output
+buffer is full.
+
+This is where almost all time is spent, so everything that is used in the loop
+is kept in local variables. Every iteration refills the bit buffer once, which
+is enough for the longest possible length/distance pair (48 bits).
+*/
+bool Inflater::decode_huffman() {
+	const std::uint32_t* literals = literal_codes;
+	const std::uint32_t* distances = distance_codes;
+	const std::uint32_t literal_mask = (1u << LITERAL_PRIMARY_BITS) - 1;
+	const std::uint32_t distance_mask = (1u << DISTANCE_PRIMARY_BITS) - 1;
+	Uint8* out = buffer.data();
+	std::size_t position = write_position;
+
+	while (position <= buffer_limit - MAX_MATCH) {
+		refill();
+		std::uint32_t entry = literals[bits & literal_mask];
+		if (entry & FLAG_SUBTABLE) {
+			bits >>= LITERAL_PRIMARY_BITS;
+			bit_count -= LITERAL_PRIMARY_BITS;
+			entry = literals[(entry >> 16) +
+							 (bits & ((1u << ((entry >> 8) & 0xf)) - 1))];
+		}
+		bits >>= entry & 0xff;
+		bit_count -= entry & 0xff;
+
+		if (entry & FLAG_LITERAL) {
+			out[position++] = static_cast<Uint8>(entry >> 16);
+			continue;
+		}
+		if (entry & (FLAG_END | FLAG_INVALID)) {
+			write_position = position;
+			if (entry & FLAG_INVALID) {
+				fail("invalid literal/length code");
+				return false;
+			}
+			state = STATE_BLOCK_HEADER;
+			return true;
+		}
+
+		unsigned int extra = (entry >> 8) & 0xf;
+		std::size_t length = (entry >> 16) + (bits & ((1u << extra) - 1));
+		bits >>= extra;
+		bit_count -= extra;
+
+		entry = distances[bits & distance_mask];
+		if (entry & FLAG_SUBTABLE) {
+			bits >>= DISTANCE_PRIMARY_BITS;
+			bit_count -= DISTANCE_PRIMARY_BITS;
+			entry = distances[(entry >> 16) +
+							  (bits & ((1u << ((entry >> 8) & 0xf)) - 1))];
+		}
+		bits >>= entry & 0xff;
+		bit_count -= entry & 0xff;
+		extra = (entry >> 8) & 0xf;
+		std::size_t distance = (entry >> 16) + (bits & ((1u << extra) - 1));
+		bits >>= extra;
+		bit_count -= extra;
+		if ((entry & FLAG_INVALID) || distance > position) {
+			write_position = position;
+			fail("invalid distance");
+			return false;
+		}
+
+		// Copy eight bytes at a time when the source and destination do not
+		// overlap within a word. This may write past the end of the match,
+		// which is harmless since that data is overwritten later and the
+		// buffer has some slack at the end.
+		Uint8* destination = out + position;
+		const Uint8* source = destination - distance;
+		if (distance >= 8) {
+			Uint8* end = destination + length;
+			do {
+				std::memcpy(destination, source, 8);
+				destination += 8;
+				source += 8;
+			} while (destination < end);
+		} else if (distance == 1) {
+			std::memset(destination, *source, length);
+		} else {
+			for (std::size_t i = 0; i < length; i++) {
+				destination[i] = source[i];
+			}
+		}
+		position += length;
+	}
+
+	write_position = position;
+	return true;
+}
+
+InflateStatus Inflater::fill(std::size_t size) {
+	while (write_position - read_position < size) {
+		if (buffer_limit - write_position < MAX_MATCH) {
+			slide();
+		}
+		switch (state) {
+			case STATE_ZLIB_HEADER:
+				read_zlib_header();
+				break;
+			case STATE_BLOCK_HEADER:
+				if (final_block) {
+					state = STATE_END;
+				} else {
+					read_block_header();
+				}
+				break;
+			case STATE_STORED:
+				copy_stored();
+				break;
+			case STATE_HUFFMAN:
+				decode_huffman();
+				break;
+			case STATE_END:
+				return INFLATE_END;
+			case STATE_ERROR:
+				return INFLATE_ERROR;
+		}
+
+		// Zero bits past the end of the input have been consumed.
+		if (state != STATE_ERROR && overrun * 8 > bit_count) {
+			return fail("unexpected end of data");
+		}
+	}
+	return state == STATE_ERROR ? INFLATE_ERROR : INFLATE_OK;
+}
@@ -0,0 +1,138 @@
+#ifndef SRC_INFLATE_H_
+#define SRC_INFLATE_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Result of `Inflater::fill()`.
+enum InflateStatus {
+	INFLATE_OK,	   // The requested number of bytes is available.
+	INFLATE_END,   // The stream has ended, fewer bytes may be available.
+	INFLATE_ERROR  // The stream is invalid or truncated.
+};
+
+/*
+Decompressor for zlib (RFC 1950) streams containing DEFLATE (RFC 1951) data.
+
+Compressed data is pulled from an input callback, which makes it possible to
+decompress data that is split into several pieces (such as the IDAT chunks of a
+PNG file) without first joining the pieces. Decompressed data is produced into
+an internal buffer that only holds the 32 KiB history needed by DEFLATE plus
+the data that has not been consumed yet, so the full output never needs to be
+held in memory at once:
+
+	while (inflater.fill(row_size) == INFLATE_OK) {
+		use(inflater.data(), row_size);
+		inflater.consume(row_size);
+	}
+
+Like stb_image, the Adler-32 checksum of the stream is not verified.
+*/
+class Inflater {
+   public:
+	/*
+	Input callback. Should point `data` and `size` at the next piece of
+	compressed data and return `true`, or return `false` at the end of input.
+	Pieces must stay valid until the inflater is destroyed.
+	*/
+	using Input = std::function<bool(const Uint8*& data, std::size_t& size)>;
+
+   private:
+	// Size of the history window of DEFLATE.
+	static constexpr std::size_t WINDOW_SIZE = 32768;
+
+	// Longest match, i.e. the most output a single symbol can produce.
+	static constexpr std::size_t MAX_MATCH = 258;
+
+	enum State {
+		STATE_ZLIB_HEADER,
+		STATE_BLOCK_HEADER,
+		STATE_STORED,
+		STATE_HUFFMAN,
+		STATE_END,
+		STATE_ERROR
+	};
+
+	Input input;
+	const Uint8* in;
+	const Uint8* in_end;
+	bool input_done;
+	std::size_t overrun;  // Zero bytes fed to the bit buffer past the input.
+	std::uint64_t bits;	  // Bit buffer, the next bit is the lowest one.
+	unsigned int bit_count;
+
+	State state;
+	bool final_block;
+	std::size_t stored_remaining;
+
+	// Decoding tables of the current block, see `build_table()` in
+	// inflate.cpp. Blocks using the fixed codes point to shared tables.
+	const std::uint32_t* literal_codes;
+	const std::uint32_t* distance_codes;
+	std::vector<std::uint32_t> literal_table;
+	std::vector<std::uint32_t> distance_table;
+
+	// Output buffer. `buffer[read_position, write_position)` has not been
+	// consumed yet, and everything before `write_position` may be referenced
+	// by matches. Decoding stops at `buffer_limit`.
+	std::vector<Uint8> buffer;
+	std::size_t buffer_limit;
+	std::size_t read_position;
+	std::size_t write_position;
+
+	// The `buffer_limit` of an inflater, see the constructor.
+	static std::size_t buffer_limit_for(std::size_t max_request);
+
+	void refill_slow();
+	void refill();
+	void slide();
+	bool read_zlib_header();
+	bool read_block_header();
+	bool read_dynamic_tables();
+	bool copy_stored();
+	bool decode_huffman();
+	InflateStatus fail(const char* message);
+
+   public:
+	/*
+	Create an inflater.
+
+	@param input Callback providing the compressed data.
+	@param max_request The largest `size` that will be passed to `fill()`.
+	*/
+	Inflater(Input input, std::size_t max_request);
+
+	/*
+	The most memory an inflater allocates, for its output buffer and the
+	decoding tables of dynamic blocks.
+
+	@param max_request See the constructor.
+	*/
+	static std::size_t memory(std::size_t max_request);
+
+	Inflater(const Inflater&) = delete;
+	Inflater& operator=(const Inflater&) = delete;
+
+	/*
+	Decompress until at least `size` bytes are available through `data()`,
+	where `size` must not exceed the `max_request` given to the constructor.
+
+	@return `INFLATE_OK` if `size` bytes are available, `INFLATE_END` if the
+	stream ended before that, or `INFLATE_ERROR` (with `SDL_GetError()`
+	describing the error) if the stream is corrupt.
+	*/
+	InflateStatus fill(std::size_t size);
+
+	// The decompressed data that has not been consumed yet.
+	const Uint8* data() const { return buffer.data() + read_position; }
+	std::size_t available() const { return write_position - read_position; }
+
+	// Discard the first `size` available bytes.
+	void consume(std::size_t size) { read_position += size; }
+};
+
+#endif	// SRC_INFLATE_H_
@@ -0,0 +1,1489 @@
+#include "jpeg_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "pixel_packing.h"
+
+namespace {
+
+// Markers handled by the decoder, without the 0xFF in front of them.
+enum Marker {
+	MARKER_SOF0 = 0xC0,	 // Baseline DCT.
+	MARKER_SOF1 = 0xC1,	 // Extended sequential DCT.
+	MARKER_SOF2 = 0xC2,	 // Progressive DCT.
+	MARKER_DHT = 0xC4,
+	MARKER_SOF15 = 0xCF,
+	MARKER_RST0 = 0xD0,
+	MARKER_RST7 = 0xD7,
+	MARKER_SOI = 0xD8,
+	MARKER_EOI = 0xD9,
+	MARKER_SOS = 0xDA,
+	MARKER_DQT = 0xDB,
+	MARKER_DRI = 0xDD,
+	MARKER_APP14 = 0xEE
+};
+
+// Color spaces of the components of an image.
+enum ColorSpace {
+	COLOR_SPACE_GRAY,
+	COLOR_SPACE_YCBCR,
+	COLOR_SPACE_RGB,
+	COLOR_SPACE_CMYK,
+	COLOR_SPACE_YCCK
+};
+
+}  // namespace
+
+// Position of each coefficient of a block, in the order they are coded.
+static const Uint8 ZIGZAG[64] = {
+	0,	1,	8,	16, 9,	2,	3,	10, 17, 24, 32, 25, 18, 11, 4,	5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,	7,	14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Number of bits of Huffman codes decoded with a single table lookup.
+static const int FAST_BITS = 9;
+
+namespace {
+
+struct HuffmanTable {
+	// Length and symbol of the codes of up to `FAST_BITS` bits as
+	// `(length << 8) | symbol`, indexed by the next `FAST_BITS` bits of the
+	// data. Entries of longer codes are 0.
+	std::array<std::uint16_t, 1 << FAST_BITS> fast{};
+	std::array<std::int32_t, 17> max_code{};  // Largest code of each length,
+											  // -1 if there are none.
+	std::array<std::int32_t, 17> offset{};	// Index in `symbols` of the codes
+											// of each length, minus the
+											// first code.
+	std::array<Uint8, 256> symbols{};
+	bool defined = false;
+};
+
+struct SdlFree {
+	void operator()(void* memory) const { SDL_free(memory); }
+};
+
+struct JpegComponent {
+	int id = 0;
+	int h = 1;	// Sampling factors.
+	int v = 1;
+	int quant = 0;
+	int dc_table = 0;  // Huffman tables selected by the current scan.
+	int ac_table = 0;
+	int blocks_x = 0;  // Blocks covering the image, rounded up to whole MCUs.
+	int blocks_y = 0;
+	int block_width = 8;  // Samples each block is transformed into.
+	int block_height = 8;
+	int dc = 0;	 // DC prediction.
+
+	// Coefficients of every block, for images that are not decoded as a
+	// single baseline scan.
+	std::unique_ptr<std::int16_t, SdlFree> coefficients;
+
+	// Samples of the current row of MCUs, and a row upsampled to the width
+	// of the image.
+	std::vector<Uint8> samples;
+	int stride = 0;
+	std::vector<Uint8> upsampled;
+	// The last row of samples of the previous row of MCUs, for images with
+	// context rows.
+	std::vector<Uint8> previous;
+};
+
+struct JpegImage {
+	int width = 0;
+	int height = 0;
+	int scale = 1;		   // The image is decoded at 1 / `scale` of its size,
+	int block_size = 8;	   // so blocks of the components with the most
+	int output_width = 0;  // samples are transformed into `8 / scale` samples
+	int output_height = 0;	// on each side.
+	bool progressive = false;
+	std::array<JpegComponent, 4> components;
+	int component_count = 0;
+	int h_max = 1;
+	int v_max = 1;
+	int mcus_x = 0;
+	int mcus_y = 0;
+	// Whether a component is upsampled vertically from the rows above and
+	// below, so the last row of pixels of every row of MCUs is only converted
+	// with the next one.
+	bool context_rows = false;
+
+	std::array<std::array<std::uint16_t, 64>, 4> quant{};  // Natural order.
+	std::array<HuffmanTable, 4> dc_tables;
+	std::array<HuffmanTable, 4> ac_tables;
+	int restart_interval = 0;
+	int adobe_transform = -1;  // From the Adobe APP14 segment, if any.
+
+	SDL_Surface* surface = nullptr;
+	ColorSpace color = COLOR_SPACE_YCBCR;
+	int scans = 0;
+	bool buffered = false;	// Whether the coefficients are kept until the
+							// last scan.
+	int eob_run = 0;		// Blocks left in the current progressive EOB run.
+};
+
+struct JpegScan {
+	std::array<int, 4> components{};  // Indices in `JpegImage::components`.
+	int count = 0;
+	int start = 0;	// First and last coefficient, in zigzag order.
+	int end = 63;
+	int high = 0;  // Successive approximation: the bit refined by the
+	int low = 0;   // previous scan of the coefficients (0 if there was
+				   // none) and the bit refined by this scan.
+};
+
+/*
+Reads the entropy-coded data of a scan, which ends at the first marker other
+than a restart marker. Reading past the end of the data produces zeros.
+*/
+class BitReader {
+   private:
+	const Uint8* next;
+	const Uint8* end;
+	std::uint64_t buffer;  // The next bits, from the most significant one.
+	int count;			   // Number of bits in `buffer`.
+	bool at_marker;		   // Whether `next` points at a marker.
+
+	void refill() {
+		// Read as many whole bytes as fit at once, unless there may be a
+		// stuffed byte or a marker among them.
+		if (end - next >= 8) {
+			std::uint64_t word;
+			std::memcpy(&word, next, 8);
+			word = SDL_Swap64BE(word);
+			const std::uint64_t ones = 0x0101010101010101u;
+			if (((~word - ones) & word & (ones << 7)) == 0) {
+				const int bits = (64 - count) / 8 * 8;
+				buffer |= (word >> (64 - bits)) << (64 - count - bits);
+				count += bits;
+				next += bits / 8;
+				return;
+			}
+		}
+		while (count <= 56) {
+			std::uint64_t byte = 0;
+			if (!at_marker && next != end) {
+				if (*next != 0xFF) {
+					byte = *next++;
+				} else if (end - next >= 2 && next[1] == 0) {
+					byte = 0xFF;  // A stuffed zero byte.
+					next += 2;
+				} else {
+					at_marker = true;
+				}
+			}
+			buffer |= byte << (56 - count);
+			count += 8;
+		}
+	}
+
+	void skip(int n) {
+		buffer <<= n;
+		count -= n;
+	}
+
+   public:
+	BitReader(const Uint8* data, const Uint8* end)
+		: next{data}, end{end}, buffer{0}, count{0}, at_marker{false} {}
+
+	// Read up to 16 bits.
+	unsigned int bits(int n) {
+		if (count < n) {
+			refill();
+		}
+		auto value = static_cast<unsigned int>(buffer >> (64 - n));
+		skip(n);
+		return value;
+	}
+
+	// Read a signed value of `size` bits, as coded after Huffman codes.
+	int extend(int size) {
+		if (size == 0) {
+			return 0;
+		}
+		auto value = static_cast<int>(bits(size));
+		return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+	}
+
+	// Decode a Huffman code, returning `false` if it is invalid.
+	bool decode(const HuffmanTable& table, int& symbol) {
+		if (count < 16) {
+			refill();
+		}
+		std::uint16_t entry = table.fast[buffer >> (64 - FAST_BITS)];
+		if (entry != 0) {
+			skip(entry >> 8);
+			symbol = entry & 0xFF;
+			return true;
+		}
+		const auto code = static_cast<std::int32_t>(buffer >> 48);
+		for (int length = FAST_BITS + 1; length <= 16; length++) {
+			std::int32_t prefix = code >> (16 - length);
+			if (prefix <= table.max_code[length]) {
+				skip(length);
+				symbol = table.symbols[table.offset[length] + prefix];
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*
+	Skip the rest of the current restart interval and the restart marker
+	following it.
+
+	@return `false` if the next marker is not a restart marker.
+	*/
+	bool restart() {
+		buffer = 0;
+		count = 0;
+		at_marker = false;
+		for (; end - next >= 2; next++) {
+			if (next[0] != 0xFF || next[1] == 0 || next[1] == 0xFF) {
+				continue;
+			}
+			if (next[1] < MARKER_RST0 || next[1] > MARKER_RST7) {
+				return false;
+			}
+			next += 2;
+			return true;
+		}
+		return false;
+	}
+
+	// The position of the first byte that has not been read.
+	const Uint8* position() const { return next; }
+};
+
+}  // namespace
+
+static int read_u16(const Uint8* p) { return (p[0] << 8) | p[1]; }
+
+static int divide_up(int value, int divisor) {
+	return (value + divisor - 1) / divisor;
+}
+
+bool is_jpeg(const Uint8* data, std::size_t size) {
+	return size >= 3 && data[0] == 0xFF && data[1] == MARKER_SOI &&
+		   data[2] == 0xFF;
+}
+
+static bool build_huffman(const Uint8* counts, const Uint8* symbols,
+						  HuffmanTable& table) {
+	table.fast.fill(0);
+	int code = 0;
+	int index = 0;
+	for (int length = 1; length <= 16; length++) {
+		const int count = counts[length - 1];
+		if (code + count > (1 << length)) {
+			return SDL_SetError("Invalid JPEG Huffman table");
+		}
+		table.offset[length] = index - code;
+		for (int i = 0; i < count; i++, code++, index++) {
+			table.symbols[index] = symbols[index];
+			if (length <= FAST_BITS) {
+				// Fill in every entry starting with the code.
+				const int shift = FAST_BITS - length;
+				for (int rest = 0; rest < (1 << shift); rest++) {
+					table.fast[(code << shift) | rest] =
+						static_cast<std::uint16_t>((length << 8) |
+												   symbols[index]);
+				}
+			}
+		}
+		table.max_code[length] = count > 0 ? code - 1 : -1;
+		code <<= 1;
+	}
+	table.defined = true;
+	return true;
+}
+
+static bool read_huffman_tables(const Uint8* segment, std::size_t length,
+								JpegImage& image) {
+	while (length > 0) {
+		if (length < 17 || (segment[0] >> 4) > 1 || (segment[0] & 15) > 3) {
+			return SDL_SetError("Invalid JPEG Huffman table");
+		}
+		std::size_t total = 0;
+		for (int i = 1; i <= 16; i++) {
+			total += segment[i];
+		}
+		if (total > 256 || length < 17 + total) {
+			return SDL_SetError("Invalid JPEG Huffman table");
+		}
+		HuffmanTable& table = (segment[0] >> 4) == 0
+								  ? image.dc_tables[segment[0] & 15]
+								  : image.ac_tables[segment[0] & 15];
+		if (!build_huffman(segment + 1, segment + 17, table)) {
+			return false;
+		}
+		segment += 17 + total;
+		length -= 17 + total;
+	}
+	return true;
+}
+
+static bool read_quant_tables(const Uint8* segment, std::size_t length,
+							  JpegImage& image) {
+	while (length > 0) {
+		const int precision = segment[0] >> 4;	// 0 for 8 bits, 1 for 16.
+		const int index = segment[0] & 15;
+		const std::size_t table_size = 1 + 64 * (precision + 1);
+		if (precision > 1 || index > 3 || length < table_size) {
+			return SDL_SetError("Invalid JPEG quantization table");
+		}
+		for (int k = 0; k < 64; k++) {
+			const int value = precision == 0 ? segment[1 + k]
+											 : read_u16(segment + 1 + k * 2);
+			image.quant[index][ZIGZAG[k]] = static_cast<std::uint16_t>(value);
+		}
+		segment += table_size;
+		length -= table_size;
+	}
+	return true;
+}
+
+/*
+The number of samples blocks of a component are transformed into along one
+direction. Components with fewer samples than others in that direction are
+transformed into more samples where possible, up to the 8 coefficients of the
+block, which keeps more of their detail and saves upsampling them when the
+image is decoded at a reduced size.
+
+@param factor The sampling factor of the component.
+@param max The largest sampling factor of the image.
+*/
+static int block_samples(int block_size, int factor, int max) {
+	const int ratio = max / factor;
+	if (max % factor != 0 || (ratio != 2 && ratio != 4)) {
+		return block_size;
+	}
+	return std::min(block_size * ratio, 8);
+}
+
+static bool read_frame(const Uint8* segment, std::size_t length,
+					   bool progressive, JpegImage& image) {
+	if (length < 6) {
+		return SDL_SetError("Invalid JPEG frame header");
+	}
+	if (segment[0] != 8) {
+		return SDL_SetError("Unsupported JPEG sample precision %d",
+							segment[0]);
+	}
+	image.height = read_u16(segment + 1);
+	image.width = read_u16(segment + 3);
+	image.component_count = segment[5];
+	image.progressive = progressive;
+	if (image.width == 0 || image.height == 0) {
+		// A height of 0 means it is only known after the first scan, which
+		// hardly any file does.
+		return SDL_SetError("Unsupported JPEG image size %dx%d", image.width,
+							image.height);
+	}
+	if (image.component_count != 1 && image.component_count != 3 &&
+		image.component_count != 4) {
+		return SDL_SetError("Unsupported number of JPEG components %d",
+							image.component_count);
+	}
+	if (length < 6 + 3 * static_cast<std::size_t>(image.component_count)) {
+		return SDL_SetError("Invalid JPEG frame header");
+	}
+
+	for (int i = 0; i < image.component_count; i++) {
+		const Uint8* p = segment + 6 + i * 3;
+		JpegComponent& component = image.components[i];
+		component.id = p[0];
+		component.h = p[1] >> 4;
+		component.v = p[1] & 15;
+		component.quant = p[2];
+		if (component.h < 1 || component.h > 4 || component.v < 1 ||
+			component.v > 4 || component.quant > 3) {
+			return SDL_SetError("Invalid JPEG frame header");
+		}
+		// Single component images are not interleaved, so their MCUs are
+		// always single blocks whatever the sampling factors say.
+		if (image.component_count == 1) {
+			component.h = 1;
+			component.v = 1;
+		}
+		image.h_max = std::max(image.h_max, component.h);
+		image.v_max = std::max(image.v_max, component.v);
+	}
+
+	image.mcus_x = divide_up(image.width, 8 * image.h_max);
+	image.mcus_y = divide_up(image.height, 8 * image.v_max);
+	image.output_width = divide_up(image.width, image.scale);
+	image.output_height = divide_up(image.height, image.scale);
+	for (int i = 0; i < image.component_count; i++) {
+		JpegComponent& component = image.components[i];
+		component.blocks_x = image.mcus_x * component.h;
+		component.blocks_y = image.mcus_y * component.v;
+		component.block_width =
+			block_samples(image.block_size, component.h, image.h_max);
+		component.block_height =
+			block_samples(image.block_size, component.v, image.v_max);
+		component.stride = component.blocks_x * component.block_width;
+		component.samples.resize(static_cast<std::size_t>(component.stride) *
+								 component.v * component.block_height);
+		const bool fancy_v = component.v * component.block_height * 2 ==
+							 image.v_max * image.block_size;
+		if (fancy_v || component.h * component.block_width !=
+						   image.h_max * image.block_size) {
+			component.upsampled.resize(image.output_width);
+		}
+		image.context_rows = image.context_rows || fancy_v;
+	}
+	if (image.context_rows) {
+		for (int i = 0; i < image.component_count; i++) {
+			JpegComponent& component = image.components[i];
+			component.previous.resize(component.stride);
+		}
+	}
+	return true;
+}
+
+static bool read_scan(const Uint8* segment, std::size_t length,
+					  JpegImage& image, JpegScan& scan) {
+	if (length < 1) {
+		return SDL_SetError("Invalid JPEG scan header");
+	}
+	scan.count = segment[0];
+	if (scan.count < 1 || scan.count > image.component_count ||
+		length < 4 + 2 * static_cast<std::size_t>(scan.count)) {
+		return SDL_SetError("Invalid JPEG scan header");
+	}
+	for (int i = 0; i < scan.count; i++) {
+		const Uint8* p = segment + 1 + i * 2;
+		int index = 0;
+		while (index < image.component_count &&
+			   image.components[index].id != p[0]) {
+			index++;
+		}
+		if (index == image.component_count || (p[1] >> 4) > 3 ||
+			(p[1] & 15) > 3) {
+			return SDL_SetError("Invalid JPEG scan header");
+		}
+		scan.components[i] = index;
+		image.components[index].dc_table = p[1] >> 4;
+		image.components[index].ac_table = p[1] & 15;
+	}
+	const Uint8* p = segment + 1 + scan.count * 2;
+	scan.start = p[0];
+	scan.end = p[1];
+	scan.high = p[2] >> 4;
+	scan.low = p[2] & 15;
+
+	if (!image.progressive) {
+		// Baseline scans always code every coefficient.
+		scan.start = 0;
+		scan.end = 63;
+		scan.high = 0;
+		scan.low = 0;
+	} else if (scan.start > scan.end || scan.end > 63 || scan.low > 13 ||
+			   (scan.start == 0 && scan.end != 0) ||
+			   (scan.start > 0 && scan.count != 1)) {
+		return SDL_SetError("Invalid JPEG progressive scan");
+	}
+
+	// Check that the Huffman tables the scan needs have been defined.
+	const bool needs_dc = scan.start == 0 && scan.high == 0;
+	const bool needs_ac = scan.end > 0;
+	for (int i = 0; i < scan.count; i++) {
+		const JpegComponent& component = image.components[scan.components[i]];
+		if ((needs_dc && !image.dc_tables[component.dc_table].defined) ||
+			(needs_ac && !image.ac_tables[component.ac_table].defined)) {
+			return SDL_SetError("JPEG scan uses an undefined Huffman table");
+		}
+	}
+	return true;
+}
+
+static ColorSpace color_space(const JpegImage& image) {
+	if (image.component_count == 1) {
+		return COLOR_SPACE_GRAY;
+	}
+	if (image.component_count == 4) {
+		return image.adobe_transform == 2 ? COLOR_SPACE_YCCK
+										  : COLOR_SPACE_CMYK;
+	}
+	const bool rgb_ids = image.components[0].id == 'R' &&
+						 image.components[1].id == 'G' &&
+						 image.components[2].id == 'B';
+	if (image.adobe_transform == 0 ||
+		(image.adobe_transform < 0 && rgb_ids)) {
+		return COLOR_SPACE_RGB;
+	}
+	return COLOR_SPACE_YCBCR;
+}
+
+// Decode a block of a baseline scan.
+static bool decode_block(BitReader& reader, const HuffmanTable& dc_table,
+						 const HuffmanTable& ac_table, int& dc,
+						 std::int16_t* block) {
+	int symbol = 0;
+	if (!reader.decode(dc_table, symbol) || symbol > 16) {
+		return false;
+	}
+	dc = static_cast<std::int16_t>(dc + reader.extend(symbol));
+	block[0] = static_cast<std::int16_t>(dc);
+	for (int k = 1; k < 64;) {
+		if (!reader.decode(ac_table, symbol)) {
+			return false;
+		}
+		const int run = symbol >> 4;
+		const int size = symbol & 15;
+		if (size == 0) {
+			if (run != 15) {
+				break;	// End of block.
+			}
+			k += 16;
+			continue;
+		}
+		k += run;
+		if (k > 63) {
+			return false;
+		}
+		block[ZIGZAG[k++]] = static_cast<std::int16_t>(reader.extend(size));
+	}
+	return true;
+}
+
+// Decode the DC coefficient of a block of the first progressive scan.
+static bool decode_dc_first(BitReader& reader, const HuffmanTable& dc_table,
+							int shift, int& dc, std::int16_t* block) {
+	int symbol = 0;
+	if (!reader.decode(dc_table, symbol) || symbol > 16) {
+		return false;
+	}
+	dc = static_cast<std::int16_t>(dc + reader.extend(symbol));
+	block[0] = static_cast<std::int16_t>(dc * (1 << shift));
+	return true;
+}
+
+// Decode a band of AC coefficients of a block of its first progressive scan.
+static bool decode_ac_first(BitReader& reader, const HuffmanTable& ac_table,
+							const JpegScan& scan, int& eob_run,
+							std::int16_t* block) {
+	if (eob_run > 0) {
+		eob_run--;
+		return true;
+	}
+	for (int k = scan.start; k <= scan.end;) {
+		int symbol = 0;
+		if (!reader.decode(ac_table, symbol)) {
+			return false;
+		}
+		const int run = symbol >> 4;
+		const int size = symbol & 15;
+		if (size == 0) {
+			if (run < 15) {
+				// End of this block and of the next `eob_run` blocks.
+				eob_run = (1 << run) - 1;
+				if (run > 0) {
+					eob_run += static_cast<int>(reader.bits(run));
+				}
+				break;
+			}
+			k += 16;
+			continue;
+		}
+		k += run;
+		if (k > scan.end) {
+			return false;
+		}
+		block[ZIGZAG[k++]] =
+			static_cast<std::int16_t>(reader.extend(size) * (1 << scan.low));
+	}
+	return true;
+}
+
+/*
+Decode the next bit of a band of AC coefficients of a block. Coefficients that
+are already nonzero get a correction bit each, and newly nonzero coefficients
+are coded like in the first scan.
+*/
+static bool decode_ac_refine(BitReader& reader, const HuffmanTable& ac_table,
+							 const JpegScan& scan, int& eob_run,
+							 std::int16_t* block) {
+	const int bit = 1 << scan.low;
+	auto refine = [&reader, bit](std::int16_t& coefficient) {
+		if (reader.bits(1) != 0 && (coefficient & bit) == 0) {
+			coefficient = static_cast<std::int16_t>(
+				coefficient + (coefficient > 0 ? bit : -bit));
+		}
+	};
+
+	int k = scan.start;
+	if (eob_run == 0) {
+		while (k <= scan.end) {
+			int symbol = 0;
+			if (!reader.decode(ac_table, symbol)) {
+				return false;
+			}
+			int run = symbol >> 4;
+			const int size = symbol & 15;
+			int value = 0;
+			if (size == 0) {
+				if (run < 15) {
+					eob_run = 1 << run;
+					if (run > 0) {
+						eob_run += static_cast<int>(reader.bits(run));
+					}
+					break;
+				}
+				// Otherwise a run of 16 zero coefficients.
+			} else if (size == 1) {
+				value = reader.bits(1) != 0 ? bit : -bit;
+			} else {
+				return false;
+			}
+
+			// Skip `run` coefficients that are still zero, refining the
+			// nonzero ones on the way, and put the new value in the next one.
+			for (; k <= scan.end; k++) {
+				std::int16_t& coefficient = block[ZIGZAG[k]];
+				if (coefficient != 0) {
+					refine(coefficient);
+				} else if (run == 0) {
+					coefficient = static_cast<std::int16_t>(value);
+					k++;
+					break;
+				} else {
+					run--;
+				}
+			}
+		}
+	}
+	if (eob_run > 0) {
+		// The rest of the band only has correction bits.
+		for (; k <= scan.end; k++) {
+			std::int16_t& coefficient = block[ZIGZAG[k]];
+			if (coefficient != 0) {
+				refine(coefficient);
+			}
+		}
+		eob_run--;
+	}
+	return true;
+}
+
+// Decode a block of any kind of scan.
+static bool decode_scan_block(JpegImage& image, const JpegScan& scan,
+							  JpegComponent& component, BitReader& reader,
+							  std::int16_t* block) {
+	const HuffmanTable& dc_table = image.dc_tables[component.dc_table];
+	const HuffmanTable& ac_table = image.ac_tables[component.ac_table];
+	if (!image.progressive) {
+		return decode_block(reader, dc_table, ac_table, component.dc, block);
+	}
+	if (scan.start == 0) {
+		if (scan.high == 0) {
+			return decode_dc_first(reader, dc_table, scan.low, component.dc,
+								   block);
+		}
+		if (reader.bits(1) != 0) {
+			block[0] = static_cast<std::int16_t>(block[0] | (1 << scan.low));
+		}
+		return true;
+	}
+	if (scan.high == 0) {
+		return decode_ac_first(reader, ac_table, scan, image.eob_run, block);
+	}
+	return decode_ac_refine(reader, ac_table, scan, image.eob_run, block);
+}
+
+static std::uint32_t clamp_sample(int value) {
+	return static_cast<std::uint32_t>(std::clamp(value, 0, 255));
+}
+
+// Fixed point precision of the IDCT.
+static const int CONST_BITS = 13;
+static const int PASS1_BITS = 2;
+
+/*
+One-dimensional 8 point IDCT, using the accurate integer algorithm of the
+Independent JPEG Group (Loeffler, Ligtenberg and Moschytz). The results are
+scaled up by `CONST_BITS` bits.
+
+The arithmetic is done on unsigned integers, which wrap around where corrupt
+images would overflow signed ones, and give the same results as signed
+arithmetic for valid images.
+
+@param values The values to transform in place.
+@param step The distance between the values.
+*/
+static void idct_1d(std::uint32_t* values, int step) {
+	const std::uint32_t* in = values;
+	std::uint32_t* out = values;
+	// Even part.
+	std::uint32_t z1 = (in[2 * step] + in[6 * step]) * 4433u;  // 0.541196100
+	std::uint32_t tmp2 = z1 - in[6 * step] * 15137u;		   // 1.847759065
+	std::uint32_t tmp3 = z1 + in[2 * step] * 6270u;			   // 0.765366865
+	std::uint32_t tmp0 = (in[0] + in[4 * step]) << CONST_BITS;
+	std::uint32_t tmp1 = (in[0] - in[4 * step]) << CONST_BITS;
+	const std::uint32_t tmp10 = tmp0 + tmp3;
+	const std::uint32_t tmp13 = tmp0 - tmp3;
+	const std::uint32_t tmp11 = tmp1 + tmp2;
+	const std::uint32_t tmp12 = tmp1 - tmp2;
+
+	// Odd part.
+	tmp0 = in[7 * step];
+	tmp1 = in[5 * step];
+	tmp2 = in[3 * step];
+	tmp3 = in[step];
+	z1 = tmp0 + tmp3;
+	std::uint32_t z2 = tmp1 + tmp2;
+	std::uint32_t z3 = tmp0 + tmp2;
+	std::uint32_t z4 = tmp1 + tmp3;
+	const std::uint32_t z5 = (z3 + z4) * 9633u;	 // 1.175875602
+	tmp0 *= 2446u;								 // 0.298631336
+	tmp1 *= 16819u;								 // 2.053119869
+	tmp2 *= 25172u;								 // 3.072711026
+	tmp3 *= 12299u;								 // 1.501321110
+	z1 *= 0u - 7373u;							 // -0.899976223
+	z2 *= 0u - 20995u;							 // -2.562915447
+	z3 = z3 * (0u - 16069u) + z5;				 // -1.961570560
+	z4 = z4 * (0u - 3196u) + z5;				 // -0.390180644
+	tmp0 += z1 + z3;
+	tmp1 += z2 + z4;
+	tmp2 += z2 + z3;
+	tmp3 += z1 + z4;
+
+	out[0] = tmp10 + tmp3;
+	out[7 * step] = tmp10 - tmp3;
+	out[step] = tmp11 + tmp2;
+	out[6 * step] = tmp11 - tmp2;
+	out[2 * step] = tmp12 + tmp1;
+	out[5 * step] = tmp12 - tmp1;
+	out[3 * step] = tmp13 + tmp0;
+	out[4 * step] = tmp13 - tmp0;
+}
+
+// Round away the fractional bits of a result of `idct_1d()`.
+static std::int32_t descale(std::uint32_t value, int bits) {
+	return static_cast<std::int32_t>(value + (1u << (bits - 1))) >> bits;
+}
+
+// Whether the values of a column or row after the first one are all zero.
+static bool is_flat(const std::uint32_t* values, int step) {
+	std::uint32_t rest = 0;
+	for (int i = 1; i < 8; i++) {
+		rest |= values[i * step];
+	}
+	return rest == 0;
+}
+
+/*
+Dequantize a block and transform it back to samples. Columns and rows without
+AC coefficients are common and constant, so they are not transformed.
+*/
+static void idct_block(const std::int16_t* block, const std::uint16_t* quant,
+					   Uint8* out, int stride) {
+	std::array<std::uint32_t, 64> workspace;
+	for (int k = 0; k < 64; k++) {
+		workspace[k] = static_cast<std::uint32_t>(block[k] * quant[k]);
+	}
+
+	// Columns, keeping `PASS1_BITS` bits of the fractions.
+	for (int x = 0; x < 8; x++) {
+		std::uint32_t* column = workspace.data() + x;
+		if (is_flat(column, 8)) {
+			for (int y = 1; y < 8; y++) {
+				column[y * 8] = column[0] << PASS1_BITS;
+			}
+			column[0] <<= PASS1_BITS;
+			continue;
+		}
+		idct_1d(column, 8);
+		for (int y = 0; y < 8; y++) {
+			column[y * 8] = static_cast<std::uint32_t>(
+				descale(column[y * 8], CONST_BITS - PASS1_BITS));
+		}
+	}
+
+	// Rows, which also undo the scaling by 8 of the DCT and shift the samples
+	// back to unsigned values.
+	const int shift = CONST_BITS + PASS1_BITS + 3;
+	for (int y = 0; y < 8; y++) {
+		std::uint32_t* row = workspace.data() + y * 8;
+		Uint8* samples = out + y * stride;
+		if (is_flat(row, 1)) {
+			const std::uint32_t value =
+				clamp_sample(descale(row[0], PASS1_BITS + 3) + 128);
+			std::memset(samples, static_cast<int>(value), 8);
+			continue;
+		}
+		idct_1d(row, 1);
+		for (int x = 0; x < 8; x++) {
+			samples[x] =
+				static_cast<Uint8>(clamp_sample(descale(row[x], shift) + 128));
+		}
+	}
+}
+
+/*
+Weights of the IDCTs of 1, 2, 4 and 8 points, used for decoding at a reduced
+size: the contribution of frequency `u` to sample `x` of a row of `size`
+samples is at `[x * size + u]`, including the normalization of the DCT.
+*/
+static const float* reduced_weights(int size) {
+	static const auto weights = [] {
+		std::array<std::array<float, 64>, 4> tables{};
+		for (int i = 0; i < 4; i++) {
+			const int size = 1 << i;
+			for (int x = 0; x < size; x++) {
+				for (int u = 0; u < size; u++) {
+					const double c = u == 0 ? SDL_sqrt(0.5) : 1.0;
+					const double angle =
+						(2 * x + 1) * u * SDL_PI_D / (2 * size);
+					tables[i][x * size + u] =
+						static_cast<float>(c / 2 * SDL_cos(angle));
+				}
+			}
+		}
+		return tables;
+	}();
+	return weights[size == 8 ? 3 : size / 2].data();
+}
+
+/*
+Dequantize a block and transform it into `width` x `height` samples (each 1, 2,
+4 or 8), for decoding at a reduced size. Only the lowest `width` and `height`
+frequencies are used, with IDCTs of that many points, which samples the block
+low-pass filtered to the new size at the center of each output sample. That is
+the scaled block without aliasing, at a fraction of the cost of a full IDCT
+followed by averaging.
+*/
+static void idct_reduced(const std::int16_t* block, const std::uint16_t* quant,
+						 int width, int height, Uint8* out, int stride) {
+	if (width == 1 && height == 1) {
+		// The average of the block, which is the DC coefficient divided by 8.
+		const int dc = block[0] * quant[0];
+		out[0] = static_cast<Uint8>(clamp_sample(((dc + 4) >> 3) + 128));
+		return;
+	}
+
+	const float* column_weights = reduced_weights(height);
+	const float* row_weights = reduced_weights(width);
+	std::array<float, 64> columns;	// Indexed by `[y * width + u]`.
+	for (int u = 0; u < width; u++) {
+		for (int y = 0; y < height; y++) {
+			float sum = 0;
+			for (int v = 0; v < height; v++) {
+				sum += column_weights[y * height + v] *
+					   static_cast<float>(block[v * 8 + u] * quant[v * 8 + u]);
+			}
+			columns[y * width + u] = sum;
+		}
+	}
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float sum = 128.5f;
+			for (int u = 0; u < width; u++) {
+				sum += row_weights[x * width + u] * columns[y * width + u];
+			}
+			out[y * stride + x] =
+				static_cast<Uint8>(std::clamp(sum, 0.0f, 255.0f));
+		}
+	}
+}
+
+// Transform a block into the samples of the current row of MCUs.
+static void output_block(const JpegImage& image, JpegComponent& component,
+						 const std::int16_t* block, int x, int v) {
+	const int width = component.block_width;
+	const int height = component.block_height;
+	const std::uint16_t* quant = image.quant[component.quant].data();
+	Uint8* out =
+		component.samples.data() + v * height * component.stride + x * width;
+	if (width == 8 && height == 8) {
+		idct_block(block, quant, out, component.stride);
+	} else {
+		idct_reduced(block, quant, width, height, out, component.stride);
+	}
+}
+
+// Multiply two samples as fractions of 255.
+static std::uint32_t multiply_samples(std::uint32_t a, std::uint32_t b) {
+	std::uint32_t t = a * b + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+// Convert YCbCr samples to RGB, using the JFIF coefficients with 16 fractional
+// bits.
+static void ycbcr_to_rgb(int y, int cb, int cr, std::uint32_t& r,
+						 std::uint32_t& g, std::uint32_t& b) {
+	const int luma = (y << 16) + (1 << 15);
+	cb -= 128;
+	cr -= 128;
+	r = clamp_sample((luma + cr * 91881) >> 16);
+	g = clamp_sample((luma - cb * 22554 - cr * 46802) >> 16);
+	b = clamp_sample((luma + cb * 116130) >> 16);
+}
+
+/*
+Get the samples of a component for a row of pixels, upsampled to the width of
+the image.
+
+Components with half as many samples as pixels in a direction are upsampled
+like libjpeg's "fancy" upsampling does, by interpolating each pixel from the
+nearest samples with the triangle filter, weighting them 3/4 and 1/4.
+Components subsampled by other factors are upsampled by replicating their
+samples.
+
+@param first The first row of pixels of the current row of MCUs.
+@param y The row of pixels, in the current row of MCUs or the last row of the
+previous one.
+*/
+static const Uint8* component_row(const JpegImage& image,
+								  JpegComponent& component, int first, int y) {
+	const int mcu_height = image.block_size * image.v_max;
+	const int mcu_width = image.block_size * image.h_max;
+	const int across = component.h * component.block_width;
+	const int down = component.v * component.block_height;
+	const int width = image.output_width;
+	const int first_row = first / mcu_height * down;
+	const int last_row = divide_up(image.output_height * down, mcu_height) - 1;
+	auto row_at = [&](int row) -> const Uint8* {
+		row = std::clamp(row, 0, last_row);
+		if (row < first_row) {
+			return component.previous.data();
+		}
+		return component.samples.data() +
+			   static_cast<std::size_t>(row - first_row) * component.stride;
+	};
+
+	const bool fancy_v = down * 2 == mcu_height;
+	const bool fancy_h = across * 2 == mcu_width;
+	const int row = y * down / mcu_height;
+	const Uint8* near = row_at(row);
+	if (!fancy_v && across == mcu_width) {
+		return near;
+	}
+	Uint8* upsampled = component.upsampled.data();
+	const int last_column = divide_up(width * across, mcu_width) - 1;
+	if (fancy_v) {
+		// Sum the nearer row of samples weighted by 3 with the farther one.
+		const Uint8* far = row_at(y % 2 == 0 ? row - 1 : row + 1);
+		auto column_sum = [&](int column) {
+			column = std::clamp(column, 0, last_column);
+			return 3 * near[column] + far[column];
+		};
+		if (fancy_h) {
+			int left = column_sum(0);
+			int middle = left;
+			for (int x = 0; x < width; x += 2) {
+				const int right = column_sum((x >> 1) + 1);
+				upsampled[x] =
+					static_cast<Uint8>((3 * middle + left + 8) >> 4);
+				if (x + 1 < width) {
+					upsampled[x + 1] =
+						static_cast<Uint8>((3 * middle + right + 7) >> 4);
+				}
+				left = middle;
+				middle = right;
+			}
+		} else {
+			const int bias = y % 2 == 0 ? 1 : 2;
+			for (int x = 0; x < width; x++) {
+				upsampled[x] = static_cast<Uint8>(
+					(column_sum(x * across / mcu_width) + bias) >> 2);
+			}
+		}
+	} else if (fancy_h) {
+		for (int x = 0; x < width; x += 2) {
+			const int column = x >> 1;
+			const int middle = 3 * near[column];
+			upsampled[x] = static_cast<Uint8>(
+				(middle + near[std::max(column - 1, 0)] + 1) >> 2);
+			if (x + 1 < width) {
+				upsampled[x + 1] = static_cast<Uint8>(
+					(middle + near[std::min(column + 1, last_column)] + 2) >>
+					2);
+			}
+		}
+	} else {
+		for (int x = 0; x < width; x++) {
+			upsampled[x] = near[x * across / mcu_width];
+		}
+	}
+	return upsampled;
+}
+
+/*
+Convert the samples of a row of MCUs to pixels of the surface. For images with
+context rows, the last row of pixels waits for the samples of the next row of
+MCUs, and the one left over from the previous row of MCUs is converted first.
+
+@return The number of rows at the top of the surface which are final.
+*/
+static int convert_rows(JpegImage& image, const PixelPacking& packing,
+						int mcu_row) {
+	const int mcu_height = image.block_size * image.v_max;
+	const int first = mcu_row * mcu_height;
+	int start = first;
+	int end = std::min(first + mcu_height, image.output_height);
+	if (image.context_rows) {
+		start = std::max(first - 1, 0);
+		end = end == image.output_height ? end : end - 1;
+	}
+	const int width = image.output_width;
+	std::array<const Uint8*, 4> rows{};
+	for (int y = start; y < end; y++) {
+		for (int i = 0; i < image.component_count; i++) {
+			rows[i] = component_row(image, image.components[i], first, y);
+		}
+
+		auto* out = reinterpret_cast<std::uint32_t*>(
+			static_cast<Uint8*>(image.surface->pixels) +
+			static_cast<std::size_t>(y) * image.surface->pitch);
+		std::uint32_t r = 0;
+		std::uint32_t g = 0;
+		std::uint32_t b = 0;
+		switch (image.color) {
+			case COLOR_SPACE_GRAY:
+				for (int x = 0; x < width; x++) {
+					out[x] = packing.pack(rows[0][x], rows[0][x], rows[0][x],
+										  255);
+				}
+				break;
+			case COLOR_SPACE_YCBCR:
+				for (int x = 0; x < width; x++) {
+					ycbcr_to_rgb(rows[0][x], rows[1][x], rows[2][x], r, g, b);
+					out[x] = packing.pack(r, g, b, 255);
+				}
+				break;
+			case COLOR_SPACE_RGB:
+				for (int x = 0; x < width; x++) {
+					out[x] = packing.pack(rows[0][x], rows[1][x], rows[2][x],
+										  255);
+				}
+				break;
+			case COLOR_SPACE_CMYK:
+				// Adobe stores inverted CMYK, so the samples already are the
+				// amounts of red, green and blue before applying black.
+				for (int x = 0; x < width; x++) {
+					const std::uint32_t k = rows[3][x];
+					out[x] = packing.pack(multiply_samples(rows[0][x], k),
+										  multiply_samples(rows[1][x], k),
+										  multiply_samples(rows[2][x], k), 255);
+				}
+				break;
+			case COLOR_SPACE_YCCK:
+				for (int x = 0; x < width; x++) {
+					ycbcr_to_rgb(rows[0][x], rows[1][x], rows[2][x], r, g, b);
+					const std::uint32_t k = rows[3][x];
+					out[x] = packing.pack(multiply_samples(255 - r, k),
+										  multiply_samples(255 - g, k),
+										  multiply_samples(255 - b, k), 255);
+				}
+				break;
+		}
+	}
+
+	if (image.context_rows) {
+		for (int i = 0; i < image.component_count; i++) {
+			JpegComponent& component = image.components[i];
+			const int down = component.v * component.block_height;
+			std::memcpy(component.previous.data(),
+						component.samples.data() +
+							static_cast<std::size_t>(down - 1) *
+								component.stride,
+						component.stride);
+		}
+	}
+	return end;
+}
+
+/*
+Handle the restart marker in front of an MCU, if the restart interval says
+there is one.
+
+@param mcu The index of the MCU in the scan.
+*/
+static bool restart(JpegImage& image, BitReader& reader, int mcu) {
+	if (image.restart_interval == 0 || mcu == 0 ||
+		mcu % image.restart_interval != 0) {
+		return true;
+	}
+	if (!reader.restart()) {
+		return SDL_SetError("Missing JPEG restart marker");
+	}
+	for (JpegComponent& component : image.components) {
+		component.dc = 0;
+	}
+	image.eob_run = 0;
+	return true;
+}
+
+// Decode the entropy-coded data of a scan.
+static bool decode_scan(JpegImage& image, const JpegScan& scan,
+						BitReader& reader, const PixelPacking& packing,
+						const DecodeOutput& output) {
+	for (JpegComponent& component : image.components) {
+		component.dc = 0;
+	}
+	image.eob_run = 0;
+
+	// Scans of a single component code its blocks in raster order, covering
+	// the component but not whole MCUs.
+	if (scan.count == 1 && image.component_count > 1) {
+		JpegComponent& component = image.components[scan.components[0]];
+		const int blocks_x = divide_up(
+			divide_up(image.width * component.h, image.h_max), 8);
+		const int blocks_y = divide_up(
+			divide_up(image.height * component.v, image.v_max), 8);
+		int mcu = 0;
+		for (int y = 0; y < blocks_y; y++) {
+			for (int x = 0; x < blocks_x; x++) {
+				if (!restart(image, reader, mcu++)) {
+					return false;
+				}
+				std::int16_t* block =
+					component.coefficients.get() +
+					(static_cast<std::size_t>(y) * component.blocks_x + x) * 64;
+				if (!decode_scan_block(image, scan, component, reader, block)) {
+					return SDL_SetError("Corrupt JPEG data");
+				}
+			}
+		}
+		return true;
+	}
+
+	std::array<std::int16_t, 64> decoded;
+	int mcu = 0;
+	for (int mcu_y = 0; mcu_y < image.mcus_y; mcu_y++) {
+		for (int mcu_x = 0; mcu_x < image.mcus_x; mcu_x++) {
+			if (!restart(image, reader, mcu++)) {
+				return false;
+			}
+			for (int i = 0; i < scan.count; i++) {
+				JpegComponent& component = image.components[scan.components[i]];
+				for (int v = 0; v < component.v; v++) {
+					for (int h = 0; h < component.h; h++) {
+						const int x = mcu_x * component.h + h;
+						const int y = mcu_y * component.v + v;
+						std::int16_t* block = decoded.data();
+						if (image.buffered) {
+							block = component.coefficients.get() +
+									(static_cast<std::size_t>(y) *
+										 component.blocks_x +
+									 x) * 64;
+						} else {
+							decoded.fill(0);
+						}
+						if (!decode_scan_block(image, scan, component, reader,
+											   block)) {
+							return SDL_SetError("Corrupt JPEG data");
+						}
+						if (!image.buffered) {
+							output_block(image, component, block, x, v);
+						}
+					}
+				}
+			}
+		}
+
+		// Baseline images are complete one row of MCUs at a time.
+		if (!image.buffered) {
+			const int rows = convert_rows(image, packing, mcu_y);
+			if (output.progress && !output.progress(rows)) {
+				return SDL_SetError("Decoding was cancelled");
+			}
+		}
+	}
+	return true;
+}
+
+// Transform the coefficients of buffered images once all scans are decoded.
+static bool output_buffered(JpegImage& image, const PixelPacking& packing,
+							const DecodeOutput& output) {
+	for (int mcu_y = 0; mcu_y < image.mcus_y; mcu_y++) {
+		for (int i = 0; i < image.component_count; i++) {
+			JpegComponent& component = image.components[i];
+			for (int v = 0; v < component.v; v++) {
+				const std::size_t y =
+					static_cast<std::size_t>(mcu_y) * component.v + v;
+				for (int x = 0; x < component.blocks_x; x++) {
+					output_block(image, component,
+								 component.coefficients.get() +
+									 (y * component.blocks_x + x) * 64,
+								 x, v);
+				}
+			}
+		}
+		const int rows = convert_rows(image, packing, mcu_y);
+		if (output.progress && !output.progress(rows)) {
+			return SDL_SetError("Decoding was cancelled");
+		}
+	}
+	return true;
+}
+
+/*
+Prepare decoding the first scan. Images consisting of a single scan with all
+components are converted as they are decoded, everything else needs the
+coefficients of the whole image.
+*/
+static bool start_scans(JpegImage& image, const JpegScan& scan) {
+	image.color = color_space(image);
+	image.buffered =
+		image.progressive || scan.count != image.component_count;
+	if (!image.buffered) {
+		return true;
+	}
+	for (int i = 0; i < image.component_count; i++) {
+		JpegComponent& component = image.components[i];
+		const std::size_t count = static_cast<std::size_t>(component.blocks_x) *
+								  component.blocks_y * 64;
+		component.coefficients.reset(static_cast<std::int16_t*>(
+			SDL_calloc(count, sizeof(std::int16_t))));
+		if (component.coefficients == nullptr) {
+			return SDL_OutOfMemory();
+		}
+	}
+	return true;
+}
+
+/*
+Find the next marker segment, skipping fill bytes, entropy-coded data and
+anything else that is not a marker.
+
+@param position The position to search from, moved past the segment.
+@param marker Receives the marker, or `MARKER_EOI` at the end of the image or
+of the data.
+@param segment Receives the segment, without its length.
+@param length Receives the length of the segment.
+
+@return `false` if the segment is truncated, in which case `SDL_GetError()`
+describes the error.
+*/
+static bool next_segment(const Uint8*& position, const Uint8* end, int& marker,
+						 const Uint8*& segment, std::size_t& length) {
+	for (;;) {
+		while (end - position >= 2 &&
+			   (position[0] != 0xFF || position[1] == 0 ||
+				position[1] == 0xFF)) {
+			position++;
+		}
+		if (end - position < 2) {
+			marker = MARKER_EOI;
+			return true;
+		}
+		marker = position[1];
+		position += 2;
+		if (marker == MARKER_EOI) {
+			return true;
+		}
+		if (marker < MARKER_RST0 || marker > MARKER_RST7) {
+			break;	// Restart markers have no segment.
+		}
+	}
+	if (end - position < 2 || read_u16(position) < 2 ||
+		read_u16(position) > end - position) {
+		return SDL_SetError("Truncated JPEG file");
+	}
+	segment = position + 2;
+	length = read_u16(position) - 2;
+	position += read_u16(position);
+	return true;
+}
+
+bool get_jpeg_size(const Uint8* data, std::size_t size, int& width,
+				   int& height) {
+	if (!is_jpeg(data, size)) {
+		return SDL_SetError("Not a JPEG file");
+	}
+	const Uint8* end = data + size;
+	const Uint8* position = data + 2;
+	int marker = 0;
+	const Uint8* segment = nullptr;
+	std::size_t length = 0;
+	for (;;) {
+		if (!next_segment(position, end, marker, segment, length)) {
+			return false;
+		}
+		if (marker == MARKER_EOI) {
+			return SDL_SetError("JPEG file has no frame header");
+		}
+		if (marker >= MARKER_SOF0 && marker <= MARKER_SOF15 &&
+			marker != MARKER_DHT && marker != 0xC8 && marker != 0xCC) {
+			if (length < 5) {
+				return SDL_SetError("Invalid JPEG frame header");
+			}
+			height = read_u16(segment + 1);
+			width = read_u16(segment + 3);
+			return true;
+		}
+	}
+}
+
+bool get_jpeg_decoder_memory(const Uint8* data, std::size_t size,
+							 std::size_t& bytes) {
+	if (!is_jpeg(data, size)) {
+		return SDL_SetError("Not a JPEG file");
+	}
+	JpegImage image;
+	const Uint8* end = data + size;
+	const Uint8* position = data + 2;
+	int marker = 0;
+	const Uint8* segment = nullptr;
+	std::size_t length = 0;
+	bool buffered = true;  // Unless the first scan has every component.
+	for (;;) {
+		if (!next_segment(position, end, marker, segment, length)) {
+			return false;
+		}
+		if (marker == MARKER_EOI) {
+			break;
+		}
+		if (marker == MARKER_SOF0 || marker == MARKER_SOF1 ||
+			marker == MARKER_SOF2) {
+			if (!read_frame(segment, length, marker == MARKER_SOF2, image)) {
+				return false;
+			}
+		} else if (marker == MARKER_SOS && image.component_count > 0) {
+			buffered = image.progressive || length < 1 ||
+					   segment[0] != image.component_count;
+			break;
+		}
+	}
+	if (image.component_count == 0) {
+		return SDL_SetError("JPEG file has no frame header");
+	}
+
+	bytes = 0;
+	for (int i = 0; i < image.component_count; i++) {
+		const JpegComponent& component = image.components[i];
+		bytes += component.samples.size() + component.upsampled.size() +
+				 component.previous.size();
+		if (buffered) {
+			bytes += static_cast<std::size_t>(component.blocks_x) *
+					 component.blocks_y * 64 * sizeof(std::int16_t);
+		}
+	}
+	return true;
+}
+
+bool decode_jpeg(const Uint8* data, std::size_t size, SDL_PixelFormat format,
+				 const DecodeOutput& output, int scale) {
+	if (!is_jpeg(data, size)) {
+		return SDL_SetError("Not a JPEG file");
+	}
+	if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+		return SDL_SetError("Unsupported JPEG scale 1/%d", scale);
+	}
+	PixelPacking packing{};
+	if (!get_packing(format, packing)) {
+		return false;
+	}
+
+	JpegImage image;
+	image.scale = scale;
+	image.block_size = 8 / scale;
+	const Uint8* end = data + size;
+	const Uint8* position = data + 2;
+	int marker = 0;
+	const Uint8* segment = nullptr;
+	std::size_t length = 0;
+	for (;;) {
+		if (!next_segment(position, end, marker, segment, length)) {
+			return false;
+		}
+		if (marker == MARKER_EOI) {
+			break;	// Truncated files are decoded as far as they go.
+		}
+		switch (marker) {
+			case MARKER_DQT:
+				if (!read_quant_tables(segment, length, image)) {
+					return false;
+				}
+				break;
+			case MARKER_DHT:
+				if (!read_huffman_tables(segment, length, image)) {
+					return false;
+				}
+				break;
+			case MARKER_DRI:
+				if (length < 2) {
+					return SDL_SetError("Invalid JPEG restart interval");
+				}
+				image.restart_interval = read_u16(segment);
+				break;
+			case MARKER_APP14:
+				if (length >= 12 && std::memcmp(segment, "Adobe", 5) == 0) {
+					image.adobe_transform = segment[11];
+				}
+				break;
+			case MARKER_SOF0:
+			case MARKER_SOF1:
+			case MARKER_SOF2:
+				if (image.surface != nullptr) {
+					return SDL_SetError("JPEG file has more than one frame");
+				}
+				if (!read_frame(segment, length, marker == MARKER_SOF2,
+								image)) {
+					return false;
+				}
+				image.surface =
+					output.create(image.output_width, image.output_height);
+				if (image.surface == nullptr) {
+					return false;
+				}
+				break;
+			case MARKER_SOS: {
+				JpegScan scan;
+				if (image.surface == nullptr) {
+					return SDL_SetError("JPEG scan before the frame header");
+				}
+				if (!read_scan(segment, length, image, scan)) {
+					return false;
+				}
+				if (image.scans == 0 && !start_scans(image, scan)) {
+					return false;
+				}
+				if (image.scans > 0 && !image.buffered) {
+					return SDL_SetError("Unexpected JPEG scan");
+				}
+				image.scans++;
+				if (scan.start > 0 &&
+					image.components[scan.components[0]].block_width == 1 &&
+					image.components[scan.components[0]].block_height == 1) {
+					// Only the DC coefficients of the component are used at
+					// this scale, so the data of its AC scans is skipped like
+					// anything else that is not a marker. Scans of the other
+					// AC coefficients cannot be skipped, since refining them
+					// needs to know which ones earlier scans made nonzero.
+					break;
+				}
+				BitReader reader(position, end);
+				if (!decode_scan(image, scan, reader, packing, output)) {
+					return false;
+				}
+				position = reader.position();
+				break;
+			}
+			default:
+				// Lossless, hierarchical and arithmetic coded frames, leaving
+				// out the JPG and DAC markers between them.
+				if (marker > MARKER_SOF2 && marker <= MARKER_SOF15 &&
+					marker != 0xC8 && marker != 0xCC) {
+					return SDL_SetError("Unsupported JPEG coding process %d",
+										marker - MARKER_SOF0);
+				}
+				break;	// Application data, comments and such.
+		}
+	}
+
+	if (image.scans == 0) {
+		return SDL_SetError("JPEG file has no image data");
+	}
+	return !image.buffered || output_buffered(image, packing, output);
+}
@@ -0,0 +1,76 @@
+#ifndef SRC_JPEG_DECODER_H_
+#define SRC_JPEG_DECODER_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+
+#include "decode_output.h"
+
+/*
+Check whether a file starts with a JPEG start of image marker.
+
+@param data The first bytes of the file.
+@param size The number of bytes available at `data`.
+*/
+bool is_jpeg(const Uint8* data, std::size_t size);
+
+/*
+Read the size of a JPEG image from its frame header, without decoding it.
+
+@return `false` if the file has no valid frame header, in which case
+`SDL_GetError()` describes the error.
+*/
+bool get_jpeg_size(const Uint8* data, std::size_t size, int& width,
+				   int& height);
+
+/*
+Compute the most memory `decode_jpeg()` allocates for an image besides the
+surface it decodes into, from its frame header and first scan header: a row of
+MCUs of every component, and the coefficients of the whole image unless it is
+a single baseline scan. Decoding at a smaller scale needs less.
+
+@return `false` if the file has no valid frame header, in which case
+`SDL_GetError()` describes the error.
+*/
+bool get_jpeg_decoder_memory(const Uint8* data, std::size_t size,
+							 std::size_t& bytes);
+
+/*
+Decode a JPEG image held in memory.
+
+Baseline and progressive Huffman-coded images with 8-bit samples are supported,
+in grayscale, YCbCr, RGB, CMYK or YCCK with any chroma subsampling. Chroma
+subsampled by half is upsampled with the triangle filter of libjpeg's "fancy"
+upsampling, and by other factors by replicating samples. Arithmetic coding,
+12-bit samples and lossless or hierarchical images are not supported, and
+metadata such as color profiles and the EXIF orientation is ignored.
+
+Baseline images are decoded one row of MCUs (8 or 16 rows of pixels) at a time
+straight into the output surface, and progress is reported after every such
+row. With vertically subsampled chroma, the last row of pixels of each row of
+MCUs is interpolated from the next one, so it is only reported with that.
+Progressive images are decoded into a buffer of DCT coefficients first, since
+every scan refines the whole image, and rows are only reported as final after
+the last scan.
+
+Images can be decoded at 1/2, 1/4 or 1/8 of their size straight from the DCT
+coefficients, by transforming only the lowest frequencies of each block into 4,
+2 or 1 samples on each side. This is much faster than decoding the whole image
+and scaling it down, since the IDCT and the color conversion only handle the
+smaller image, and progressive scans which only refine frequencies that are
+left out are skipped.
+
+@param format The pixel format of the surface returned by `output.create`,
+which must be a packed 32-bit format with 8 bits per color channel.
+@param output Receives the decoded image.
+@param scale 1, 2, 4 or 8 to decode the image at 1 / `scale` of its size,
+rounded up.
+
+@return `true` if the whole image was decoded, or `false` if it could not be,
+in which case `SDL_GetError()` describes the error.
+*/
+bool decode_jpeg(const Uint8* data, std::size_t size, SDL_PixelFormat format,
+				 const DecodeOutput& output, int scale = 1);
+
+#endif	// SRC_JPEG_DECODER_H_
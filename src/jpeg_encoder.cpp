@@ -0,0 +1,445 @@
+#include "jpeg_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+// Position of each coefficient of a block, in the order they are coded.
+static const Uint8 ZIGZAG[64] = {
+	0,	1,	8,	16, 9,	2,	3,	10, 17, 24, 32, 25, 18, 11, 4,	5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,	7,	14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Example quantization tables of the JPEG specification (annex K.1), in
+// natural order.
+static const Uint8 LUMINANCE_QUANT[64] = {
+	16, 11, 10, 16, 24,	 40,  51,  61,	12, 12, 14, 19, 26,	 58,  60,  55,
+	14, 13, 16, 24, 40,	 57,  69,  56,	14, 17, 22, 29, 51,	 87,  80,  62,
+	18, 22, 37, 56, 68,	 109, 103, 77,	24, 35, 55, 64, 81,	 104, 113, 92,
+	49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+static const Uint8 CHROMINANCE_QUANT[64] = {
+	17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+	24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+	99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+namespace {
+
+// Example Huffman tables of the JPEG specification (annex K.3): the number of
+// codes of each length from 1 to 16 bits, and the symbols in order of their
+// codes.
+struct HuffmanSpec {
+	Uint8 class_and_id;	 // As stored in the DHT segment.
+	std::array<Uint8, 16> counts;
+	std::vector<Uint8> symbols;
+};
+
+}  // namespace
+
+static const HuffmanSpec DC_LUMINANCE{
+	0x00,
+	{0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}};
+static const HuffmanSpec DC_CHROMINANCE{
+	0x01,
+	{0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0},
+	{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}};
+static const HuffmanSpec AC_LUMINANCE{
+	0x10,
+	{0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d},
+	{0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+	 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+	 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+	 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+	 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+	 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+	 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+	 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+	 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+	 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+	 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+	 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+	 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+	 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa}};
+static const HuffmanSpec AC_CHROMINANCE{
+	0x11,
+	{0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77},
+	{0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+	 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+	 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+	 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+	 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+	 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+	 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+	 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+	 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+	 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+	 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+	 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+	 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa}};
+
+namespace {
+
+// The code and its length in bits of every symbol of a Huffman table.
+struct HuffmanCodes {
+	std::array<std::uint16_t, 256> codes{};
+	std::array<Uint8, 256> lengths{};
+
+	// Assign codes to the symbols in order, as described in annex C.
+	explicit HuffmanCodes(const HuffmanSpec& spec) {
+		unsigned int code = 0;
+		std::size_t index = 0;
+		for (int length = 1; length <= 16; length++) {
+			for (int i = 0; i < spec.counts[length - 1]; i++) {
+				const Uint8 symbol = spec.symbols[index++];
+				codes[symbol] = static_cast<std::uint16_t>(code++);
+				lengths[symbol] = static_cast<Uint8>(length);
+			}
+			code <<= 1;
+		}
+	}
+};
+
+// Writes entropy-coded data, stuffing a zero byte after every 0xFF byte.
+class EntropyWriter {
+   private:
+	std::vector<Uint8>& out;
+	std::uint32_t buffer;  // The last `count` bits written.
+	int count;			   // Less than 8 between calls.
+
+   public:
+	explicit EntropyWriter(std::vector<Uint8>& out)
+		: out{out}, buffer{0}, count{0} {}
+
+	// Write up to 16 bits.
+	void put(std::uint32_t bits, int length) {
+		buffer = (buffer << length) | bits;
+		count += length;
+		while (count >= 8) {
+			count -= 8;
+			const auto byte = static_cast<Uint8>(buffer >> count);
+			out.push_back(byte);
+			if (byte == 0xFF) {
+				out.push_back(0);
+			}
+		}
+		buffer &= (1u << count) - 1;
+	}
+
+	// Pad the last byte with one bits.
+	void flush() {
+		if (count > 0) {
+			put((1u << (8 - count)) - 1, 8 - count);
+		}
+	}
+};
+
+}  // namespace
+
+static void put_u16(std::vector<Uint8>& out, int value) {
+	out.push_back(static_cast<Uint8>(value >> 8));
+	out.push_back(static_cast<Uint8>(value));
+}
+
+static void put_marker(std::vector<Uint8>& out, Uint8 marker) {
+	out.push_back(0xFF);
+	out.push_back(marker);
+}
+
+/*
+One-dimensional 8 point forward DCT, using the floating point algorithm of
+Arai, Agui and Nakajima. Output `k` is scaled up by `8 * aan_scale(k)`, which
+is folded into the quantization.
+
+@param values The values to transform in place.
+@param step The distance between the values.
+*/
+static void fdct_1d(float* values, int step) {
+	float* d = values;
+	const float tmp0 = d[0] + d[7 * step];
+	const float tmp7 = d[0] - d[7 * step];
+	const float tmp1 = d[step] + d[6 * step];
+	const float tmp6 = d[step] - d[6 * step];
+	const float tmp2 = d[2 * step] + d[5 * step];
+	const float tmp5 = d[2 * step] - d[5 * step];
+	const float tmp3 = d[3 * step] + d[4 * step];
+	const float tmp4 = d[3 * step] - d[4 * step];
+
+	// Even part.
+	float tmp10 = tmp0 + tmp3;
+	const float tmp13 = tmp0 - tmp3;
+	float tmp11 = tmp1 + tmp2;
+	float tmp12 = tmp1 - tmp2;
+	d[0] = tmp10 + tmp11;
+	d[4 * step] = tmp10 - tmp11;
+	const float z1 = (tmp12 + tmp13) * 0.707106781f;
+	d[2 * step] = tmp13 + z1;
+	d[6 * step] = tmp13 - z1;
+
+	// Odd part.
+	tmp10 = tmp4 + tmp5;
+	tmp11 = tmp5 + tmp6;
+	tmp12 = tmp6 + tmp7;
+	const float z5 = (tmp10 - tmp12) * 0.382683433f;
+	const float z2 = 0.541196100f * tmp10 + z5;
+	const float z4 = 1.306562965f * tmp12 + z5;
+	const float z3 = tmp11 * 0.707106781f;
+	const float z11 = tmp7 + z3;
+	const float z13 = tmp7 - z3;
+	d[5 * step] = z13 + z2;
+	d[3 * step] = z13 - z2;
+	d[step] = z11 + z4;
+	d[7 * step] = z11 - z4;
+}
+
+// Number of bits needed for the magnitude of a value.
+static int magnitude_bits(int value) {
+	int bits = 0;
+	for (auto magnitude = static_cast<unsigned int>(std::abs(value));
+		 magnitude != 0; magnitude >>= 1) {
+		bits++;
+	}
+	return bits;
+}
+
+// Write a Huffman coded symbol followed by the bits of a value.
+static void put_coded(EntropyWriter& writer, const HuffmanCodes& table,
+					  int symbol, int value, int size) {
+	writer.put(table.codes[symbol], table.lengths[symbol]);
+	if (size > 0) {
+		// Negative values are stored as their one's complement.
+		const int bits = value < 0 ? value - 1 : value;
+		writer.put(static_cast<std::uint32_t>(bits) & ((1u << size) - 1),
+				   size);
+	}
+}
+
+/*
+Transform, quantize and write a block.
+
+@param samples The top left sample of the block, already shifted to be
+centered around 0.
+@param divisors The reciprocals of the quantization steps, including the
+scaling of `fdct_1d()`.
+@param previous_dc The DC coefficient of the previous block of the component,
+which receives the DC coefficient of this block.
+*/
+static void encode_block(EntropyWriter& writer, const float* samples,
+						 int stride, const float* divisors,
+						 const HuffmanCodes& dc_table,
+						 const HuffmanCodes& ac_table, int& previous_dc) {
+	std::array<float, 64> block;
+	for (int y = 0; y < 8; y++) {
+		std::copy(samples + y * stride, samples + y * stride + 8,
+				  block.data() + y * 8);
+		fdct_1d(block.data() + y * 8, 1);
+	}
+	for (int x = 0; x < 8; x++) {
+		fdct_1d(block.data() + x, 8);
+	}
+
+	const int dc = std::clamp(
+		static_cast<int>(std::lround(block[0] * divisors[0])), -2047, 2047);
+	const int difference = dc - previous_dc;
+	previous_dc = dc;
+	const int dc_size = magnitude_bits(difference);
+	put_coded(writer, dc_table, dc_size, difference, dc_size);
+
+	int run = 0;
+	for (int k = 1; k < 64; k++) {
+		const int n = ZIGZAG[k];
+		const int value = std::clamp(
+			static_cast<int>(std::lround(block[n] * divisors[n])), -1023, 1023);
+		if (value == 0) {
+			run++;
+			continue;
+		}
+		for (; run > 15; run -= 16) {
+			put_coded(writer, ac_table, 0xF0, 0, 0);  // 16 zeros.
+		}
+		const int size = magnitude_bits(value);
+		put_coded(writer, ac_table, (run << 4) | size, value, size);
+		run = 0;
+	}
+	if (run > 0) {
+		put_coded(writer, ac_table, 0x00, 0, 0);  // End of block.
+	}
+}
+
+static void put_huffman_table(std::vector<Uint8>& out,
+							  const HuffmanSpec& spec) {
+	out.push_back(spec.class_and_id);
+	out.insert(out.end(), spec.counts.begin(), spec.counts.end());
+	out.insert(out.end(), spec.symbols.begin(), spec.symbols.end());
+}
+
+// Scale factor of the AAN forward DCT for frequency `k` of a row or column.
+static double aan_scale(int k) {
+	return k == 0 ? 1.0 : SDL_cos(k * SDL_PI_D / 16) * SDL_sqrt(2.0);
+}
+
+bool encode_jpeg(SDL_Surface* surface, int quality, std::vector<Uint8>& out) {
+	if (surface->w > 65535 || surface->h > 65535) {
+		return SDL_SetError("Image size %dx%d is too large for JPEG",
+							surface->w, surface->h);
+	}
+	// Surfaces already in RGBA are read in place.
+	SDL_Surface* rgba = surface;
+	if (surface->format != SDL_PIXELFORMAT_RGBA32 || SDL_MUSTLOCK(surface)) {
+		rgba = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+		if (rgba == nullptr) {
+			return false;
+		}
+	}
+	const int width = rgba->w;
+	const int height = rgba->h;
+
+	// Scale the quantization tables like the IJG library: quality 50 uses the
+	// example tables as they are.
+	quality = std::clamp(quality, 1, 100);
+	const int percent = quality < 50 ? 5000 / quality : 200 - quality * 2;
+	const Uint8* base_tables[2] = {LUMINANCE_QUANT, CHROMINANCE_QUANT};
+	std::array<std::array<Uint8, 64>, 2> quant;
+	std::array<std::array<float, 64>, 2> divisors;
+	for (int t = 0; t < 2; t++) {
+		for (int k = 0; k < 64; k++) {
+			const int step =
+				std::clamp((base_tables[t][k] * percent + 50) / 100, 1, 255);
+			quant[t][k] = static_cast<Uint8>(step);
+			divisors[t][k] = static_cast<float>(
+				1 / (step * aan_scale(k / 8) * aan_scale(k % 8) * 8));
+		}
+	}
+
+	put_marker(out, 0xD8);	// Start of image.
+
+	// JFIF header without a thumbnail.
+	static const Uint8 JFIF[14] = {'J', 'F', 'I', 'F', 0, 1, 1,
+								   0,	0,	 1,	  0,   1, 0, 0};
+	put_marker(out, 0xE0);
+	put_u16(out, 2 + sizeof(JFIF));
+	out.insert(out.end(), JFIF, JFIF + sizeof(JFIF));
+
+	put_marker(out, 0xDB);
+	put_u16(out, 2 + 2 * 65);
+	for (int t = 0; t < 2; t++) {
+		out.push_back(static_cast<Uint8>(t));
+		for (int k = 0; k < 64; k++) {
+			out.push_back(quant[t][ZIGZAG[k]]);
+		}
+	}
+
+	// Frame header: full resolution luma and both chroma components at half
+	// the resolution in each direction.
+	static const Uint8 COMPONENTS[9] = {1, 0x22, 0, 2, 0x11, 1, 3, 0x11, 1};
+	put_marker(out, 0xC0);
+	put_u16(out, 8 + sizeof(COMPONENTS));
+	out.push_back(8);
+	put_u16(out, height);
+	put_u16(out, width);
+	out.push_back(3);
+	out.insert(out.end(), COMPONENTS, COMPONENTS + sizeof(COMPONENTS));
+
+	const HuffmanSpec* specs[4] = {&DC_LUMINANCE, &AC_LUMINANCE,
+								   &DC_CHROMINANCE, &AC_CHROMINANCE};
+	std::vector<Uint8> tables;
+	for (const HuffmanSpec* spec : specs) {
+		put_huffman_table(tables, *spec);
+	}
+	put_marker(out, 0xC4);
+	put_u16(out, 2 + static_cast<int>(tables.size()));
+	out.insert(out.end(), tables.begin(), tables.end());
+
+	static const Uint8 SCAN[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+	put_marker(out, 0xDA);
+	put_u16(out, 2 + sizeof(SCAN));
+	out.insert(out.end(), SCAN, SCAN + sizeof(SCAN));
+
+	static const HuffmanCodes dc_luminance(DC_LUMINANCE);
+	static const HuffmanCodes ac_luminance(AC_LUMINANCE);
+	static const HuffmanCodes dc_chrominance(DC_CHROMINANCE);
+	static const HuffmanCodes ac_chrominance(AC_CHROMINANCE);
+
+	// Samples of the current row of MCUs of 16 x 16 pixels, shifted to be
+	// centered around 0. The image is extended to whole MCUs by repeating its
+	// last column and row.
+	const int mcus_x = (width + 15) / 16;
+	const int luma_stride = mcus_x * 16;
+	const int chroma_stride = mcus_x * 8;
+	std::vector<float> luma(static_cast<std::size_t>(luma_stride) * 16);
+	std::vector<float> cb(luma.size());
+	std::vector<float> cr(luma.size());
+	std::vector<float> cb_half(static_cast<std::size_t>(chroma_stride) * 8);
+	std::vector<float> cr_half(cb_half.size());
+	EntropyWriter writer(out);
+	std::array<int, 3> previous_dc{};
+	for (int mcu_y = 0; mcu_y * 16 < height; mcu_y++) {
+		for (int row = 0; row < 16; row++) {
+			const int y = std::min(mcu_y * 16 + row, height - 1);
+			const Uint8* pixels =
+				static_cast<const Uint8*>(rgba->pixels) +
+				static_cast<std::size_t>(y) * rgba->pitch;
+			for (int x = 0; x < luma_stride; x++) {
+				const Uint8* pixel = pixels + std::min(x, width - 1) * 4;
+				const float r = pixel[0];
+				const float g = pixel[1];
+				const float b = pixel[2];
+				const std::size_t i =
+					static_cast<std::size_t>(row) * luma_stride + x;
+				luma[i] = 0.299f * r + 0.587f * g + 0.114f * b - 128;
+				cb[i] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+				cr[i] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+			}
+		}
+		for (int y = 0; y < 8; y++) {
+			for (int x = 0; x < chroma_stride; x++) {
+				const std::size_t i =
+					static_cast<std::size_t>(y * 2) * luma_stride + x * 2;
+				const std::size_t below = i + luma_stride;
+				const std::size_t half =
+					static_cast<std::size_t>(y) * chroma_stride + x;
+				cb_half[half] =
+					(cb[i] + cb[i + 1] + cb[below] + cb[below + 1]) / 4;
+				cr_half[half] =
+					(cr[i] + cr[i + 1] + cr[below] + cr[below + 1]) / 4;
+			}
+		}
+
+		for (int mcu_x = 0; mcu_x < mcus_x; mcu_x++) {
+			for (int block = 0; block < 4; block++) {
+				const float* samples = luma.data() +
+									   (block / 2) * 8 * luma_stride +
+									   mcu_x * 16 + (block % 2) * 8;
+				encode_block(writer, samples, luma_stride,
+							 divisors[0].data(), dc_luminance, ac_luminance,
+							 previous_dc[0]);
+			}
+			encode_block(writer, cb_half.data() + mcu_x * 8, chroma_stride,
+						 divisors[1].data(), dc_chrominance, ac_chrominance,
+						 previous_dc[1]);
+			encode_block(writer, cr_half.data() + mcu_x * 8, chroma_stride,
+						 divisors[1].data(), dc_chrominance, ac_chrominance,
+						 previous_dc[2]);
+		}
+	}
+	writer.flush();
+	if (rgba != surface) {
+		SDL_DestroySurface(rgba);
+	}
+
+	put_marker(out, 0xD9);	// End of image.
+	return true;
+}
+
+std::size_t jpeg_encoder_memory(int width) {
+	// The rows of samples of `encode_jpeg()`, and the Huffman tables, which
+	// take less than 1 KiB.
+	const std::size_t luma_stride =
+		(static_cast<std::size_t>(width) + 15) / 16 * 16;
+	return (3 * luma_stride * 16 + 2 * (luma_stride / 2) * 8) * sizeof(float) +
+		   1024;
+}
@@ -0,0 +1,34 @@
+#ifndef SRC_JPEG_ENCODER_H_
+#define SRC_JPEG_ENCODER_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <vector>
+
+/*
+Encode a surface as a baseline JPEG image.
+
+Images are stored as JFIF YCbCr with 4:2:0 chroma subsampling, using the
+example quantization tables of the JPEG specification scaled by the quality
+setting the way the Independent JPEG Group's library does, and the example
+Huffman tables. The alpha channel is dropped.
+
+@param surface The image to encode, in any pixel format. Surfaces in
+`SDL_PIXELFORMAT_RGBA32` are read as they are, others are converted first.
+@param quality The quality setting, from 1 (smallest) to 100 (best).
+@param out The JPEG file is appended to this vector.
+
+@return `false` if the surface could not be read, in which case
+`SDL_GetError()` describes the error.
+*/
+bool encode_jpeg(SDL_Surface* surface, int quality, std::vector<Uint8>& out);
+
+/*
+The most memory `encode_jpeg()` allocates for a surface in
+`SDL_PIXELFORMAT_RGBA32` of a given width besides the file it appends to
+`out`: a row of MCUs of every component and the Huffman tables.
+*/
+std::size_t jpeg_encoder_memory(int width);
+
+#endif	// SRC_JPEG_ENCODER_H_
@@ -7,9 +7,20 @@
 #include <imgui.h>
 #include <imgui_impl_sdl3.h>
 #include <imgui_impl_sdlrenderer3.h>
+#include <imgui_internal.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include "batch.h"
+#include "gallery.h"
+#include "image_viewer.h"
+#include "profiler.h"
 
 // Enumeration of possible status values for the application.
 enum ApplicationStatus {
@@ -20,6 +31,42 @@ enum ApplicationStatus {
 				   // file.
 };
 
+// Number of frames drawn after an event before the main loop goes back to
+// sleep, since ImGui may take a few frames to settle, e.g. for windows which
+// size themselves to fit their content.
+static const int SETTLE_FRAMES = 3;
+
+// Longest time the main loop sleeps, in milliseconds, while a text field has
+// the keyboard focus, so that its cursor blinks.
+static const Sint32 ANIMATION_TIMEOUT = 100;
+
+// Threads of the pools working in the background, see `thread_budget()`.
+struct ThreadBudget {
+	unsigned int decode;	  // Decoding the viewed images.
+	unsigned int tasks;		  // Applying adjustments and resampling fitted
+							  // images, joined by the main thread.
+	unsigned int thumbnails;  // Making the thumbnails of the gallery.
+};
+
+/*
+Split the logical cores between the pools working in the background, leaving
+one core for the main thread. Half of them go to the tasks the user waits on
+while interacting, and the rest is shared by decoding and thumbnails, which
+run at the same time after a folder is opened. Decoding and thumbnails keep
+at least one thread each.
+*/
+static ThreadBudget thread_budget() {
+	const int cores = SDL_GetNumLogicalCPUCores();
+	const unsigned int background =
+		cores > 1 ? static_cast<unsigned int>(cores - 1) : 1;
+	ThreadBudget budget;
+	budget.tasks = background / 2;
+	const unsigned int rest = background - budget.tasks;
+	budget.thumbnails = std::max(rest / 2, 1u);
+	budget.decode = std::max(rest - rest / 2, 1u);
+	return budget;
+}
+
 // File dialog filters.
 const std::array<SDL_DialogFileFilter, 3> dialog_filters = {
 	SDL_DialogFileFilter{"PNG images", "png"},
@@ -27,7 +74,13 @@ const std::array<SDL_DialogFileFilter, 3> dialog_filters = {
 	SDL_DialogFileFilter{"All images", "png;jpg;jpeg"},
 };
 
-// Callback function used to bring up file explorer dialog
+/*
+Callback function used to bring up file explorer dialog.
+
+The callback may be called from another thread, so the selected paths are
+copied and forwarded to the main loop as an event. `userdata` must point to the
+event type registered for this purpose.
+*/
 static void SDLCALL callback(void* userdata, const char* const* filelist,
 							 const int filter) {
 	if (!filelist) {
@@ -39,11 +92,23 @@ static void SDLCALL callback(void* userdata, const char* const* filelist,
 		return;
 	}
 
+	auto paths = std::make_unique<std::vector<std::string>>();
 	while (*filelist) {
 		SDL_Log("Full path to selected file: '%s'", *filelist);
+		paths->emplace_back(*filelist);
 		filelist++;
 	}
 
+	SDL_Event event;
+	SDL_zero(event);
+	event.type = *static_cast<const Uint32*>(userdata);
+	event.user.data1 = paths.get();
+	if (SDL_PushEvent(&event)) {
+		paths.release();  // Now owned by the event.
+	} else {
+		SDL_Log("SDL_PushEvent: %s", SDL_GetError());
+	}
+
 	if (filter < 0) {
 		SDL_Log(
 			"The current platform does not support fetching "
@@ -66,6 +131,55 @@ class Application {
 	std::string window_title;
 	SDL_Window* window;
 	SDL_Renderer* renderer;
+	Uint32 open_files_event;  // Pushed by `callback` when files are selected.
+	Uint32 export_event;  // Pushed by `callback` when an export path is chosen.
+	Uint32 exported_event;	// Pushed by `exported()` when an export has ended.
+	Uint32 wake_event;	// Pushed by `wake()` when background work has made
+						// progress.
+	std::atomic<bool> wake_pending;	 // Whether a wake event is in the queue.
+	std::unique_ptr<ImageViewer> viewer;
+	std::unique_ptr<Gallery> gallery;
+	bool show_profiler;	 // Whether the profiler overlay is shown.
+
+	/*
+	Wake up the main loop if it is waiting for events, so that it collects the
+	results of background work. May be called from any thread. Only one wake
+	event is queued at a time, however many results arrive.
+	*/
+	void wake() {
+		if (!wake_pending.exchange(true)) {
+			SDL_Event event;
+			SDL_zero(event);
+			event.type = wake_event;
+			if (!SDL_PushEvent(&event)) {
+				wake_pending.store(false);
+			}
+		}
+	}
+
+	/*
+	Report the end of an export to the main loop. May be called from any
+	thread.
+
+	@param path The exported file.
+	@param success Whether the image was saved.
+	@param error The description of the error if it was not.
+	*/
+	void exported(const std::string& path, bool success,
+				  const std::string& error) {
+		auto result = std::make_unique<std::vector<std::string>>(
+			std::vector<std::string>{path, error});
+		SDL_Event event;
+		SDL_zero(event);
+		event.type = exported_event;
+		event.user.code = success ? 1 : 0;
+		event.user.data1 = result.get();
+		if (SDL_PushEvent(&event)) {
+			result.release();  // Now owned by the event.
+		} else {
+			SDL_Log("SDL_PushEvent: %s", SDL_GetError());
+		}
+	}
 
    public:
 	/*
@@ -75,7 +189,11 @@ class Application {
 	returned object before using it to find out if initialization has failed!
 	*/
 	Application(int window_width, int window_height, std::string window_title)
-		: status{SUCCESS}, scale{}, window_title(window_title) {
+		: status{SUCCESS},
+		  scale{},
+		  window_title(window_title),
+		  wake_pending{false},
+		  show_profiler{false} {
 		// Initialize SDL.
 		if (SDL_Init(SDL_INIT_VIDEO) == false) {
 			SDL_Log("SDL_Init: %s", SDL_GetError());
@@ -113,6 +231,26 @@ class Application {
 		if (SDL_SetRenderVSync(renderer, 1) == false) {
 			SDL_Log("SDL_SetRenderVSync: %s", SDL_GetError());
 		}
+
+		// Register the events used to forward files selected in the dialogs,
+		// to report finished exports and to wake up the main loop.
+		open_files_event = SDL_RegisterEvents(4);
+		if (open_files_event == 0) {
+			SDL_Log("SDL_RegisterEvents: %s", SDL_GetError());
+			status = INITIALIZATION_ERROR;
+			return;
+		}
+		export_event = open_files_event + 1;
+		exported_event = open_files_event + 2;
+		wake_event = open_files_event + 3;
+
+		const ThreadBudget threads = thread_budget();
+		viewer = std::make_unique<ImageViewer>(
+			renderer, threads.decode, threads.tasks,
+			ImageViewer::TILE_MEMORY_BUDGET, [this] { wake(); });
+		gallery = std::make_unique<Gallery>(
+			renderer, threads.thumbnails, ThumbnailStore::default_directory(),
+			[this] { wake(); });
 	}
 
 	/*
@@ -154,14 +292,48 @@ class Application {
 		ImGui_ImplSDL3_InitForSDLRenderer(window, renderer);
 		ImGui_ImplSDLRenderer3_Init(renderer);
 
-		// Enter the main loop.
+		// Enter the main loop. Frames are only drawn while something changes,
+		// otherwise the loop sleeps until the next event.
 		SDL_Event event;
 		SDL_zero(event);
 		bool quit = false;
+		int frames_left = SETTLE_FRAMES;  // Frames to draw before sleeping.
+		bool animating = false;	 // Whether ImGui changes over time.
+		ImGuiID hovered = 0;	 // The item under the mouse in the last frame.
+		Uint64 tooltip_time = 0;  // When a tooltip may appear over the hovered
+								  // item, in milliseconds, or 0 if none may.
 
 		while (quit == false) {
-			// Event handling.
-			while (SDL_PollEvent(&event)) {
+			// Do no rendering if the window is minimized or hidden behind
+			// other windows, only collect background work when woken up.
+			const SDL_WindowFlags hidden =
+				SDL_WINDOW_MINIMIZED | SDL_WINDOW_OCCLUDED;
+			bool visible = (SDL_GetWindowFlags(window) & hidden) == 0;
+
+			// Event handling, waiting for the next event if there is nothing
+			// to draw, or at most until the next animation frame.
+			Sint32 timeout = -1;
+			if (visible && frames_left > 0) {
+				timeout = 0;
+			} else if (visible && animating) {
+				timeout = ANIMATION_TIMEOUT;
+				frames_left = 1;
+			} else if (visible && tooltip_time != 0) {
+				const Uint64 now = SDL_GetTicks();
+				timeout = now < tooltip_time
+							  ? static_cast<Sint32>(tooltip_time - now)
+							  : 0;
+				frames_left = SETTLE_FRAMES;
+			}
+			bool have_event = SDL_WaitEventTimeout(&event, timeout);
+			const Uint64 frame_start = SDL_GetPerformanceCounter();
+			for (; have_event; have_event = SDL_PollEvent(&event)) {
+				if (event.type == wake_event) {
+					wake_pending.store(false);
+					continue;
+				}
+				frames_left = SETTLE_FRAMES;
+
 				// Forward events to the ImGui backend.
 				ImGui_ImplSDL3_ProcessEvent(&event);
 
@@ -173,14 +345,66 @@ class Application {
 					event.window.windowID == SDL_GetWindowID(window)) {
 					quit = true;
 				}
+
+				// Open files selected in the file dialog.
+				if (event.type == open_files_event) {
+					std::unique_ptr<std::vector<std::string>> paths(
+						static_cast<std::vector<std::string>*>(
+							event.user.data1));
+					gallery->open(*paths);
+					viewer->open(std::move(*paths));
+				}
+
+				// Export the current image to the file selected in the save
+				// dialog, in the background.
+				if (event.type == export_event) {
+					std::unique_ptr<std::vector<std::string>> paths(
+						static_cast<std::vector<std::string>*>(
+							event.user.data1));
+					const std::string path = paths->front();
+					if (!viewer->export_image(
+							path, [this, path](bool success,
+											   const std::string& error) {
+								exported(path, success, error);
+							})) {
+						SDL_Log("Failed to export '%s': %s", path.c_str(),
+								SDL_GetError());
+					}
+				}
+
+				// Report exports which have ended.
+				if (event.type == exported_event) {
+					std::unique_ptr<std::vector<std::string>> result(
+						static_cast<std::vector<std::string>*>(
+							event.user.data1));
+					if (event.user.code != 0) {
+						SDL_Log("Exported '%s'", result->front().c_str());
+					} else {
+						SDL_Log("Failed to export '%s': %s",
+								result->front().c_str(),
+								result->back().c_str());
+					}
+				}
 			}
 
-			// Rendering logic.
+			if (profiling()) {
+				profile_add(PROFILE_STAGE_EVENTS,
+							SDL_GetPerformanceCounter() - frame_start);
+			}
+
+			// Upload images and thumbnails decoded since the last frame.
+			const bool viewer_changed = viewer->update();
+			const bool gallery_changed = gallery->update();
+			if (viewer_changed || gallery_changed) {
+				frames_left = std::max(frames_left, 1);
+			}
 
-			// Do no rendering if the window is minimized.
-			if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) {
+			// Rendering logic.
+			visible = (SDL_GetWindowFlags(window) & hidden) == 0;
+			if (!visible || frames_left == 0) {
 				continue;
 			}
+			frames_left--;
 
 			// Start of the ImGui frame.
 			ImGui_ImplSDLRenderer3_NewFrame();
@@ -194,23 +418,79 @@ class Application {
 			if (ImGui::Button("Button A")) {
 				printf("Button A clicked!\n");
 				SDL_ShowOpenFileDialog(
-					callback, nullptr, window, dialog_filters.data(),
+					callback, &open_files_event, window, dialog_filters.data(),
 					SDL_arraysize(dialog_filters), nullptr, true);
 			}
+			ImGui::Checkbox("Show profiler (F3)", &show_profiler);
 			ImGui::End();
 
+			// Adjustments of the viewed image, which can be exported.
+			if (viewer->draw_adjustments()) {
+				SDL_ShowSaveFileDialog(callback, &export_event, window,
+									   dialog_filters.data(),
+									   SDL_arraysize(dialog_filters), nullptr);
+			}
+
+			// Clicking a thumbnail shows its image in the viewer.
+			std::size_t selected = 0;
+			if (gallery->draw(selected)) {
+				viewer->show(selected);
+			}
+			viewer->draw();
+
 			// Show demo window.
 			ImGui::ShowDemoWindow();
 
+			// Measure the pipeline only while its results are shown.
+			if (ImGui::IsKeyPressed(ImGuiKey_F3, false)) {
+				show_profiler = !show_profiler;
+			}
+			if (show_profiler) {
+				draw_profile_overlay(&show_profiler);
+			}
+			set_profiling(show_profiler);
+
 			// Render the ImGui frame.
 			ImGui::Render();
 			SDL_SetRenderScale(renderer, io.DisplayFramebufferScale.x,
 							   io.DisplayFramebufferScale.y);
 			SDL_SetRenderDrawColorFloat(renderer, 0, 0, 0, 0);
 			SDL_RenderClear(renderer);
-			ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(),
-												  renderer);
+			{
+				ProfileScope profile(PROFILE_STAGE_RENDER);
+				ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(),
+													  renderer);
+			}
 			SDL_RenderPresent(renderer);
+			profile_end_frame(SDL_GetPerformanceCounter() - frame_start);
+
+			// Keep drawing while an image is being decoded or uploaded, or
+			// while thumbnails are waiting to be uploaded.
+			if (viewer->needs_redraw() || gallery->needs_redraw()) {
+				frames_left = std::max(frames_left, 1);
+			}
+
+			// Keep drawing now and then while a text cursor blinks.
+			animating = ImGui::GetIO().WantTextInput;
+
+			// Wake up once when a tooltip may appear, which happens after the
+			// mouse rests on an item for a delay, without further input. ImGui
+			// counts the delay from the frame after the mouse stopped, which
+			// the frames drawn to settle cover.
+			const ImGuiID hovered_now = ImGui::GetHoveredID();
+			const Uint64 now = SDL_GetTicks();
+			if (hovered_now != 0 &&
+				(hovered_now != hovered || io.MouseDelta.x != 0 ||
+				 io.MouseDelta.y != 0)) {
+				const ImGuiStyle& style = ImGui::GetStyle();
+				const float delay = std::max(style.HoverDelayShort,
+											 style.HoverDelayNormal) +
+									style.HoverStationaryDelay;
+				tooltip_time = now + static_cast<Uint64>(delay * 1000) + 1;
+			} else if (hovered_now == 0 || now >= tooltip_time) {
+				tooltip_time = 0;
+			}
+			hovered = hovered_now;
 		}
 	}
 
@@ -228,7 +508,12 @@ class Application {
 
 		There might be a cleaner way to do this, but we are not really
 		initializing that much stuff so it probably does not matter.
+
+		The viewer and the gallery own textures and must be destroyed before the
+		renderer.
 		*/
+		gallery.reset();
+		viewer.reset();
 		if (renderer != nullptr) {
 			SDL_DestroyRenderer(renderer);
 		}
@@ -241,7 +526,18 @@ class Application {
 	}
 };
 
-int main() {
+int main(int argc, char** argv) {
+	// Convert images without opening a window, see `run_batch()`.
+	if (argc > 1 && SDL_strcmp(argv[1], "--batch") == 0) {
+		BatchOptions options;
+		if (!parse_batch_arguments(argc - 2, argv + 2, options)) {
+			SDL_Log("%s", SDL_GetError());
+			SDL_Log("%s", BATCH_USAGE);
+			return INITIALIZATION_ERROR;
+		}
+		return run_batch(options) ? SUCCESS : RUNTIME_ERROR;
+	}
+
 	const int INITIAL_WINDOW_WIDTH = 960;
 	const int INITIAL_WINDOW_HEIGHT = 540;
 
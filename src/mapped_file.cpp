@@ -0,0 +1,125 @@
+#include "mapped_file.h"
+
+#include <cstdint>
+
+#if defined(SDL_PLATFORM_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <string>
+#elif defined(SDL_PLATFORM_UNIX) || defined(SDL_PLATFORM_APPLE)
+#define MAPPED_FILE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(SDL_PLATFORM_WINDOWS)
+// Map a file, returning `nullptr` on failure.
+static const Uint8* map(const char* path, std::size_t& size) {
+	int wide_size = MultiByteToWideChar(CP_UTF8, 0, path, -1, nullptr, 0);
+	if (wide_size <= 0) {
+		return nullptr;
+	}
+	std::wstring wide_path(static_cast<std::size_t>(wide_size), L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, wide_path.data(), wide_size);
+
+	HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+							  nullptr, OPEN_EXISTING,
+							  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	LARGE_INTEGER file_size;
+	void* view = nullptr;
+	if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 &&
+		static_cast<std::uint64_t>(file_size.QuadPart) <= SIZE_MAX) {
+		HANDLE mapping =
+			CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr) {
+			view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);  // The view keeps the mapping alive.
+		}
+	}
+	CloseHandle(file);
+	size = static_cast<std::size_t>(file_size.QuadPart);
+	return static_cast<const Uint8*>(view);
+}
+
+static void unmap(const Uint8* data, std::size_t /*size*/) {
+	UnmapViewOfFile(data);
+}
+#elif defined(MAPPED_FILE_POSIX)
+static const Uint8* map(const char* path, std::size_t& size) {
+	int file = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (file < 0) {
+		return nullptr;
+	}
+	struct stat status;
+	void* view = MAP_FAILED;
+	if (fstat(file, &status) == 0 && S_ISREG(status.st_mode) &&
+		status.st_size > 0 &&
+		static_cast<std::uint64_t>(status.st_size) <= SIZE_MAX) {
+		size = static_cast<std::size_t>(status.st_size);
+		view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	}
+	::close(file);	// The mapping keeps the file open.
+	if (view == MAP_FAILED) {
+		return nullptr;
+	}
+	// Images are decoded from front to back.
+	madvise(view, size, MADV_SEQUENTIAL);
+	return static_cast<const Uint8*>(view);
+}
+
+static void unmap(const Uint8* data, std::size_t size) {
+	munmap(const_cast<Uint8*>(data), size);
+}
+#endif
+
+bool MappedFile::open(const char* path) {
+	close();
+#if defined(SDL_PLATFORM_WINDOWS) || defined(MAPPED_FILE_POSIX)
+	std::size_t size = 0;
+	bytes = map(path, size);
+	if (bytes != nullptr) {
+		length = size;
+		mapped = true;
+		return true;
+	}
+#endif
+	// Empty files and files which are not regular files cannot be mapped, and
+	// reading them also produces the right error messages.
+	void* data = SDL_LoadFile(path, &length);
+	if (data == nullptr) {
+		length = 0;
+		return false;
+	}
+	bytes = static_cast<const Uint8*>(data);
+	return true;
+}
+
+void MappedFile::prefetch() const {
+#if defined(MAPPED_FILE_POSIX)
+	if (mapped) {
+		madvise(const_cast<Uint8*>(bytes), length, MADV_WILLNEED);
+	}
+#endif
+}
+
+void MappedFile::close() {
+	if (bytes != nullptr) {
+#if defined(SDL_PLATFORM_WINDOWS) || defined(MAPPED_FILE_POSIX)
+		if (mapped) {
+			unmap(bytes, length);
+		}
+#endif
+		if (!mapped) {
+			SDL_free(const_cast<Uint8*>(bytes));
+		}
+	}
+	bytes = nullptr;
+	length = 0;
+	mapped = false;
+}
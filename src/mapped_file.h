@@ -0,0 +1,53 @@
+#ifndef SRC_MAPPED_FILE_H_
+#define SRC_MAPPED_FILE_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+
+/*
+Read-only view of a whole file.
+
+The file is memory-mapped where the platform supports it, so that its pages are
+read on demand and can be dropped again by the kernel instead of occupying a
+heap buffer for as long as the file is in use. Elsewhere, or if mapping fails,
+the file is read with `SDL_LoadFile()`.
+*/
+class MappedFile {
+   private:
+	const Uint8* bytes;
+	std::size_t length;
+	bool mapped;  // Whether `bytes` must be unmapped rather than freed.
+
+	void close();
+
+   public:
+	MappedFile() : bytes{nullptr}, length{0}, mapped{false} {}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	/*
+	Open a file, closing the previously opened one.
+
+	@param path Path to the file (UTF-8).
+	@return `true` on success, or `false` if the file could not be read, in
+	which case `SDL_GetError()` describes the error.
+	*/
+	bool open(const char* path);
+
+	// The contents of the file, which may be `nullptr` for an empty file.
+	const Uint8* data() const { return bytes; }
+	std::size_t size() const { return length; }
+
+	/*
+	Ask the system to start reading the whole file in the background, so that
+	reading it later does not wait for the disk. Does nothing where files are
+	not mapped.
+	*/
+	void prefetch() const;
+
+	~MappedFile() { close(); }
+};
+
+#endif	// SRC_MAPPED_FILE_H_
@@ -0,0 +1,38 @@
+#include "pixel_packing.h"
+
+bool get_packing(SDL_PixelFormat format, PixelPacking& packing) {
+	const SDL_PixelFormatDetails* details = SDL_GetPixelFormatDetails(format);
+	if (details == nullptr) {
+		return false;
+	}
+	if (!SDL_ISPIXELFORMAT_PACKED(format) || details->bits_per_pixel != 32 ||
+		details->Rbits != 8 || details->Gbits != 8 || details->Bbits != 8) {
+		return SDL_SetError("Unsupported pixel format %s for decoding",
+							SDL_GetPixelFormatName(format));
+	}
+	packing.red = details->Rshift;
+	packing.green = details->Gshift;
+	packing.blue = details->Bshift;
+	packing.alpha = details->Amask;
+	return true;
+}
+
+SDL_PixelFormat texture_format(SDL_Renderer* renderer) {
+	const auto* formats = static_cast<const SDL_PixelFormat*>(
+		SDL_GetPointerProperty(SDL_GetRendererProperties(renderer),
+							   SDL_PROP_RENDERER_TEXTURE_FORMATS_POINTER,
+							   nullptr));
+	for (int i = 0; formats != nullptr && formats[i] != SDL_PIXELFORMAT_UNKNOWN;
+		 i++) {
+		switch (formats[i]) {
+			case SDL_PIXELFORMAT_ARGB8888:
+			case SDL_PIXELFORMAT_ABGR8888:
+			case SDL_PIXELFORMAT_RGBA8888:
+			case SDL_PIXELFORMAT_BGRA8888:
+				return formats[i];
+			default:
+				break;
+		}
+	}
+	return SDL_PIXELFORMAT_RGBA32;
+}
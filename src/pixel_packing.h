@@ -0,0 +1,39 @@
+#ifndef SRC_PIXEL_PACKING_H_
+#define SRC_PIXEL_PACKING_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstdint>
+
+// How decoded pixels are packed into 32-bit values of a surface format.
+struct PixelPacking {
+	unsigned int red;	 // Shifts of each channel.
+	unsigned int green;
+	unsigned int blue;
+	std::uint32_t alpha;  // Mask of the alpha channel, 0 if there is none.
+
+	// Replicating the alpha value in every byte and masking it puts it in
+	// the right place without needing a separate shift.
+	std::uint32_t pack(std::uint32_t r, std::uint32_t g, std::uint32_t b,
+					   std::uint32_t a) const {
+		return (r << red) | (g << green) | (b << blue) |
+			   ((a * 0x01010101u) & alpha);
+	}
+};
+
+/*
+Get the packing of a pixel format decoders can write to.
+
+@return `false` if the format is not a packed 32-bit format with 8 bits per
+color channel, in which case `SDL_GetError()` describes the error.
+*/
+bool get_packing(SDL_PixelFormat format, PixelPacking& packing);
+
+/*
+Pick the pixel format images are decoded to for display with a renderer.
+Decoding straight to a format the renderer supports lets textures be created
+without converting the pixels.
+*/
+SDL_PixelFormat texture_format(SDL_Renderer* renderer);
+
+#endif	// SRC_PIXEL_PACKING_H_
@@ -0,0 +1,448 @@
+#include "png_decoder.h"
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "inflate.h"
+#include "pixel_packing.h"
+#include "png_filters.h"
+
+static const Uint8 SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+namespace {
+
+// PNG color types.
+enum ColorType {
+	COLOR_GRAY = 0,
+	COLOR_RGB = 2,
+	COLOR_PALETTE = 3,
+	COLOR_GRAY_ALPHA = 4,
+	COLOR_RGBA = 6
+};
+
+// Everything needed to decode the pixel data of an image.
+struct PngImage {
+	std::uint32_t width = 0;
+	std::uint32_t height = 0;
+	unsigned int depth = 0;
+	ColorType color = COLOR_GRAY;
+	bool interlaced = false;
+	unsigned int channels = 0;
+
+	std::array<Uint8, 256 * 4> palette{};  // RGBA, missing entries are
+										   // transparent black.
+	unsigned int palette_size = 0;
+	bool has_key = false;  // Gray or RGB color key from the tRNS chunk.
+	std::array<std::uint16_t, 3> key{};
+
+	std::vector<std::pair<const Uint8*, std::size_t>> data;	 // IDAT chunks.
+};
+
+}  // namespace
+
+static std::uint32_t read_u32(const Uint8* p) {
+	return (static_cast<std::uint32_t>(p[0]) << 24) |
+		   (static_cast<std::uint32_t>(p[1]) << 16) |
+		   (static_cast<std::uint32_t>(p[2]) << 8) | p[3];
+}
+
+bool is_png(const Uint8* data, std::size_t size) {
+	return size >= sizeof(SIGNATURE) &&
+		   std::memcmp(data, SIGNATURE, sizeof(SIGNATURE)) == 0;
+}
+
+static bool read_header(const Uint8* chunk, std::uint32_t length,
+						PngImage& image) {
+	if (length != 13) {
+		return SDL_SetError("Invalid PNG header");
+	}
+	image.width = read_u32(chunk);
+	image.height = read_u32(chunk + 4);
+	image.depth = chunk[8];
+	if (image.width == 0 || image.height == 0) {
+		return SDL_SetError("PNG image has no pixels");
+	}
+	// Surfaces use an int for the pitch, which is four bytes per pixel.
+	if (image.width > INT_MAX / 4 || image.height > INT_MAX) {
+		return SDL_SetError("PNG image is too large (%ux%u)", image.width,
+							image.height);
+	}
+	if (chunk[10] != 0 || chunk[11] != 0 || chunk[12] > 1) {
+		return SDL_SetError("Unknown PNG compression, filter or interlace "
+							"method");
+	}
+	image.interlaced = chunk[12] == 1;
+
+	bool valid_depth = false;
+	switch (chunk[9]) {
+		case COLOR_GRAY:
+			image.channels = 1;
+			valid_depth = image.depth == 1 || image.depth == 2 ||
+						  image.depth == 4 || image.depth == 8 ||
+						  image.depth == 16;
+			break;
+		case COLOR_PALETTE:
+			image.channels = 1;
+			valid_depth = image.depth == 1 || image.depth == 2 ||
+						  image.depth == 4 || image.depth == 8;
+			break;
+		case COLOR_RGB:
+			image.channels = 3;
+			valid_depth = image.depth == 8 || image.depth == 16;
+			break;
+		case COLOR_GRAY_ALPHA:
+			image.channels = 2;
+			valid_depth = image.depth == 8 || image.depth == 16;
+			break;
+		case COLOR_RGBA:
+			image.channels = 4;
+			valid_depth = image.depth == 8 || image.depth == 16;
+			break;
+		default:
+			return SDL_SetError("Invalid PNG color type %d", chunk[9]);
+	}
+	image.color = static_cast<ColorType>(chunk[9]);
+	if (!valid_depth) {
+		return SDL_SetError("Invalid PNG bit depth %u for color type %d",
+							image.depth, chunk[9]);
+	}
+	return true;
+}
+
+static bool read_transparency(const Uint8* chunk, std::uint32_t length,
+							  PngImage& image) {
+	switch (image.color) {
+		case COLOR_PALETTE:
+			if (length > image.palette_size) {
+				return SDL_SetError("Invalid PNG transparency chunk");
+			}
+			for (std::uint32_t i = 0; i < length; i++) {
+				image.palette[i * 4 + 3] = chunk[i];
+			}
+			return true;
+		case COLOR_GRAY:
+		case COLOR_RGB: {
+			const std::uint32_t samples = image.color == COLOR_GRAY ? 1 : 3;
+			if (length != samples * 2) {
+				return SDL_SetError("Invalid PNG transparency chunk");
+			}
+			for (std::uint32_t i = 0; i < samples; i++) {
+				image.key[i] = static_cast<std::uint16_t>(
+					(chunk[i * 2] << 8) | chunk[i * 2 + 1]);
+			}
+			image.has_key = true;
+			return true;
+		}
+		default:
+			// Images with an alpha channel may not have a tRNS chunk, but
+			// there is no harm in ignoring it.
+			return true;
+	}
+}
+
+// Parse the chunks of the file, collecting the IDAT chunks without copying.
+static bool read_chunks(const Uint8* data, std::size_t size, PngImage& image) {
+	if (!is_png(data, size)) {
+		return SDL_SetError("Not a PNG file");
+	}
+	std::size_t position = sizeof(SIGNATURE);
+	bool seen_header = false;
+	for (;;) {
+		if (size - position < 12) {
+			return SDL_SetError("Truncated PNG file");
+		}
+		std::uint32_t length = read_u32(data + position);
+		const Uint8* type = data + position + 4;
+		const Uint8* chunk = data + position + 8;
+		if (length > size - position - 12) {
+			return SDL_SetError("Truncated PNG file");
+		}
+		position += 12 + static_cast<std::size_t>(length);
+
+		if (!seen_header) {
+			if (std::memcmp(type, "IHDR", 4) != 0) {
+				return SDL_SetError("PNG file does not start with a header");
+			}
+			if (!read_header(chunk, length, image)) {
+				return false;
+			}
+			seen_header = true;
+		} else if (std::memcmp(type, "PLTE", 4) == 0) {
+			if (length % 3 != 0 || length / 3 > 256 || length == 0) {
+				return SDL_SetError("Invalid PNG palette");
+			}
+			image.palette_size = length / 3;
+			for (std::uint32_t i = 0; i < image.palette_size; i++) {
+				image.palette[i * 4] = chunk[i * 3];
+				image.palette[i * 4 + 1] = chunk[i * 3 + 1];
+				image.palette[i * 4 + 2] = chunk[i * 3 + 2];
+				image.palette[i * 4 + 3] = 255;
+			}
+		} else if (std::memcmp(type, "tRNS", 4) == 0) {
+			if (!read_transparency(chunk, length, image)) {
+				return false;
+			}
+		} else if (std::memcmp(type, "IDAT", 4) == 0) {
+			image.data.emplace_back(chunk, length);
+		} else if (std::memcmp(type, "IEND", 4) == 0) {
+			break;
+		} else if (!(type[0] & 0x20)) {
+			// The ancillary bit is not set, so the chunk can not be ignored.
+			return SDL_SetError("Unsupported critical PNG chunk '%c%c%c%c'",
+								type[0], type[1], type[2], type[3]);
+		}
+	}
+
+	if (image.data.empty()) {
+		return SDL_SetError("PNG file has no image data");
+	}
+	if (image.color == COLOR_PALETTE && image.palette_size == 0) {
+		return SDL_SetError("PNG file has no palette");
+	}
+	return true;
+}
+
+/*
+Convert a reconstructed scanline to packed pixels.
+
+@param out The first pixel of the scanline in the surface.
+@param step The distance between pixels of the scanline in the surface, which
+is larger than 1 for interlaced images.
+*/
+static void convert_row(const PngImage& image, const PixelPacking& packing,
+						const std::uint32_t* lookup, const Uint8* row,
+						std::size_t width, std::uint32_t* out,
+						std::size_t step) {
+	// Gray and palette images with at most 8 bits per pixel use a lookup
+	// table with the packed pixel of every possible value.
+	if (lookup != nullptr) {
+		if (image.depth == 8) {
+			for (std::size_t x = 0; x < width; x++) {
+				out[x * step] = lookup[row[x]];
+			}
+			return;
+		}
+		const unsigned int depth = image.depth;
+		const unsigned int per_byte = 8 / depth;
+		const unsigned int mask = (1u << depth) - 1;
+		for (std::size_t x = 0; x < width; x++) {
+			unsigned int shift = 8 - depth * (1 + x % per_byte);
+			out[x * step] = lookup[(row[x / per_byte] >> shift) & mask];
+		}
+		return;
+	}
+
+	// 16-bit channels are stored most significant byte first, so the high
+	// byte of every channel is found at `channel * 2`.
+	const std::size_t stride = image.depth == 16 ? 2 : 1;
+	const std::size_t pixel = image.channels * stride;
+	const bool has_key = image.has_key;
+	switch (image.color) {
+		case COLOR_GRAY:  // 16-bit only, see `gray_lookup()`.
+			for (std::size_t x = 0; x < width; x++) {
+				const Uint8* p = row + x * pixel;
+				std::uint32_t alpha =
+					has_key && ((p[0] << 8) | p[1]) == image.key[0] ? 0 : 255;
+				out[x * step] = packing.pack(p[0], p[0], p[0], alpha);
+			}
+			break;
+		case COLOR_GRAY_ALPHA:
+			for (std::size_t x = 0; x < width; x++) {
+				const Uint8* p = row + x * pixel;
+				out[x * step] = packing.pack(p[0], p[0], p[0], p[stride]);
+			}
+			break;
+		case COLOR_RGB:
+			if (has_key) {
+				for (std::size_t x = 0; x < width; x++) {
+					const Uint8* p = row + x * pixel;
+					std::uint16_t r = stride == 2 ? (p[0] << 8) | p[1] : p[0];
+					std::uint16_t g = stride == 2 ? (p[2] << 8) | p[3] : p[1];
+					std::uint16_t b = stride == 2 ? (p[4] << 8) | p[5] : p[2];
+					bool keyed = r == image.key[0] && g == image.key[1] &&
+								 b == image.key[2];
+					out[x * step] = packing.pack(p[0], p[stride], p[stride * 2],
+												 keyed ? 0 : 255);
+				}
+			} else if (stride == 1) {
+				for (std::size_t x = 0; x < width; x++) {
+					const Uint8* p = row + x * 3;
+					out[x * step] = packing.pack(p[0], p[1], p[2], 255);
+				}
+			} else {
+				for (std::size_t x = 0; x < width; x++) {
+					const Uint8* p = row + x * 6;
+					out[x * step] = packing.pack(p[0], p[2], p[4], 255);
+				}
+			}
+			break;
+		case COLOR_RGBA:
+			if (stride == 1) {
+				for (std::size_t x = 0; x < width; x++) {
+					const Uint8* p = row + x * 4;
+					out[x * step] = packing.pack(p[0], p[1], p[2], p[3]);
+				}
+			} else {
+				for (std::size_t x = 0; x < width; x++) {
+					const Uint8* p = row + x * 8;
+					out[x * step] = packing.pack(p[0], p[2], p[4], p[6]);
+				}
+			}
+			break;
+		case COLOR_PALETTE:	 // Always uses a lookup table.
+			break;
+	}
+}
+
+// Build the lookup table of `convert_row()`, if the image can use one.
+static bool build_lookup(const PngImage& image, const PixelPacking& packing,
+						 std::array<std::uint32_t, 256>& lookup) {
+	if (image.color == COLOR_PALETTE) {
+		for (unsigned int i = 0; i < 256; i++) {
+			const Uint8* entry = image.palette.data() + i * 4;
+			lookup[i] = packing.pack(entry[0], entry[1], entry[2], entry[3]);
+		}
+		return true;
+	}
+	if (image.color == COLOR_GRAY && image.depth <= 8) {
+		const unsigned int levels = (1u << image.depth) - 1;
+		for (unsigned int i = 0; i <= levels; i++) {
+			std::uint32_t gray = i * 255 / levels;
+			std::uint32_t alpha = image.has_key && i == image.key[0] ? 0 : 255;
+			lookup[i] = packing.pack(gray, gray, gray, alpha);
+		}
+		return true;
+	}
+	return false;
+}
+
+bool get_png_decoder_memory(const Uint8* data, std::size_t size,
+							std::size_t& bytes) {
+	PngImage image;
+	if (!read_chunks(data, size, image)) {
+		return false;
+	}
+	const std::size_t max_row_size =
+		(static_cast<std::size_t>(image.width) * image.channels * image.depth +
+		 7) /
+		8;
+	bytes = image.data.capacity() * sizeof(image.data[0]) + 2 * max_row_size +
+			Inflater::memory(max_row_size + 1);
+	return true;
+}
+
+bool decode_png(const Uint8* data, std::size_t size, SDL_PixelFormat format,
+				const DecodeOutput& output) {
+	PngImage image;
+	PixelPacking packing{};
+	if (!read_chunks(data, size, image) || !get_packing(format, packing)) {
+		return false;
+	}
+	std::array<std::uint32_t, 256> lookup_table{};
+	const std::uint32_t* lookup =
+		build_lookup(image, packing, lookup_table) ? lookup_table.data()
+												   : nullptr;
+
+	const std::size_t bits_per_pixel = image.channels * image.depth;
+	const unsigned int bpp =
+		bits_per_pixel < 8 ? 1 : static_cast<unsigned int>(bits_per_pixel / 8);
+	const std::size_t max_row_size = (image.width * bits_per_pixel + 7) / 8;
+
+	SDL_Surface* surface = output.create(static_cast<int>(image.width),
+										 static_cast<int>(image.height));
+	if (surface == nullptr) {
+		return false;
+	}
+
+	std::size_t next_chunk = 0;
+	Inflater inflater(
+		[&image, &next_chunk](const Uint8*& chunk, std::size_t& length) {
+			if (next_chunk == image.data.size()) {
+				return false;
+			}
+			chunk = image.data[next_chunk].first;
+			length = image.data[next_chunk].second;
+			next_chunk++;
+			return true;
+		},
+		max_row_size + 1);
+
+	// Adam7 passes as (x offset, y offset, x step, y step). Images that are
+	// not interlaced are treated as a single pass.
+	static const unsigned int ADAM7[7][4] = {
+		{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+		{0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+	static const unsigned int SINGLE_PASS[1][4] = {{0, 0, 1, 1}};
+	const unsigned int(*passes)[4] = image.interlaced ? ADAM7 : SINGLE_PASS;
+	const int pass_count = image.interlaced ? 7 : 1;
+
+	std::vector<Uint8> previous(max_row_size);
+	std::vector<Uint8> current(max_row_size);
+	auto* pixels = static_cast<Uint8*>(surface->pixels);
+	for (int pass = 0; pass < pass_count; pass++) {
+		const unsigned int* p = passes[pass];
+		if (p[0] >= image.width || p[1] >= image.height) {
+			continue;  // Empty passes have no scanlines at all.
+		}
+		const std::size_t width = (image.width - p[0] + p[2] - 1) / p[2];
+		const std::size_t height = (image.height - p[1] + p[3] - 1) / p[3];
+		const std::size_t row_size = (width * bits_per_pixel + 7) / 8;
+		std::fill(previous.begin(), previous.begin() + row_size, 0);
+
+		for (std::size_t y = 0; y < height; y++) {
+			InflateStatus status = inflater.fill(row_size + 1);
+			if (status != INFLATE_OK) {
+				if (status == INFLATE_END) {
+					SDL_SetError("PNG image data is truncated");
+				}
+				return false;
+			}
+			const Uint8* filtered = inflater.data();
+			if (filtered[0] > PNG_FILTER_PAETH) {
+				return SDL_SetError("Invalid PNG filter type %d", filtered[0]);
+			}
+			png_unfilter(static_cast<PngFilter>(filtered[0]), filtered + 1,
+						 previous.data(), current.data(), row_size, bpp);
+			inflater.consume(row_size + 1);
+
+			auto* out = reinterpret_cast<std::uint32_t*>(
+				pixels + (p[1] + y * p[3]) * surface->pitch) + p[0];
+			convert_row(image, packing, lookup, current.data(), width, out,
+						p[2]);
+			std::swap(previous, current);
+
+			// Rows are final once the last pass has reached them. Every pass
+			// but the last covers the even rows only, so the last pass
+			// completes two rows at a time.
+			if (pass == pass_count - 1 && output.progress) {
+				const std::size_t rows =
+					std::min<std::size_t>(p[1] + y * p[3] + 1, image.height);
+				if (!output.progress(static_cast<int>(rows))) {
+					return SDL_SetError("Decoding was cancelled");
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+SDL_Surface* decode_png(const Uint8* data, std::size_t size,
+						SDL_PixelFormat format) {
+	SDL_Surface* surface = nullptr;
+	DecodeOutput output;
+	output.create = [&surface, format](int width, int height) {
+		surface = SDL_CreateSurface(width, height, format);
+		return surface;
+	};
+	if (!decode_png(data, size, format, output)) {
+		SDL_DestroySurface(surface);
+		return nullptr;
+	}
+	return surface;
+}
@@ -0,0 +1,61 @@
+#ifndef SRC_PNG_DECODER_H_
+#define SRC_PNG_DECODER_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+
+#include "decode_output.h"
+
+/*
+Check whether a file starts with the PNG signature.
+
+@param data The first bytes of the file.
+@param size The number of bytes available at `data`.
+*/
+bool is_png(const Uint8* data, std::size_t size);
+
+/*
+Compute the most memory `decode_png()` allocates for an image besides the
+surface it decodes into: two scanlines, the decompressor and the list of data
+chunks.
+
+@return `false` if the file has no valid header, in which case
+`SDL_GetError()` describes the error.
+*/
+bool get_png_decoder_memory(const Uint8* data, std::size_t size,
+							std::size_t& bytes);
+
+/*
+Decode a PNG image held in memory.
+
+All standard color types, bit depths (16-bit channels are reduced to 8 bits),
+transparency (tRNS) and Adam7 interlacing are supported. Ancillary chunks such
+as gamma and color profiles are ignored, and chunk CRCs are not verified.
+
+Pixels are converted while they are being decoded and written straight into
+the output surface, so no intermediate copy of the image is made. Progress is
+reported after every row, except for interlaced images, whose rows are only
+final during the last of the seven passes.
+
+@param format The pixel format of the surface returned by `output.create`,
+which must be a packed 32-bit format with 8 bits per color channel, such as
+the preferred texture format of a renderer.
+@param output Receives the decoded image.
+
+@return `true` if the whole image was decoded, or `false` if it could not be,
+in which case `SDL_GetError()` describes the error.
+*/
+bool decode_png(const Uint8* data, std::size_t size, SDL_PixelFormat format,
+				const DecodeOutput& output);
+
+/*
+Decode a PNG image held in memory into a new surface.
+
+@return A surface owned by the caller, or `nullptr` if the image could not be
+decoded, in which case `SDL_GetError()` describes the error.
+*/
+SDL_Surface* decode_png(const Uint8* data, std::size_t size,
+						SDL_PixelFormat format);
+
+#endif	// SRC_PNG_DECODER_H_
@@ -0,0 +1,198 @@
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "deflate.h"
+#include "png_filters.h"
+
+// Largest amount of image data stored in a single IDAT chunk.
+static const std::size_t MAX_CHUNK_SIZE = 1 << 20;
+
+static std::uint32_t crc32(std::uint32_t crc, const Uint8* data,
+						   std::size_t size) {
+	struct Table {
+		std::array<std::uint32_t, 256> entries;
+		Table() : entries{} {
+			for (std::uint32_t i = 0; i < 256; i++) {
+				std::uint32_t c = i;
+				for (int bit = 0; bit < 8; bit++) {
+					c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				}
+				entries[i] = c;
+			}
+		}
+	};
+	static const Table table;
+
+	crc = ~crc;
+	for (std::size_t i = 0; i < size; i++) {
+		crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void put_u32(std::vector<Uint8>& out, std::uint32_t value) {
+	out.push_back(static_cast<Uint8>(value >> 24));
+	out.push_back(static_cast<Uint8>(value >> 16));
+	out.push_back(static_cast<Uint8>(value >> 8));
+	out.push_back(static_cast<Uint8>(value));
+}
+
+static void put_chunk(std::vector<Uint8>& out, const char* type,
+					  const Uint8* data, std::size_t size) {
+	put_u32(out, static_cast<std::uint32_t>(size));
+	std::size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+	put_u32(out, crc32(0, out.data() + start, size + 4));
+}
+
+// The size of the filtered scanlines of an image stored as RGBA, the most they
+// take, with the filter byte of every row.
+static std::size_t filtered_size(int width, int height) {
+	return (static_cast<std::size_t>(width) * 4 + 1) *
+		   static_cast<std::size_t>(height);
+}
+
+// The size of a PNG file holding a compressed stream of `compressed` bytes:
+// the signature, the header chunk, the data chunks and the end chunk.
+static std::size_t file_size(std::size_t compressed) {
+	const std::size_t chunks = compressed / MAX_CHUNK_SIZE + 1;
+	return 8 + 25 + compressed + 12 * chunks + 12;
+}
+
+// Apply a PNG filter to a scanline, the inverse of `png_unfilter()`.
+static void apply_filter(PngFilter filter, const Uint8* row,
+						 const Uint8* previous, Uint8* out, std::size_t size,
+						 unsigned int bpp) {
+	for (std::size_t i = 0; i < size; i++) {
+		int a = i >= bpp ? row[i - bpp] : 0;
+		int b = previous[i];
+		int c = i >= bpp ? previous[i - bpp] : 0;
+		int prediction = 0;
+		switch (filter) {
+			case PNG_FILTER_NONE:
+				break;
+			case PNG_FILTER_SUB:
+				prediction = a;
+				break;
+			case PNG_FILTER_UP:
+				prediction = b;
+				break;
+			case PNG_FILTER_AVERAGE:
+				prediction = (a + b) / 2;
+				break;
+			case PNG_FILTER_PAETH: {
+				int pa = std::abs(b - c);
+				int pb = std::abs(a - c);
+				int pc = std::abs(a + b - 2 * c);
+				prediction = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+				break;
+			}
+		}
+		out[i] = static_cast<Uint8>(row[i] - prediction);
+	}
+}
+
+bool encode_png(SDL_Surface* surface, std::vector<Uint8>& out) {
+	// Surfaces already in RGBA are read in place.
+	SDL_Surface* rgba = surface;
+	if (surface->format != SDL_PIXELFORMAT_RGBA32 || SDL_MUSTLOCK(surface)) {
+		rgba = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+		if (rgba == nullptr) {
+			return false;
+		}
+	}
+	const std::size_t width = static_cast<std::size_t>(rgba->w);
+	const std::size_t height = static_cast<std::size_t>(rgba->h);
+	const auto* pixels = static_cast<const Uint8*>(rgba->pixels);
+
+	bool opaque = true;
+	for (std::size_t y = 0; y < height && opaque; y++) {
+		const Uint8* row = pixels + y * rgba->pitch;
+		for (std::size_t x = 0; x < width; x++) {
+			if (row[x * 4 + 3] != 255) {
+				opaque = false;
+				break;
+			}
+		}
+	}
+	const unsigned int channels = opaque ? 3 : 4;
+	const std::size_t row_size = width * channels;
+
+	// Filter every scanline with each filter and keep the one with the
+	// smallest sum of absolute values (as signed bytes).
+	std::vector<Uint8> filtered((row_size + 1) * height);
+	std::vector<Uint8> previous(row_size, 0);
+	std::vector<Uint8> current(row_size);
+	std::vector<Uint8> candidate(row_size);
+	for (std::size_t y = 0; y < height; y++) {
+		const Uint8* source = pixels + y * rgba->pitch;
+		for (std::size_t x = 0; x < width; x++) {
+			std::memcpy(current.data() + x * channels, source + x * 4,
+						channels);
+		}
+
+		Uint8* line = filtered.data() + y * (row_size + 1);
+		std::uint64_t best_cost = UINT64_MAX;
+		for (int filter = PNG_FILTER_NONE; filter <= PNG_FILTER_PAETH;
+			 filter++) {
+			apply_filter(static_cast<PngFilter>(filter), current.data(),
+						 previous.data(), candidate.data(), row_size,
+						 channels);
+			std::uint64_t cost = 0;
+			for (Uint8 value : candidate) {
+				cost += static_cast<std::uint64_t>(
+					std::abs(static_cast<int>(static_cast<Sint8>(value))));
+			}
+			if (cost < best_cost) {
+				best_cost = cost;
+				line[0] = static_cast<Uint8>(filter);
+				std::memcpy(line + 1, candidate.data(), row_size);
+			}
+		}
+		std::swap(previous, current);
+	}
+	if (rgba != surface) {
+		SDL_DestroySurface(rgba);
+	}
+
+	std::vector<Uint8> compressed;
+	zlib_compress(filtered.data(), filtered.size(), compressed);
+
+	static const Uint8 SIGNATURE[8] = {0x89, 'P',  'N',	 'G',
+									   '\r', '\n', 0x1a, '\n'};
+	out.reserve(out.size() + file_size(compressed.size()));
+	out.insert(out.end(), SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+
+	std::vector<Uint8> header;
+	put_u32(header, static_cast<std::uint32_t>(width));
+	put_u32(header, static_cast<std::uint32_t>(height));
+	header.push_back(8);					 // Bit depth.
+	header.push_back(opaque ? 2 : 6);		 // RGB or RGBA.
+	header.insert(header.end(), {0, 0, 0});	 // Compression, filter, interlace.
+	put_chunk(out, "IHDR", header.data(), header.size());
+
+	for (std::size_t offset = 0; offset < compressed.size();
+		 offset += MAX_CHUNK_SIZE) {
+		put_chunk(out, "IDAT", compressed.data() + offset,
+				  std::min(MAX_CHUNK_SIZE, compressed.size() - offset));
+	}
+	put_chunk(out, "IEND", nullptr, 0);
+	return true;
+}
+
+std::size_t png_encoded_size_bound(int width, int height) {
+	return file_size(zlib_compress_bound(filtered_size(width, height)));
+}
+
+std::size_t png_encoder_memory(int width, int height) {
+	const std::size_t row_size = static_cast<std::size_t>(width) * 4;
+	return filtered_size(width, height) + 3 * row_size +
+		   zlib_compress_memory(filtered_size(width, height));
+}
@@ -0,0 +1,35 @@
+#ifndef SRC_PNG_ENCODER_H_
+#define SRC_PNG_ENCODER_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <vector>
+
+/*
+Encode a surface as a PNG image.
+
+Images without any transparent pixels are stored as 8-bit RGB and all other
+images as 8-bit RGBA. The filter of every scanline is picked with the minimum
+sum of absolute differences heuristic recommended by the PNG specification.
+
+@param surface The image to encode, in any pixel format. Surfaces in
+`SDL_PIXELFORMAT_RGBA32` are read as they are, others are converted first.
+@param out The PNG file is appended to this vector.
+
+@return `false` if the surface could not be read, in which case
+`SDL_GetError()` describes the error.
+*/
+bool encode_png(SDL_Surface* surface, std::vector<Uint8>& out);
+
+// The largest PNG file `encode_png()` writes for an image of a given size.
+std::size_t png_encoded_size_bound(int width, int height);
+
+/*
+The most memory `encode_png()` allocates for a surface in
+`SDL_PIXELFORMAT_RGBA32` of a given size besides the file it appends to `out`:
+the filtered scanlines and their compressed stream.
+*/
+std::size_t png_encoder_memory(int width, int height);
+
+#endif	// SRC_PNG_ENCODER_H_
@@ -0,0 +1,309 @@
+#include "png_filters.h"
+
+#include <SDL3/SDL_intrin.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// Signature shared by all unfiltering functions.
+using Unfilter = void (*)(const Uint8* filtered, const Uint8* previous,
+						  Uint8* row, std::size_t size, unsigned int bpp);
+
+/*
+Scalar versions, which handle every pixel size.
+*/
+
+static void unfilter_none(const Uint8* filtered, const Uint8* /*previous*/,
+						  Uint8* row, std::size_t size,
+						  unsigned int /*bpp*/) {
+	std::memcpy(row, filtered, size);
+}
+
+static void unfilter_sub(const Uint8* filtered, const Uint8* /*previous*/,
+						 Uint8* row, std::size_t size, unsigned int bpp) {
+	std::size_t i = 0;
+	for (; i < bpp && i < size; i++) {
+		row[i] = filtered[i];
+	}
+	for (; i < size; i++) {
+		row[i] = filtered[i] + row[i - bpp];
+	}
+}
+
+static void unfilter_up(const Uint8* filtered, const Uint8* previous,
+						Uint8* row, std::size_t size, unsigned int /*bpp*/) {
+	for (std::size_t i = 0; i < size; i++) {
+		row[i] = filtered[i] + previous[i];
+	}
+}
+
+static void unfilter_average(const Uint8* filtered, const Uint8* previous,
+							 Uint8* row, std::size_t size, unsigned int bpp) {
+	std::size_t i = 0;
+	for (; i < bpp && i < size; i++) {
+		row[i] = filtered[i] + (previous[i] >> 1);
+	}
+	for (; i < size; i++) {
+		row[i] = filtered[i] + ((row[i - bpp] + previous[i]) >> 1);
+	}
+}
+
+static inline Uint8 paeth_predictor(int a, int b, int c) {
+	int pa = std::abs(b - c);
+	int pb = std::abs(a - c);
+	int pc = std::abs(a + b - 2 * c);
+	if (pa <= pb && pa <= pc) {
+		return static_cast<Uint8>(a);
+	}
+	return static_cast<Uint8>(pb <= pc ? b : c);
+}
+
+static void unfilter_paeth(const Uint8* filtered, const Uint8* previous,
+						   Uint8* row, std::size_t size, unsigned int bpp) {
+	std::size_t i = 0;
+	for (; i < bpp && i < size; i++) {
+		row[i] = filtered[i] + previous[i];
+	}
+	for (; i < size; i++) {
+		row[i] = filtered[i] + paeth_predictor(row[i - bpp], previous[i],
+											   previous[i - bpp]);
+	}
+}
+
+#ifdef SDL_SSE2_INTRINSICS
+/*
+SSE2 versions for 3 and 4 bytes per pixel.
+
+Sub, Average and Paeth depend on the reconstructed pixel to the left, so
+Average and Paeth handle one pixel at a time (in the style of libpng), while
+Sub uses a prefix sum to handle four pixels at a time. Up has no such
+dependency and handles 16 bytes at a time.
+*/
+
+// The pixel size is a template parameter so that moving a pixel compiles to
+// a few plain loads and stores. Three bytes are assembled in a register, since
+// copying them through memory stalls store forwarding.
+template <unsigned int BPP>
+SDL_TARGETING("sse2")
+static inline __m128i load_pixel(const Uint8* p) {
+	std::uint32_t value;
+	if (BPP == 4) {
+		std::memcpy(&value, p, 4);
+	} else {
+		std::uint16_t low;
+		std::memcpy(&low, p, 2);
+		value = low | static_cast<std::uint32_t>(p[2]) << 16;
+	}
+	return _mm_cvtsi32_si128(static_cast<int>(value));
+}
+
+template <unsigned int BPP>
+SDL_TARGETING("sse2")
+static inline void store_pixel(Uint8* p, __m128i pixel) {
+	auto value = static_cast<std::uint32_t>(_mm_cvtsi128_si32(pixel));
+	if (BPP == 4) {
+		std::memcpy(p, &value, 4);
+	} else {
+		auto low = static_cast<std::uint16_t>(value);
+		std::memcpy(p, &low, 2);
+		p[2] = static_cast<Uint8>(value >> 16);
+	}
+}
+
+SDL_TARGETING("sse2")
+static void unfilter_sub_sse2(const Uint8* filtered, const Uint8* previous,
+							  Uint8* row, std::size_t size, unsigned int bpp) {
+	__m128i carry = _mm_setzero_si128();  // The last pixel, replicated.
+	std::size_t i = 0;
+	if (bpp == 4) {
+		for (; i + 16 <= size; i += 16) {
+			__m128i x = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(filtered + i));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+			x = _mm_add_epi8(x, carry);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), x);
+			carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+		}
+	} else {
+		// Four 3-byte pixels per iteration. The last four bytes written are
+		// garbage and are overwritten by the next iteration or the tail.
+		const __m128i low_pixel = _mm_cvtsi32_si128(0xffffff);
+		for (; i + 16 <= size; i += 12) {
+			__m128i x = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(filtered + i));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 3));
+			x = _mm_add_epi8(x, _mm_slli_si128(x, 6));
+			x = _mm_add_epi8(x, carry);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), x);
+			carry = _mm_and_si128(_mm_srli_si128(x, 9), low_pixel);
+			carry = _mm_or_si128(carry, _mm_slli_si128(carry, 3));
+			carry = _mm_or_si128(carry, _mm_slli_si128(carry, 6));
+		}
+	}
+	if (i == 0) {
+		unfilter_sub(filtered, previous, row, size, bpp);
+		return;
+	}
+	for (; i < size; i++) {
+		row[i] = filtered[i] + row[i - bpp];
+	}
+}
+
+SDL_TARGETING("sse2")
+static void unfilter_up_sse2(const Uint8* filtered, const Uint8* previous,
+							 Uint8* row, std::size_t size,
+							 unsigned int /*bpp*/) {
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i x =
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(filtered + i));
+		__m128i b =
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i),
+						 _mm_add_epi8(x, b));
+	}
+	for (; i < size; i++) {
+		row[i] = filtered[i] + previous[i];
+	}
+}
+
+template <unsigned int BPP>
+SDL_TARGETING("sse2")
+static void average_sse2(const Uint8* filtered, const Uint8* previous,
+						 Uint8* row, std::size_t size) {
+	// _mm_avg_epu8 rounds up, so subtract the lowest bit of a ^ b.
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i a = _mm_setzero_si128();
+	for (std::size_t i = 0; i + BPP <= size; i += BPP) {
+		__m128i b = load_pixel<BPP>(previous + i);
+		__m128i x = load_pixel<BPP>(filtered + i);
+		__m128i average = _mm_sub_epi8(
+			_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+		a = _mm_add_epi8(x, average);
+		store_pixel<BPP>(row + i, a);
+	}
+}
+
+static void unfilter_average_sse2(const Uint8* filtered, const Uint8* previous,
+								  Uint8* row, std::size_t size,
+								  unsigned int bpp) {
+	if (bpp == 4) {
+		average_sse2<4>(filtered, previous, row, size);
+	} else {
+		average_sse2<3>(filtered, previous, row, size);
+	}
+}
+
+SDL_TARGETING("sse2")
+static inline __m128i choose(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+SDL_TARGETING("sse2")
+static inline __m128i absolute(__m128i x) {
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+template <unsigned int BPP>
+SDL_TARGETING("sse2")
+static void paeth_sse2(const Uint8* filtered, const Uint8* previous,
+					   Uint8* row, std::size_t size) {
+	// Channels are widened to 16 bits, so that a + b - c cannot overflow.
+	const __m128i zero = _mm_setzero_si128();
+	__m128i a = zero;
+	__m128i c = zero;
+	for (std::size_t i = 0; i + BPP <= size; i += BPP) {
+		__m128i b = _mm_unpacklo_epi8(load_pixel<BPP>(previous + i), zero);
+		__m128i x = _mm_unpacklo_epi8(load_pixel<BPP>(filtered + i), zero);
+
+		// With p = a + b - c: pa = |p - a|, pb = |p - b| and pc = |p - c|.
+		__m128i pa = _mm_sub_epi16(b, c);
+		__m128i pb = _mm_sub_epi16(a, c);
+		__m128i pc = absolute(_mm_add_epi16(pa, pb));
+		pa = absolute(pa);
+		pb = absolute(pb);
+		__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+		// Ties are broken in the order a, b, c.
+		__m128i nearest =
+			choose(_mm_cmpeq_epi16(smallest, pa), a,
+				   choose(_mm_cmpeq_epi16(smallest, pb), b, c));
+		a = _mm_add_epi8(x, nearest);
+		store_pixel<BPP>(row + i, _mm_packus_epi16(a, a));
+		c = b;
+	}
+}
+
+static void unfilter_paeth_sse2(const Uint8* filtered, const Uint8* previous,
+								Uint8* row, std::size_t size,
+								unsigned int bpp) {
+	if (bpp == 4) {
+		paeth_sse2<4>(filtered, previous, row, size);
+	} else {
+		paeth_sse2<3>(filtered, previous, row, size);
+	}
+}
+#endif	// SDL_SSE2_INTRINSICS
+
+#ifdef SDL_AVX2_INTRINSICS
+SDL_TARGETING("avx2")
+static void unfilter_up_avx2(const Uint8* filtered, const Uint8* previous,
+							 Uint8* row, std::size_t size,
+							 unsigned int /*bpp*/) {
+	std::size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i x =
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(filtered + i));
+		__m256i b =
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(row + i),
+							_mm256_add_epi8(x, b));
+	}
+	for (; i < size; i++) {
+		row[i] = filtered[i] + previous[i];
+	}
+}
+#endif	// SDL_AVX2_INTRINSICS
+
+namespace {
+
+// The best unfiltering functions supported by the CPU, indexed by filter type.
+struct UnfilterTable {
+	Unfilter generic[5];	// For any pixel size.
+	Unfilter pixel34[5];	// For 3 and 4 bytes per pixel.
+
+	UnfilterTable()
+		: generic{unfilter_none, unfilter_sub, unfilter_up, unfilter_average,
+				  unfilter_paeth},
+		  pixel34{unfilter_none, unfilter_sub, unfilter_up, unfilter_average,
+				  unfilter_paeth} {
+#ifdef SDL_SSE2_INTRINSICS
+		if (SDL_HasSSE2()) {
+			generic[PNG_FILTER_UP] = unfilter_up_sse2;
+			pixel34[PNG_FILTER_SUB] = unfilter_sub_sse2;
+			pixel34[PNG_FILTER_UP] = unfilter_up_sse2;
+			pixel34[PNG_FILTER_AVERAGE] = unfilter_average_sse2;
+			pixel34[PNG_FILTER_PAETH] = unfilter_paeth_sse2;
+		}
+#endif
+#ifdef SDL_AVX2_INTRINSICS
+		if (SDL_HasAVX2()) {
+			generic[PNG_FILTER_UP] = unfilter_up_avx2;
+			pixel34[PNG_FILTER_UP] = unfilter_up_avx2;
+		}
+#endif
+	}
+};
+
+}  // namespace
+
+void png_unfilter(PngFilter filter, const Uint8* filtered,
+				  const Uint8* previous, Uint8* row, std::size_t size,
+				  unsigned int bpp) {
+	static const UnfilterTable table;
+	const Unfilter* functions =
+		bpp == 3 || bpp == 4 ? table.pixel34 : table.generic;
+	functions[filter](filtered, previous, row, size, bpp);
+}
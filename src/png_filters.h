@@ -0,0 +1,37 @@
+#ifndef SRC_PNG_FILTERS_H_
+#define SRC_PNG_FILTERS_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+
+// PNG filter types (see section 9 of the PNG specification).
+enum PngFilter {
+	PNG_FILTER_NONE,
+	PNG_FILTER_SUB,
+	PNG_FILTER_UP,
+	PNG_FILTER_AVERAGE,
+	PNG_FILTER_PAETH
+};
+
+/*
+Reconstruct a filtered scanline.
+
+SSE2 versions are used for images with 3 or 4 bytes per pixel (8-bit RGB and
+RGBA, which is what almost every photo and screenshot is stored as) and an AVX2
+version for the Up filter, if the CPU supports them.
+
+@param filter The filter type of the scanline, at most `PNG_FILTER_PAETH`.
+@param filtered The filtered scanline, without the filter type byte.
+@param previous The reconstructed previous scanline, all zeros for the first
+scanline of an image (or of an interlace pass).
+@param row Where the reconstructed scanline is written, must not overlap
+`filtered` or `previous`.
+@param size Size of the scanline in bytes.
+@param bpp Number of bytes per complete pixel, rounded up to at least 1.
+*/
+void png_unfilter(PngFilter filter, const Uint8* filtered,
+				  const Uint8* previous, Uint8* row, std::size_t size,
+				  unsigned int bpp);
+
+#endif	// SRC_PNG_FILTERS_H_
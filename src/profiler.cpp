@@ -0,0 +1,156 @@
+#include "profiler.h"
+
+#include <imgui.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Number of frames kept in the history.
+static const std::size_t HISTORY_SIZE = 240;
+
+static const char* const STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+	"Events", "Decode", "Resample", "Adjust", "Upload", "Render"};
+
+namespace {
+
+// The time spent in a stage since the last frame, and how often it ran.
+struct StageTotal {
+	std::atomic<Uint64> ticks{0};
+	std::atomic<Uint32> count{0};
+};
+
+// The measurements of the last frames, in milliseconds, in a ring buffer.
+struct ProfileHistory {
+	std::array<float, HISTORY_SIZE> frames{};
+	std::array<std::array<float, HISTORY_SIZE>, PROFILE_STAGE_COUNT> stages{};
+	std::array<std::array<Uint32, HISTORY_SIZE>, PROFILE_STAGE_COUNT> counts{};
+	std::size_t next = 0;  // Where the next frame goes.
+	std::size_t size = 0;
+};
+
+}  // namespace
+
+static std::atomic<bool> enabled{false};
+static std::array<StageTotal, PROFILE_STAGE_COUNT> totals;
+static ProfileHistory history;	// Only used by the main thread.
+
+void set_profiling(bool enable) {
+	if (enable && !enabled.load()) {
+		// Start from scratch rather than mixing in stale measurements.
+		for (StageTotal& total : totals) {
+			total.ticks.store(0);
+			total.count.store(0);
+		}
+		history = ProfileHistory{};
+	}
+	enabled.store(enable);
+}
+
+bool profiling() { return enabled.load(std::memory_order_relaxed); }
+
+void profile_add(ProfileStage stage, Uint64 ticks) {
+	totals[stage].ticks.fetch_add(ticks, std::memory_order_relaxed);
+	totals[stage].count.fetch_add(1, std::memory_order_relaxed);
+}
+
+static float to_milliseconds(Uint64 ticks) {
+	return static_cast<float>(static_cast<double>(ticks) * 1000 /
+							  static_cast<double>(
+								  SDL_GetPerformanceFrequency()));
+}
+
+void profile_end_frame(Uint64 frame_ticks) {
+	if (!profiling()) {
+		return;
+	}
+	const std::size_t frame = history.next;
+	history.frames[frame] = to_milliseconds(frame_ticks);
+	for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+		history.stages[stage][frame] =
+			to_milliseconds(totals[stage].ticks.exchange(0));
+		history.counts[stage][frame] = totals[stage].count.exchange(0);
+	}
+	history.next = (frame + 1) % HISTORY_SIZE;
+	history.size = std::min(history.size + 1, HISTORY_SIZE);
+}
+
+// The smallest value at least a fraction of the values are less or equal to.
+static float percentile(std::vector<float>& values, double fraction) {
+	const std::size_t rank =
+		std::min(values.size() - 1,
+				 static_cast<std::size_t>(fraction * values.size()));
+	std::nth_element(values.begin(), values.begin() + rank, values.end());
+	return values[rank];
+}
+
+void draw_profile_overlay(bool* open) {
+	ImGui::SetNextWindowSize(ImVec2(480, 320), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowBgAlpha(0.85f);
+	if (!ImGui::Begin("Profiler", open)) {
+		ImGui::End();
+		return;
+	}
+	if (history.size == 0) {
+		ImGui::Text("No frames have been measured yet.");
+		ImGui::End();
+		return;
+	}
+
+	// Frame times, oldest first.
+	std::vector<float> values(history.frames.begin(),
+							  history.frames.begin() + history.size);
+	const std::size_t last = (history.next + HISTORY_SIZE - 1) % HISTORY_SIZE;
+	const float latest = history.frames[last];
+	const float p50 = percentile(values, 0.5);
+	const float p99 = percentile(values, 0.99);
+	const float slowest = *std::max_element(values.begin(), values.end());
+	ImGui::Text("Frame: %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms",
+				latest, p50, p99, slowest);
+	ImGui::PlotHistogram(
+		"##frames", history.frames.data(), static_cast<int>(history.size),
+		history.size == HISTORY_SIZE ? static_cast<int>(history.next) : 0,
+		nullptr, 0, slowest, ImVec2(-1, 80));
+
+	// Percentiles of the frames during which each stage ran.
+	const ImGuiTableFlags flags =
+		ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV;
+	if (ImGui::BeginTable("stages", 6, flags)) {
+		for (const char* heading :
+			 {"Stage", "Calls/frame", "p50 ms", "p90 ms", "p99 ms", "Max ms"}) {
+			ImGui::TableSetupColumn(heading);
+		}
+		ImGui::TableHeadersRow();
+		for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+			values.clear();
+			Uint64 calls = 0;
+			for (std::size_t i = 0; i < history.size; i++) {
+				calls += history.counts[stage][i];
+				if (history.counts[stage][i] > 0) {
+					values.push_back(history.stages[stage][i]);
+				}
+			}
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(STAGE_NAMES[stage]);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", static_cast<double>(calls) /
+									static_cast<double>(history.size));
+			if (values.empty()) {
+				continue;
+			}
+			for (double fraction : {0.5, 0.9, 0.99}) {
+				ImGui::TableNextColumn();
+				ImGui::Text("%.2f", percentile(values, fraction));
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f",
+						*std::max_element(values.begin(), values.end()));
+		}
+		ImGui::EndTable();
+	}
+	ImGui::Text("Over the last %zu frames drawn.", history.size);
+	ImGui::End();
+}
@@ -0,0 +1,76 @@
+#ifndef SRC_PROFILER_H_
+#define SRC_PROFILER_H_
+
+#include <SDL3/SDL.h>
+
+/*
+Instrumentation of the image pipeline: scoped timers adding up the time spent
+in each stage and the number of times it ran, collected once per frame into a
+history shown by an ImGui overlay.
+
+Timers may run on any thread. Stages running on worker threads are counted in
+the frame during which they finish, and stages may nest, e.g. thumbnails are
+resampled while they are made and tiles are adjusted while they are uploaded.
+Nothing is measured while profiling is disabled, which is the default.
+*/
+
+// The stages of the pipeline measured by the profiler.
+enum ProfileStage {
+	PROFILE_STAGE_EVENTS,	 // Handling input events.
+	PROFILE_STAGE_DECODE,	 // Decoding images and making thumbnails.
+	PROFILE_STAGE_RESAMPLE,	 // Resampling images.
+	PROFILE_STAGE_ADJUST,	 // Applying adjustments to images.
+	PROFILE_STAGE_UPLOAD,	 // Uploading tiles and thumbnails to textures.
+	PROFILE_STAGE_RENDER,	 // Drawing the ImGui draw data with the renderer.
+	PROFILE_STAGE_COUNT
+};
+
+// Start or stop measuring. Timers already running when profiling is enabled
+// are not counted.
+void set_profiling(bool enabled);
+
+bool profiling();
+
+// Add time spent in a stage, in performance counter ticks. May be called from
+// any thread.
+void profile_add(ProfileStage stage, Uint64 ticks);
+
+// Measures the time from its construction to the end of its scope.
+class ProfileScope {
+   private:
+	ProfileStage stage;
+	Uint64 start;  // 0 if profiling was disabled.
+
+   public:
+	explicit ProfileScope(ProfileStage stage)
+		: stage{stage}, start{profiling() ? SDL_GetPerformanceCounter() : 0} {}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	~ProfileScope() {
+		if (start != 0) {
+			profile_add(stage, SDL_GetPerformanceCounter() - start);
+		}
+	}
+};
+
+/*
+Move the time added to each stage since the previous frame into the history.
+Must be called from the main thread once per frame drawn.
+
+@param frame_ticks The time taken to handle the events of the frame and draw
+it, in performance counter ticks, excluding the time spent waiting for events.
+*/
+void profile_end_frame(Uint64 frame_ticks);
+
+/*
+Draw the profiler overlay: a histogram of the recent frame times and the
+percentiles of the time spent in each stage per frame. Must be called between
+`ImGui::NewFrame()` and `ImGui::Render()`.
+
+@param open Cleared when the overlay is closed.
+*/
+void draw_profile_overlay(bool* open);
+
+#endif	// SRC_PROFILER_H_
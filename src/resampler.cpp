@@ -0,0 +1,580 @@
+#include "resampler.h"
+
+#include <SDL3/SDL_intrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "profiler.h"
+
+// Weights are fixed-point numbers with this many fractional bits. 14 bits
+// leave room for the weights above 1 and below -1 of the sharper filters in a
+// 16-bit integer, which is what the SIMD versions multiply with.
+static const int WEIGHT_BITS = 14;
+
+// Bands are at least this many output rows high, so that threads do not spend
+// most of their time resampling the source rows shared with other bands.
+static const int MIN_BAND_ROWS = 32;
+
+/*
+Filter kernels, as functions of the distance between the centers of an input
+and an output pixel, in input pixels when scaling up and in output pixels when
+scaling down.
+*/
+
+static double bicubic(double x) {
+	const double a = -0.5;
+	x = std::abs(x);
+	if (x < 1) {
+		return ((a + 2) * x - (a + 3)) * x * x + 1;
+	}
+	if (x < 2) {
+		return ((a * x - 5 * a) * x + 8 * a) * x - 4 * a;
+	}
+	return 0;
+}
+
+static double sinc(double x) {
+	if (x == 0) {
+		return 1;
+	}
+	x *= SDL_PI_D;
+	return std::sin(x) / x;
+}
+
+static double lanczos3(double x) {
+	return x > -3 && x < 3 ? sinc(x) * sinc(x / 3) : 0;
+}
+
+// The distance from the center of an output pixel beyond which input pixels
+// do not contribute to it, in input pixels.
+static double filter_support(ResampleFilter filter, double scale) {
+	switch (filter) {
+		case RESAMPLE_FILTER_AREA:
+			return (scale + 1) / 2;
+		case RESAMPLE_FILTER_BICUBIC:
+			return 2 * std::max(scale, 1.0);
+		default:
+			return 3 * std::max(scale, 1.0);
+	}
+}
+
+/*
+The unnormalized weight of an input pixel.
+
+@param x The distance of the input pixel from the center of the output pixel,
+in input pixels.
+@param scale The number of input pixels per output pixel.
+*/
+static double filter_weight(ResampleFilter filter, double x, double scale) {
+	switch (filter) {
+		case RESAMPLE_FILTER_AREA:
+			// The length of the input pixel covered by the output pixel.
+			return std::max(std::min(x + 0.5, scale / 2) -
+								std::max(x - 0.5, -scale / 2),
+							0.0);
+		case RESAMPLE_FILTER_BICUBIC:
+			return bicubic(x / std::max(scale, 1.0));
+		default:
+			return lanczos3(x / std::max(scale, 1.0));
+	}
+}
+
+namespace {
+
+/*
+Precomputed weights for resampling along one axis. Every output pixel uses the
+same number of consecutive input pixels, which are all inside the input, so
+that the inner loops need neither bounds checks nor varying lengths.
+*/
+struct Kernel {
+	int taps;				  // Input pixels per output pixel.
+	std::vector<int> starts;  // The first input pixel of each output pixel.
+	std::vector<Sint16> weights;  // `taps` weights per output pixel.
+};
+
+}  // namespace
+
+// The number of input pixels each output pixel is computed from.
+static int kernel_taps(int size, double span, int count,
+					   ResampleFilter filter) {
+	// At most ceil(2 * support) input pixels are within the support. Rounding
+	// that up to a multiple of 4 lets the SIMD versions handle 4 at a time.
+	const double support = filter_support(filter, span / count);
+	return std::min((static_cast<int>(std::ceil(2 * support)) + 3) / 4 * 4,
+					size);
+}
+
+/*
+Compute the weights for resampling part of a row or column.
+
+@param size The number of input pixels.
+@param offset The position of the part to resample, in input pixels.
+@param span The length of the part to resample, in input pixels.
+@param count The number of output pixels.
+*/
+static Kernel make_kernel(int size, double offset, double span, int count,
+						  ResampleFilter filter) {
+	const double scale = span / count;
+	const double support = filter_support(filter, scale);
+	Kernel kernel;
+	kernel.taps = kernel_taps(size, span, count, filter);
+	kernel.starts.resize(count);
+	kernel.weights.assign(static_cast<std::size_t>(count) * kernel.taps, 0);
+	std::vector<double> weights(kernel.taps);
+	for (int i = 0; i < count; i++) {
+		// The input pixels within the support, cut down to the input.
+		const double center = offset + (i + 0.5) * scale;
+		int first = std::max(
+			static_cast<int>(std::floor(center - support + 0.5)), 0);
+		int end = std::min(
+			static_cast<int>(std::floor(center + support + 0.5)), size);
+		end = std::min(end, first + kernel.taps);
+
+		double sum = 0;
+		for (int x = first; x < end; x++) {
+			weights[x - first] = filter_weight(filter, x + 0.5 - center, scale);
+			sum += weights[x - first];
+		}
+		if (sum == 0) {
+			// The output pixel is outside the input, or too small to contain
+			// the center of any input pixel: use the nearest one.
+			first = std::clamp(static_cast<int>(center), 0, size - 1);
+			end = first + 1;
+			weights[0] = sum = 1;
+		}
+
+		// Round the weights so that they add up to exactly 1, which keeps
+		// areas of a single color unchanged.
+		const int start = std::min(first, size - kernel.taps);
+		Sint16* out = &kernel.weights[static_cast<std::size_t>(i) *
+										  kernel.taps +
+									  (first - start)];
+		int total = 0;
+		int largest = 0;
+		for (int x = 0; x < end - first; x++) {
+			out[x] = static_cast<Sint16>(
+				std::lround(weights[x] / sum * (1 << WEIGHT_BITS)));
+			total += out[x];
+			if (out[x] > out[largest]) {
+				largest = x;
+			}
+		}
+		out[largest] = static_cast<Sint16>(out[largest] +
+										   (1 << WEIGHT_BITS) - total);
+		kernel.starts[i] = start;
+	}
+	return kernel;
+}
+
+static inline Uint8 clamp_sample(int sum) {
+	return static_cast<Uint8>(std::clamp(sum >> WEIGHT_BITS, 0, 255));
+}
+
+/*
+Scalar versions.
+*/
+
+// Resample a row of 4-byte pixels horizontally.
+static void resample_row(const Uint8* source, Uint8* out,
+						 const Kernel& kernel) {
+	const int taps = kernel.taps;
+	for (std::size_t x = 0; x < kernel.starts.size(); x++) {
+		const Uint8* pixels = source + kernel.starts[x] * 4;
+		const Sint16* weights = &kernel.weights[x * taps];
+		int sums[4] = {};
+		for (int i = 0; i < taps; i++) {
+			for (int c = 0; c < 4; c++) {
+				sums[c] += pixels[i * 4 + c] * weights[i];
+			}
+		}
+		for (int c = 0; c < 4; c++) {
+			out[x * 4 + c] = clamp_sample(sums[c] + (1 << (WEIGHT_BITS - 1)));
+		}
+	}
+}
+
+/*
+Combine rows into one output row.
+
+@param rows The rows to combine, one per weight.
+@param first The first byte of the rows to combine.
+@param size The size of the rows in bytes.
+*/
+static void combine_rows(const Uint8* const* rows, const Sint16* weights,
+						 int taps, Uint8* out, std::size_t first,
+						 std::size_t size) {
+	for (std::size_t i = first; i < size; i++) {
+		int sum = 1 << (WEIGHT_BITS - 1);
+		for (int t = 0; t < taps; t++) {
+			sum += rows[t][i] * weights[t];
+		}
+		out[i] = clamp_sample(sum);
+	}
+}
+
+static void resample_column(const Uint8* const* rows, const Sint16* weights,
+							int taps, Uint8* out, std::size_t size) {
+	combine_rows(rows, weights, taps, out, 0, size);
+}
+
+#if defined(SDL_SSE4_1_INTRINSICS) || defined(SDL_AVX2_INTRINSICS)
+// Two weights in the low and high half of a 32-bit value, to be multiplied
+// with pairs of 16-bit samples by _mm_madd_epi16.
+static inline int weight_pair(Sint16 first, Sint16 second) {
+	return static_cast<int>(static_cast<Uint16>(first) |
+							static_cast<std::uint32_t>(
+								static_cast<Uint16>(second))
+								<< 16);
+}
+
+static inline int load_pixel(const Uint8* p) {
+	int pixel;
+	std::memcpy(&pixel, p, 4);
+	return pixel;
+}
+#endif
+
+#ifdef SDL_SSE4_1_INTRINSICS
+/*
+SSE4.1 versions.
+
+Horizontally, the channels of two neighbouring pixels are interleaved as
+16-bit values, so that _mm_madd_epi16 multiplies them with their weights and
+adds them up in one instruction. Vertically, the same is done with two rows at
+a time, 16 bytes of the rows at a time.
+*/
+
+SDL_TARGETING("sse4.1")
+static inline __m128i pack_sums(__m128i sums) {
+	sums = _mm_srai_epi32(sums, WEIGHT_BITS);
+	sums = _mm_packs_epi32(sums, sums);
+	return _mm_packus_epi16(sums, sums);
+}
+
+// Add the taps left over when an image is too small for a multiple of 4.
+SDL_TARGETING("sse4.1")
+static inline __m128i add_remaining_taps(const Uint8* pixels,
+										 const Sint16* weights, int i,
+										 int taps, __m128i sums) {
+	for (; i < taps; i++) {
+		__m128i pixel = _mm_cvtepu8_epi32(
+			_mm_cvtsi32_si128(load_pixel(pixels + i * 4)));
+		sums = _mm_add_epi32(
+			sums, _mm_mullo_epi32(pixel, _mm_set1_epi32(weights[i])));
+	}
+	return sums;
+}
+
+SDL_TARGETING("sse4.1")
+static void resample_row_sse41(const Uint8* source, Uint8* out,
+							   const Kernel& kernel) {
+	// Interleave the channels of pixels 0 and 1, and of pixels 2 and 3.
+	const __m128i low = _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6,
+									  -1, 3, -1, 7, -1);
+	const __m128i high = _mm_setr_epi8(8, -1, 12, -1, 9, -1, 13, -1, 10, -1,
+									   14, -1, 11, -1, 15, -1);
+	const int taps = kernel.taps;
+	for (std::size_t x = 0; x < kernel.starts.size(); x++) {
+		const Uint8* pixels = source + kernel.starts[x] * 4;
+		const Sint16* weights = &kernel.weights[x * taps];
+		__m128i sums = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+		int i = 0;
+		for (; i + 4 <= taps; i += 4) {
+			__m128i four = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(pixels + i * 4));
+			__m128i pairs = _mm_loadl_epi64(
+				reinterpret_cast<const __m128i*>(weights + i));
+			sums = _mm_add_epi32(
+				sums, _mm_madd_epi16(_mm_shuffle_epi8(four, low),
+									 _mm_shuffle_epi32(pairs, 0x00)));
+			sums = _mm_add_epi32(
+				sums, _mm_madd_epi16(_mm_shuffle_epi8(four, high),
+									 _mm_shuffle_epi32(pairs, 0x55)));
+		}
+		sums = add_remaining_taps(pixels, weights, i, taps, sums);
+		int pixel = _mm_cvtsi128_si32(pack_sums(sums));
+		std::memcpy(out + x * 4, &pixel, 4);
+	}
+}
+
+SDL_TARGETING("sse4.1")
+static void resample_column_sse41(const Uint8* const* rows,
+								  const Sint16* weights, int taps, Uint8* out,
+								  std::size_t size) {
+	const __m128i zero = _mm_setzero_si128();
+	std::size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128i sums[4];
+		for (__m128i& sum : sums) {
+			sum = _mm_set1_epi32(1 << (WEIGHT_BITS - 1));
+		}
+		for (int t = 0; t < taps; t += 2) {
+			__m128i a =
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + i));
+			__m128i b = zero;
+			__m128i pair = _mm_set1_epi32(weight_pair(weights[t], 0));
+			if (t + 1 < taps) {
+				b = _mm_loadu_si128(
+					reinterpret_cast<const __m128i*>(rows[t + 1] + i));
+				pair = _mm_set1_epi32(weight_pair(weights[t], weights[t + 1]));
+			}
+			__m128i low = _mm_unpacklo_epi8(a, b);
+			__m128i high = _mm_unpackhi_epi8(a, b);
+			sums[0] = _mm_add_epi32(
+				sums[0], _mm_madd_epi16(_mm_unpacklo_epi8(low, zero), pair));
+			sums[1] = _mm_add_epi32(
+				sums[1], _mm_madd_epi16(_mm_unpackhi_epi8(low, zero), pair));
+			sums[2] = _mm_add_epi32(
+				sums[2], _mm_madd_epi16(_mm_unpacklo_epi8(high, zero), pair));
+			sums[3] = _mm_add_epi32(
+				sums[3], _mm_madd_epi16(_mm_unpackhi_epi8(high, zero), pair));
+		}
+		for (__m128i& sum : sums) {
+			sum = _mm_srai_epi32(sum, WEIGHT_BITS);
+		}
+		__m128i samples = _mm_packus_epi16(_mm_packs_epi32(sums[0], sums[1]),
+										   _mm_packs_epi32(sums[2], sums[3]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), samples);
+	}
+	combine_rows(rows, weights, taps, out, i, size);
+}
+#endif	// SDL_SSE4_1_INTRINSICS
+
+#ifdef SDL_AVX2_INTRINSICS
+/*
+AVX2 versions, which work like the SSE4.1 ones on twice as much data at once:
+four pixels of the row or 32 bytes of the rows.
+*/
+
+SDL_TARGETING("avx2")
+static void resample_row_avx2(const Uint8* source, Uint8* out,
+							  const Kernel& kernel) {
+	// Interleave pixels 0 and 1 in the low lane and pixels 2 and 3 in the high
+	// lane of a vector holding four pixels in each lane.
+	const __m256i interleave = _mm256_setr_epi8(
+		0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1, 8, -1, 12, -1,
+		9, -1, 13, -1, 10, -1, 14, -1, 11, -1, 15, -1);
+	// Spread the first pair of weights over the low lane and the second pair
+	// over the high lane.
+	const __m256i lanes = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+	const int taps = kernel.taps;
+	for (std::size_t x = 0; x < kernel.starts.size(); x++) {
+		const Uint8* pixels = source + kernel.starts[x] * 4;
+		const Sint16* weights = &kernel.weights[x * taps];
+		__m256i wide = _mm256_setzero_si256();
+		int i = 0;
+		for (; i + 4 <= taps; i += 4) {
+			__m256i four = _mm256_broadcastsi128_si256(_mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(pixels + i * 4)));
+			__m256i weight_pairs = _mm256_permutevar8x32_epi32(
+				_mm256_castsi128_si256(_mm_loadl_epi64(
+					reinterpret_cast<const __m128i*>(weights + i))),
+				lanes);
+			wide = _mm256_add_epi32(
+				wide, _mm256_madd_epi16(_mm256_shuffle_epi8(four, interleave),
+										weight_pairs));
+		}
+		__m128i sums = _mm_add_epi32(
+			_mm_set1_epi32(1 << (WEIGHT_BITS - 1)),
+			_mm_add_epi32(_mm256_castsi256_si128(wide),
+						  _mm256_extracti128_si256(wide, 1)));
+		sums = add_remaining_taps(pixels, weights, i, taps, sums);
+		int pixel = _mm_cvtsi128_si32(pack_sums(sums));
+		std::memcpy(out + x * 4, &pixel, 4);
+	}
+}
+
+SDL_TARGETING("avx2")
+static void resample_column_avx2(const Uint8* const* rows,
+								 const Sint16* weights, int taps, Uint8* out,
+								 std::size_t size) {
+	// Unpacking and packing work within each 128-bit lane, so the bytes end
+	// up in their original order.
+	const __m256i zero = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i sums[4];
+		for (__m256i& sum : sums) {
+			sum = _mm256_set1_epi32(1 << (WEIGHT_BITS - 1));
+		}
+		for (int t = 0; t < taps; t += 2) {
+			__m256i a = _mm256_loadu_si256(
+				reinterpret_cast<const __m256i*>(rows[t] + i));
+			__m256i b = zero;
+			__m256i pair = _mm256_set1_epi32(weight_pair(weights[t], 0));
+			if (t + 1 < taps) {
+				b = _mm256_loadu_si256(
+					reinterpret_cast<const __m256i*>(rows[t + 1] + i));
+				pair =
+					_mm256_set1_epi32(weight_pair(weights[t], weights[t + 1]));
+			}
+			__m256i low = _mm256_unpacklo_epi8(a, b);
+			__m256i high = _mm256_unpackhi_epi8(a, b);
+			sums[0] = _mm256_add_epi32(
+				sums[0],
+				_mm256_madd_epi16(_mm256_unpacklo_epi8(low, zero), pair));
+			sums[1] = _mm256_add_epi32(
+				sums[1],
+				_mm256_madd_epi16(_mm256_unpackhi_epi8(low, zero), pair));
+			sums[2] = _mm256_add_epi32(
+				sums[2],
+				_mm256_madd_epi16(_mm256_unpacklo_epi8(high, zero), pair));
+			sums[3] = _mm256_add_epi32(
+				sums[3],
+				_mm256_madd_epi16(_mm256_unpackhi_epi8(high, zero), pair));
+		}
+		for (__m256i& sum : sums) {
+			sum = _mm256_srai_epi32(sum, WEIGHT_BITS);
+		}
+		__m256i samples =
+			_mm256_packus_epi16(_mm256_packs_epi32(sums[0], sums[1]),
+								_mm256_packs_epi32(sums[2], sums[3]));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), samples);
+	}
+	combine_rows(rows, weights, taps, out, i, size);
+}
+#endif	// SDL_AVX2_INTRINSICS
+
+namespace {
+
+// Pick the fastest versions the CPU supports.
+struct ResampleFunctions {
+	void (*row)(const Uint8* source, Uint8* out, const Kernel& kernel);
+	void (*column)(const Uint8* const* rows, const Sint16* weights, int taps,
+				   Uint8* out, std::size_t size);
+
+	ResampleFunctions() : row{resample_row}, column{resample_column} {
+#ifdef SDL_SSE4_1_INTRINSICS
+		if (SDL_HasSSE41()) {
+			row = resample_row_sse41;
+			column = resample_column_sse41;
+		}
+#endif
+#ifdef SDL_AVX2_INTRINSICS
+		if (SDL_HasAVX2()) {
+			row = resample_row_avx2;
+			column = resample_column_avx2;
+		}
+#endif
+	}
+};
+
+}  // namespace
+
+/*
+Compute a band of output rows. Each source row is resampled horizontally once,
+into a ring buffer holding the rows needed for the current output row, which
+stays in the cache while the rows are combined vertically.
+
+@param first The first output row of the band.
+@param end The output row after the band.
+*/
+static void resample_band(const SDL_Surface* source, SDL_Surface* destination,
+						  const Kernel& horizontal, const Kernel& vertical,
+						  int first, int end) {
+	static const ResampleFunctions functions;
+	const int taps = vertical.taps;
+	const std::size_t pitch = static_cast<std::size_t>(destination->w) * 4;
+	std::vector<Uint8> ring(pitch * taps);
+	std::vector<const Uint8*> rows(taps);
+	int next = 0;  // The first source row not resampled yet.
+	for (int y = first; y < end; y++) {
+		// Source rows are only overwritten once no later output row needs
+		// them, since the first row of each output row never decreases.
+		const int start = vertical.starts[y];
+		for (int row = std::max(next, start); row < start + taps; row++) {
+			functions.row(static_cast<const Uint8*>(source->pixels) +
+							  static_cast<std::size_t>(row) * source->pitch,
+						  ring.data() + (row % taps) * pitch, horizontal);
+		}
+		next = std::max(next, start + taps);
+
+		for (int t = 0; t < taps; t++) {
+			rows[t] = ring.data() + ((start + t) % taps) * pitch;
+		}
+		functions.column(
+			rows.data(),
+			&vertical.weights[static_cast<std::size_t>(y) * taps], taps,
+			static_cast<Uint8*>(destination->pixels) +
+				static_cast<std::size_t>(y) * destination->pitch,
+			pitch);
+	}
+}
+
+bool resample(const SDL_Surface* source, const SDL_FRect* area,
+			  SDL_Surface* destination, ResampleFilter filter,
+			  TaskPool* pool) {
+	ProfileScope profile(PROFILE_STAGE_RESAMPLE);
+	const SDL_PixelFormatDetails* details =
+		SDL_GetPixelFormatDetails(source->format);
+	if (details == nullptr) {
+		return false;
+	}
+	if (!SDL_ISPIXELFORMAT_PACKED(source->format) ||
+		details->bits_per_pixel != 32 || details->Rbits != 8 ||
+		details->Gbits != 8 || details->Bbits != 8) {
+		return SDL_SetError("Unsupported pixel format %s for resampling",
+							SDL_GetPixelFormatName(source->format));
+	}
+	if (destination->format != source->format) {
+		return SDL_SetError("Cannot resample from %s to %s",
+							SDL_GetPixelFormatName(source->format),
+							SDL_GetPixelFormatName(destination->format));
+	}
+	if (source->w <= 0 || source->h <= 0 || destination->w <= 0 ||
+		destination->h <= 0) {
+		return true;
+	}
+
+	const SDL_FRect whole{0, 0, static_cast<float>(source->w),
+						  static_cast<float>(source->h)};
+	if (area == nullptr) {
+		area = &whole;
+	}
+	const Kernel horizontal = make_kernel(source->w, area->x, area->w,
+										  destination->w, filter);
+	const Kernel vertical = make_kernel(source->h, area->y, area->h,
+										destination->h, filter);
+
+	// Split the output into bands of equal height, one per thread of the pool.
+	const unsigned int threads = pool != nullptr ? pool->concurrency() : 1;
+	const int bands = static_cast<int>(std::clamp(
+		threads, 1u,
+		static_cast<unsigned int>(std::max(destination->h / MIN_BAND_ROWS,
+										   1))));
+	auto band_start = [&](std::size_t band) {
+		return static_cast<int>(static_cast<Sint64>(destination->h) *
+								static_cast<Sint64>(band) / bands);
+	};
+	auto run_band = [&](std::size_t band) {
+		resample_band(source, destination, horizontal, vertical,
+					  band_start(band), band_start(band + 1));
+	};
+	if (pool != nullptr) {
+		pool->run(bands, run_band);
+	} else {
+		run_band(0);
+	}
+	return true;
+}
+
+std::size_t resample_memory(int source_width, int source_height, int width,
+							int height, ResampleFilter filter) {
+	const auto horizontal = static_cast<std::size_t>(
+		kernel_taps(source_width, source_width, width, filter));
+	const auto vertical = static_cast<std::size_t>(
+		kernel_taps(source_height, source_height, height, filter));
+	const auto columns = static_cast<std::size_t>(width);
+	const auto rows = static_cast<std::size_t>(height);
+	const std::size_t kernels =
+		(columns + rows) * sizeof(int) +
+		(columns * horizontal + rows * vertical) * sizeof(Sint16) +
+		std::max(horizontal, vertical) * sizeof(double);
+	return kernels + vertical * (columns * 4 + sizeof(const Uint8*));
+}
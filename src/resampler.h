@@ -0,0 +1,57 @@
+#ifndef SRC_RESAMPLER_H_
+#define SRC_RESAMPLER_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+
+#include "task_pool.h"
+
+// Filters used for resampling, from the softest to the sharpest.
+enum ResampleFilter {
+	// Averages the pixels covered by each output pixel. The fastest filter
+	// without aliasing when scaling down, which makes it suited to thumbnails,
+	// but it picks the nearest pixel when scaling up.
+	RESAMPLE_FILTER_AREA,
+	// Catmull-Rom cubic, with a support of 2 pixels.
+	RESAMPLE_FILTER_BICUBIC,
+	// Windowed sinc with 3 lobes, the sharpest of the filters.
+	RESAMPLE_FILTER_LANCZOS3
+};
+
+/*
+Scale part of an image into another surface with a separable filter.
+
+Each output row is computed from a horizontally resampled copy of the source
+rows it needs, using tables of 14-bit fixed-point weights computed once per
+call. The destination is split into bands of rows run as tasks of a pool, and
+SSE4.1 or AVX2 versions of the inner loops are used if the CPU supports them.
+
+Channels are filtered independently, without premultiplying the color by
+the alpha channel.
+
+@param source The image to scale.
+@param area The part of `source` to scale, in pixels, or `nullptr` for the
+whole image. Fractional coordinates are allowed, pixels of `source` outside of
+it contribute to the edges of the output as usual.
+@param destination Receives the scaled image, covering the whole surface.
+This may be a surface locked with `SDL_LockTextureToSurface()`.
+@param pool Runs the bands in parallel, or `nullptr` to only use the calling
+thread.
+
+@return `false` if the surfaces do not share a packed 32-bit pixel format with
+8 bits per channel, in which case `SDL_GetError()` describes the error.
+*/
+bool resample(const SDL_Surface* source, const SDL_FRect* area,
+			  SDL_Surface* destination, ResampleFilter filter,
+			  TaskPool* pool = nullptr);
+
+/*
+The most memory `resample()` allocates to scale a whole image without a pool:
+the weights of both axes and the horizontally resampled rows. Every band run
+on a pool needs another copy of the rows.
+*/
+std::size_t resample_memory(int source_width, int source_height, int width,
+							int height, ResampleFilter filter);
+
+#endif	// SRC_RESAMPLER_H_
@@ -0,0 +1,119 @@
+#ifndef SRC_RING_QUEUE_H_
+#define SRC_RING_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/*
+Bounded lock-free queue which may be shared by any number of producers and
+consumers.
+
+Every cell carries a sequence number which tells producers and consumers whose
+turn it is to use the cell, so a push or pop only needs a single
+compare-and-swap on the shared position counters (this is Dmitry Vyukov's
+bounded MPMC queue). `T` must be default constructible and movable.
+*/
+template <typename T>
+class RingQueue {
+   private:
+	// Keep the two counters on separate cache lines so that producers and
+	// consumers do not invalidate each other's cache lines all the time.
+	static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+	struct Cell {
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	std::size_t mask;
+	alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> push_position;
+	alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> pop_position;
+
+   public:
+	/*
+	Create an empty queue.
+
+	@param capacity The smallest number of elements the queue must be able to
+	hold, it is rounded up to the nearest power of two.
+	*/
+	explicit RingQueue(std::size_t capacity)
+		: mask{}, push_position{0}, pop_position{0} {
+		std::size_t size = 2;
+		while (size < capacity) {
+			size *= 2;
+		}
+		mask = size - 1;
+		cells = std::make_unique<Cell[]>(size);
+		for (std::size_t i = 0; i < size; i++) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	RingQueue(const RingQueue&) = delete;
+	RingQueue& operator=(const RingQueue&) = delete;
+
+	/*
+	Try to append an element to the queue.
+
+	@return `true` if `value` was moved into the queue, `false` if the queue is
+	full (in which case `value` is left untouched).
+	*/
+	bool try_push(T& value) {
+		std::size_t position = push_position.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells[position & mask];
+			std::size_t sequence =
+				cell.sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<std::ptrdiff_t>(sequence) -
+							  static_cast<std::ptrdiff_t>(position);
+			if (difference == 0) {
+				if (push_position.compare_exchange_weak(
+						position, position + 1, std::memory_order_relaxed)) {
+					cell.value = std::move(value);
+					cell.sequence.store(position + 1,
+										std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = push_position.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/*
+	Try to remove the oldest element from the queue.
+
+	@return `true` if an element was moved into `value`, `false` if the queue
+	is empty.
+	*/
+	bool try_pop(T& value) {
+		std::size_t position = pop_position.load(std::memory_order_relaxed);
+		for (;;) {
+			Cell& cell = cells[position & mask];
+			std::size_t sequence =
+				cell.sequence.load(std::memory_order_acquire);
+			auto difference = static_cast<std::ptrdiff_t>(sequence) -
+							  static_cast<std::ptrdiff_t>(position + 1);
+			if (difference == 0) {
+				if (pop_position.compare_exchange_weak(
+						position, position + 1, std::memory_order_relaxed)) {
+					value = std::move(cell.value);
+					cell.sequence.store(position + mask + 1,
+										std::memory_order_release);
+					return true;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = pop_position.load(std::memory_order_relaxed);
+			}
+		}
+	}
+};
+
+#endif	// SRC_RING_QUEUE_H_
@@ -0,0 +1,117 @@
+#include "task_pool.h"
+
+TaskPool::TaskPool(unsigned int thread_count) : queued{0}, stopping{false} {
+	queues.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+	workers.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		workers.emplace_back(&TaskPool::work, this, i);
+	}
+}
+
+/*
+Take a task, from the back of the queue of a worker if it has any, otherwise
+from the front of the next queue that does.
+
+@param worker The worker taking the task, or the number of workers for a thread
+that only steals.
+@return `false` if every queue is empty.
+*/
+bool TaskPool::take(std::size_t worker, Task& task) {
+	for (std::size_t i = 0; i < queues.size(); i++) {
+		const std::size_t index = (worker + i) % queues.size();
+		Queue& queue = *queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty()) {
+			continue;
+		}
+		if (index == worker) {
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+		} else {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+		}
+		queued.fetch_sub(1);
+		return true;
+	}
+	return false;
+}
+
+// Run a task, and wake up the thread waiting for its batch if it was the last.
+void TaskPool::finish(const Task& task) {
+	(*task.batch->task)(task.index);
+	if (task.batch->remaining.fetch_sub(1) == 1) {
+		// Taking the lock makes sure the waiting thread is either not checking
+		// `remaining` yet or already waiting, so the notification is not lost.
+		std::lock_guard<std::mutex> lock(mutex);
+		batch_finished.notify_all();
+	}
+}
+
+void TaskPool::work(std::size_t worker) {
+	for (;;) {
+		Task task;
+		if (take(worker, task)) {
+			finish(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		work_available.wait(lock,
+							[this] { return stopping || queued.load() > 0; });
+		if (stopping) {
+			return;
+		}
+	}
+}
+
+void TaskPool::run(std::size_t count,
+				   const std::function<void(std::size_t)>& task) {
+	if (count == 0) {
+		return;
+	}
+	if (queues.empty() || count == 1) {
+		for (std::size_t i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	Batch batch;
+	batch.task = &task;
+	batch.remaining.store(count);
+	for (std::size_t i = 0; i < queues.size(); i++) {
+		Queue& queue = *queues[i];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (std::size_t index = i; index < count; index += queues.size()) {
+			queue.tasks.push_back(Task{&batch, index});
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.fetch_add(count);
+	}
+	work_available.notify_all();
+
+	// Help until nothing is left to take, then wait for the tasks still
+	// running on the workers. Tasks of other batches may be taken as well.
+	Task stolen;
+	while (batch.remaining.load() > 0 && take(queues.size(), stolen)) {
+		finish(stolen);
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	batch_finished.wait(lock, [&batch] { return batch.remaining.load() == 0; });
+}
+
+TaskPool::~TaskPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
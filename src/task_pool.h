@@ -0,0 +1,83 @@
+#ifndef SRC_TASK_POOL_H_
+#define SRC_TASK_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+A pool of worker threads running batches of small tasks, such as the blocks of
+an image being processed.
+
+Every worker has its own queue. The tasks of a batch are dealt out to the
+queues in turn, each worker takes tasks from the back of its own queue, and a
+worker whose queue is empty steals from the front of the others, so that
+batches of uneven tasks keep every worker busy without them all contending for
+a single queue. The thread starting a batch steals tasks as well until the
+batch has finished.
+*/
+class TaskPool {
+   private:
+	// A call to `run()`, shared by its tasks.
+	struct Batch {
+		const std::function<void(std::size_t)>* task;
+		std::atomic<std::size_t> remaining;
+	};
+
+	struct Task {
+		Batch* batch;
+		std::size_t index;
+	};
+
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;	 // One per worker.
+	std::vector<std::thread> workers;
+	std::atomic<std::size_t> queued;  // Tasks in all queues.
+	std::mutex mutex;  // Guards `stopping` and the condition variables.
+	std::condition_variable work_available;
+	std::condition_variable batch_finished;
+	bool stopping;
+
+	bool take(std::size_t worker, Task& task);
+	void finish(const Task& task);
+	void work(std::size_t worker);
+
+   public:
+	/*
+	Start the worker threads.
+
+	@param thread_count The number of worker threads. With 0, every batch is
+	run by the thread calling `run()`.
+	*/
+	explicit TaskPool(unsigned int thread_count);
+
+	TaskPool(const TaskPool&) = delete;
+	TaskPool& operator=(const TaskPool&) = delete;
+
+	// The number of threads that may run tasks, counting the caller of `run()`.
+	unsigned int concurrency() const {
+		return static_cast<unsigned int>(workers.size()) + 1;
+	}
+
+	/*
+	Call `task(i)` for every `i` from 0 to `count - 1`, in parallel and in no
+	particular order, and wait for all calls to return. May be called from
+	several threads at once, but not from within a task.
+	*/
+	void run(std::size_t count, const std::function<void(std::size_t)>& task);
+
+	// Wait for the worker threads to exit.
+	~TaskPool();
+};
+
+#endif	// SRC_TASK_POOL_H_
@@ -0,0 +1,115 @@
+#include "thumbnail_atlas.h"
+
+#include <utility>
+
+#include "profiler.h"
+
+ThumbnailAtlas::ThumbnailAtlas(SDL_Renderer* renderer, int max_pages)
+	: renderer{renderer}, max_pages{max_pages}, frame{0} {}
+
+void ThumbnailAtlas::begin_frame() { frame++; }
+
+bool ThumbnailAtlas::find(std::size_t key, AtlasEntry& entry) {
+	auto it = index.find(key);
+	if (it == index.end()) {
+		return false;
+	}
+	slots.splice(slots.begin(), slots, it->second);
+	Slot& slot = *it->second;
+	slot.frame = frame;
+
+	// Keep half a pixel away from the edges, so that bilinear filtering does
+	// not pick up the neighbouring slots.
+	const auto page_size = static_cast<float>(PAGE_SIZE);
+	entry.texture = pages[slot.page];
+	entry.uv_min = SDL_FPoint{(static_cast<float>(slot.x) + 0.5f) / page_size,
+							  (static_cast<float>(slot.y) + 0.5f) / page_size};
+	entry.uv_max = SDL_FPoint{
+		(static_cast<float>(slot.x + slot.width) - 0.5f) / page_size,
+		(static_cast<float>(slot.y + slot.height) - 0.5f) / page_size};
+	entry.width = slot.width;
+	entry.height = slot.height;
+	return true;
+}
+
+/*
+Find room for a thumbnail: a free slot, a slot of a new page, or the slot of
+the least recently used thumbnail.
+*/
+bool ThumbnailAtlas::take_slot(SDL_PixelFormat format, Slot& slot) {
+	if (free_slots.empty() && static_cast<int>(pages.size()) < max_pages) {
+		SDL_Texture* page =
+			SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC,
+							  PAGE_SIZE, PAGE_SIZE);
+		if (page == nullptr) {
+			return false;
+		}
+		SDL_SetTextureBlendMode(page, SDL_BLENDMODE_BLEND);
+		const int number = static_cast<int>(pages.size());
+		pages.push_back(page);
+		// Add the slots in reverse so that they are taken in order.
+		for (int y = PAGE_SIZE - SLOT_SIZE; y >= 0; y -= SLOT_SIZE) {
+			for (int x = PAGE_SIZE - SLOT_SIZE; x >= 0; x -= SLOT_SIZE) {
+				free_slots.push_back(Slot{0, number, x, y, 0, 0, 0});
+			}
+		}
+	}
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+		return true;
+	}
+	if (slots.empty() || slots.back().frame == frame) {
+		return SDL_SetError("All thumbnails are in use");
+	}
+	slot = slots.back();
+	index.erase(slot.key);
+	slots.pop_back();
+	return true;
+}
+
+bool ThumbnailAtlas::insert(std::size_t key, const SDL_Surface* thumbnail) {
+	ProfileScope profile(PROFILE_STAGE_UPLOAD);
+	if (thumbnail->w > SLOT_SIZE || thumbnail->h > SLOT_SIZE) {
+		return SDL_SetError("Thumbnail of %dx%d does not fit in the atlas",
+							thumbnail->w, thumbnail->h);
+	}
+	auto existing = index.find(key);
+	if (existing != index.end()) {
+		free_slots.push_back(*existing->second);
+		slots.erase(existing->second);
+		index.erase(existing);
+	}
+
+	Slot slot{};
+	if (!take_slot(thumbnail->format, slot)) {
+		return false;
+	}
+	const SDL_Rect rect{slot.x, slot.y, thumbnail->w, thumbnail->h};
+	if (!SDL_UpdateTexture(pages[slot.page], &rect, thumbnail->pixels,
+						   thumbnail->pitch)) {
+		free_slots.push_back(slot);
+		return false;
+	}
+	slot.key = key;
+	slot.width = thumbnail->w;
+	slot.height = thumbnail->h;
+	slot.frame = frame;
+	slots.push_front(slot);
+	index.emplace(key, slots.begin());
+	return true;
+}
+
+void ThumbnailAtlas::clear() {
+	for (const Slot& slot : slots) {
+		free_slots.push_back(slot);
+	}
+	slots.clear();
+	index.clear();
+}
+
+ThumbnailAtlas::~ThumbnailAtlas() {
+	for (SDL_Texture* page : pages) {
+		SDL_DestroyTexture(page);
+	}
+}
@@ -0,0 +1,110 @@
+#ifndef SRC_THUMBNAIL_ATLAS_H_
+#define SRC_THUMBNAIL_ATLAS_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+// Where a thumbnail is in the atlas.
+struct AtlasEntry {
+	SDL_Texture* texture = nullptr;
+	SDL_FPoint uv_min{};  // Texture coordinates of the thumbnail.
+	SDL_FPoint uv_max{};
+	int width = 0;	// The size of the thumbnail, in pixels.
+	int height = 0;
+};
+
+/*
+Thumbnails packed into a few large textures, so that a grid of thumbnails
+draws from a handful of textures instead of creating one per image.
+
+Every page texture is divided into square slots of `SLOT_SIZE` pixels, each
+holding one thumbnail of up to that size. Pages are created as they are
+needed, up to a fixed number, after which the least recently drawn thumbnails
+are evicted to make room for new ones.
+
+Like `TileCache`, thumbnails used during a frame are never evicted before the
+next call to `begin_frame()`, since ImGui only draws them when the frame is
+rendered.
+
+All member functions must be called from the thread owning the renderer.
+*/
+class ThumbnailAtlas {
+   private:
+	struct Slot {
+		std::size_t key;
+		int page;
+		int x;	// Position of the slot in the page, in pixels.
+		int y;
+		int width;	// The size of the thumbnail in the slot.
+		int height;
+		std::uint64_t frame;  // The frame the thumbnail was last used in.
+	};
+
+	SDL_Renderer* renderer;
+	int max_pages;
+	std::vector<SDL_Texture*> pages;
+	std::list<Slot> slots;	// Slots holding thumbnails, most recently used
+							// first.
+	std::unordered_map<std::size_t, std::list<Slot>::iterator> index;
+	std::vector<Slot> free_slots;
+	std::uint64_t frame;
+
+	bool take_slot(SDL_PixelFormat format, Slot& slot);
+
+   public:
+	// Width and height of page textures and of the slots in them, in pixels.
+	static constexpr int PAGE_SIZE = 2048;
+	static constexpr int SLOT_SIZE = 256;
+
+	// Default number of pages, enough for the visible cells of a large screen.
+	// Each page uses 16 MB of texture memory.
+	static constexpr int DEFAULT_MAX_PAGES = 8;
+
+	/*
+	Create an empty atlas.
+
+	@param renderer The renderer used to create textures, which must outlive
+	the atlas.
+	@param max_pages The largest number of page textures, each holding
+	`(PAGE_SIZE / SLOT_SIZE)^2` thumbnails.
+	*/
+	explicit ThumbnailAtlas(SDL_Renderer* renderer,
+							int max_pages = DEFAULT_MAX_PAGES);
+
+	ThumbnailAtlas(const ThumbnailAtlas&) = delete;
+	ThumbnailAtlas& operator=(const ThumbnailAtlas&) = delete;
+
+	// Start a new frame, which must happen before drawing anything.
+	void begin_frame();
+
+	/*
+	Find a thumbnail and mark it as used in this frame.
+
+	@param key Identifies the thumbnail.
+	@return `false` if the atlas does not hold the thumbnail.
+	*/
+	bool find(std::size_t key, AtlasEntry& entry);
+
+	/*
+	Upload a thumbnail, evicting the least recently used one if the atlas is
+	full.
+
+	@param thumbnail The thumbnail, at most `SLOT_SIZE` pixels wide and high.
+	All thumbnails must share the same pixel format.
+	@return `false` if every slot is in use during this frame, or uploading
+	failed, in which case `SDL_GetError()` describes the error.
+	*/
+	bool insert(std::size_t key, const SDL_Surface* thumbnail);
+
+	// Drop all thumbnails, keeping the page textures for reuse.
+	void clear();
+
+	~ThumbnailAtlas();
+};
+
+#endif	// SRC_THUMBNAIL_ATLAS_H_
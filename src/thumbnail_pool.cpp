@@ -0,0 +1,165 @@
+#include "thumbnail_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "image_loader.h"
+#include "profiler.h"
+
+// Number of finished jobs that may wait for the main thread at once. Workers
+// back off if the main thread falls this far behind.
+static const std::size_t FINISHED_CAPACITY = 256;
+
+// Size of the thumbnail store, which holds around 15000 thumbnails of photos.
+static const std::size_t STORE_CAPACITY = std::size_t{256} << 20;
+
+ThumbnailPool::ThumbnailPool(unsigned int thread_count, int size,
+							 SDL_PixelFormat format, std::string directory,
+							 std::function<void()> wake)
+	: next_id{1},
+	  stopping{false},
+	  finished(FINISHED_CAPACITY),
+	  store(std::move(directory)),
+	  size{size},
+	  format{format},
+	  wake(std::move(wake)) {
+	thread_count = std::max(thread_count, 1u);
+	workers.reserve(thread_count);
+	for (unsigned int i = 0; i < thread_count; i++) {
+		workers.emplace_back(&ThumbnailPool::work, this, i == 0);
+	}
+}
+
+std::uint64_t ThumbnailPool::submit(const std::string& path) {
+	auto job = std::make_shared<Job>();
+	job->path = path;
+	job->cancelled.store(false);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		job->id = next_id++;
+		jobs.emplace(job->id, job);
+		pending.push_back(job);
+	}
+	work_available.notify_one();
+	return job->id;
+}
+
+void ThumbnailPool::cancel(std::uint64_t job) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = jobs.find(job);
+	if (it != jobs.end()) {
+		// The job stays in `pending` until a worker gets to it and skips it.
+		it->second->cancelled.store(true);
+		jobs.erase(it);
+	}
+}
+
+void ThumbnailPool::cancel_all() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& [id, job] : jobs) {
+		job->cancelled.store(true);
+	}
+	jobs.clear();
+	pending.clear();
+}
+
+bool ThumbnailPool::poll(ThumbnailResult& result) {
+	return finished.try_pop(result);
+}
+
+// Make thumbnails until the pool is destroyed, after trimming the store if
+// `prune` is set.
+void ThumbnailPool::work(bool prune) {
+	if (prune) {
+		store.prune(STORE_CAPACITY);
+	}
+	for (;;) {
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (job == nullptr) {
+				work_available.wait(
+					lock, [this] { return stopping || !pending.empty(); });
+				if (stopping) {
+					return;
+				}
+				job = std::move(pending.back());
+				pending.pop_back();
+				if (job->cancelled.load()) {
+					job.reset();
+				}
+			}
+		}
+
+		ThumbnailResult result;
+		result.job = job->id;
+		make_thumbnail(*job, result);
+		deliver(*job, result);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.erase(job->id);
+	}
+}
+
+// Find the thumbnail of an image in the store, or make and store it.
+void ThumbnailPool::make_thumbnail(const Job& job, ThumbnailResult& result) {
+	ProfileScope profile(PROFILE_STAGE_DECODE);
+	SDL_PathInfo info;
+	if (!SDL_GetPathInfo(job.path.c_str(), &info)) {
+		result.error = SDL_GetError();
+		return;
+	}
+	SDL_Surface* thumbnail = store.load(job.path, info, size, format);
+	if (thumbnail == nullptr && !job.cancelled.load()) {
+		thumbnail = load_thumbnail(job.path.c_str(), size, format);
+		if (thumbnail == nullptr) {
+			result.error = SDL_GetError();
+			return;
+		}
+		if (!store.save(job.path, info, size, thumbnail)) {
+			SDL_Log("Failed to store the thumbnail of '%s': %s",
+					job.path.c_str(), SDL_GetError());
+		}
+	}
+	result.thumbnail.reset(thumbnail, SDL_DestroySurface);
+}
+
+/*
+Hand a result over to the main thread unless nobody wants it anymore, backing
+off while the queue is full.
+
+@return `true` if the result was delivered.
+*/
+bool ThumbnailPool::deliver(const Job& job, ThumbnailResult& result) {
+	while (!job.cancelled.load()) {
+		if (finished.try_push(result)) {
+			if (wake) {
+				wake();
+			}
+			return true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping) {
+				return false;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+ThumbnailPool::~ThumbnailPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		for (auto& [id, job] : jobs) {
+			job->cancelled.store(true);
+		}
+	}
+	work_available.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
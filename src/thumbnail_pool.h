@@ -0,0 +1,114 @@
+#ifndef SRC_THUMBNAIL_POOL_H_
+#define SRC_THUMBNAIL_POOL_H_
+
+#include <SDL3/SDL.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ring_queue.h"
+#include "thumbnail_store.h"
+
+// A finished thumbnail job.
+struct ThumbnailResult {
+	std::uint64_t job = 0;	// Identifier returned by `ThumbnailPool::submit()`.
+	std::shared_ptr<SDL_Surface> thumbnail;	 // `nullptr` if the image could
+											 // not be decoded.
+	std::string error;	// Describes why decoding failed, if it did.
+};
+
+/*
+A pool of worker threads making thumbnails of image files in the background.
+
+Thumbnails are looked up in a `ThumbnailStore` first, and only images without
+a stored thumbnail are decoded, with `load_thumbnail()`, after which their
+thumbnail is stored for the next time.
+
+Pending jobs are started in the reverse order of their submission, since the
+most recently requested thumbnails are the ones most likely to still be
+visible while the user scrolls through a long list. Jobs may be submitted and
+cancelled from any thread, but finished jobs should only be collected by a
+single thread (the main thread) using `poll()`.
+*/
+class ThumbnailPool {
+   private:
+	struct Job {
+		std::uint64_t id;
+		std::string path;
+		std::atomic<bool> cancelled;  // May be read without `mutex`.
+	};
+
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::vector<std::shared_ptr<Job>> pending;	// Started from the back.
+	std::unordered_map<std::uint64_t, std::shared_ptr<Job>>
+		jobs;  // Jobs that are either pending or running.
+	std::uint64_t next_id;
+	bool stopping;
+	std::vector<std::thread> workers;
+	RingQueue<ThumbnailResult> finished;
+	ThumbnailStore store;
+	int size;
+	SDL_PixelFormat format;
+	std::function<void()> wake;
+
+	void work(bool prune);
+	void make_thumbnail(const Job& job, ThumbnailResult& result);
+	bool deliver(const Job& job, ThumbnailResult& result);
+
+   public:
+	/*
+	Start the worker threads.
+
+	@param thread_count The number of worker threads, at least one thread is
+	always started.
+	@param size The largest width and height of thumbnails, in pixels.
+	@param format The pixel format of thumbnails, see `load_thumbnail()`.
+	@param directory The directory of the `ThumbnailStore`, or an empty string
+	to always decode the images.
+	@param wake Called from a worker thread whenever a result is ready to be
+	polled, e.g. to wake up an event loop waiting for input. May be empty.
+	*/
+	ThumbnailPool(unsigned int thread_count, int size, SDL_PixelFormat format,
+				  std::string directory, std::function<void()> wake = nullptr);
+
+	ThumbnailPool(const ThumbnailPool&) = delete;
+	ThumbnailPool& operator=(const ThumbnailPool&) = delete;
+
+	/*
+	Queue an image file for making its thumbnail.
+
+	@return An identifier for the job, which is never 0.
+	*/
+	std::uint64_t submit(const std::string& path);
+
+	/*
+	Cancel a job. A pending job is never started, and a running job returns no
+	result.
+	*/
+	void cancel(std::uint64_t job);
+
+	// Cancel all pending and running jobs.
+	void cancel_all();
+
+	/*
+	Collect a finished job without blocking.
+
+	@return `true` if `result` was filled in, `false` if no job has finished
+	since the last call.
+	*/
+	bool poll(ThumbnailResult& result);
+
+	// Cancel all jobs and wait for the worker threads to exit.
+	~ThumbnailPool();
+};
+
+#endif	// SRC_THUMBNAIL_POOL_H_
@@ -0,0 +1,320 @@
+#include "thumbnail_store.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "jpeg_decoder.h"
+#include "jpeg_encoder.h"
+#include "pixel_packing.h"
+#include "png_decoder.h"
+#include "png_encoder.h"
+
+#if defined(SDL_PLATFORM_WINDOWS)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(SDL_PLATFORM_UNIX) || defined(SDL_PLATFORM_APPLE)
+#define THUMBNAIL_STORE_POSIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+/*
+Layout of a thumbnail file, with integers in little-endian order:
+
+- The magic number `MAGIC`, whose last byte is the version of the layout.
+- The largest width and height of the thumbnail (32 bits).
+- The size of the image file (64 bits).
+- The modification time of the image file (64 bits, see `SDL_Time`).
+- The length of the path of the image file (32 bits), followed by the path.
+- The thumbnail, as a complete JPEG or PNG file.
+*/
+static const Uint8 MAGIC[4] = {'T', 'H', 'M', 1};
+
+// Quality of JPEG thumbnails, see `encode_jpeg()`.
+static const int JPEG_QUALITY = 85;
+
+// Temporary files older than this are left over from a writer which did not
+// finish, rather than being written right now, and are removed by `prune()`.
+static const SDL_Time STALE_TEMPORARY_AGE = SDL_SECONDS_TO_NS(60 * 60);
+
+ThumbnailStore::ThumbnailStore(std::string directory)
+	: directory{std::move(directory)} {
+	if (!this->directory.empty() &&
+		!SDL_CreateDirectory(this->directory.c_str())) {
+		SDL_Log("Thumbnails will not be saved: %s", SDL_GetError());
+		this->directory.clear();
+	}
+}
+
+std::string ThumbnailStore::default_directory() {
+	char* preferences = SDL_GetPrefPath("dd1367", "Image Viewer");
+	if (preferences == nullptr) {
+		SDL_Log("Thumbnails will not be saved: %s", SDL_GetError());
+		return std::string();
+	}
+	std::string directory = std::string(preferences) + "thumbnails";
+	directory += preferences[std::strlen(preferences) - 1];	 // Separator.
+	SDL_free(preferences);
+	return directory;
+}
+
+// 64-bit FNV-1a hash.
+static std::uint64_t hash_bytes(std::uint64_t hash, const void* data,
+								std::size_t size) {
+	const auto* bytes = static_cast<const Uint8*>(data);
+	for (std::size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3u;
+	}
+	return hash;
+}
+
+std::string ThumbnailStore::file_path(const std::string& path,
+									  int size) const {
+	std::uint64_t hash = 0xcbf29ce484222325u;
+	hash = hash_bytes(hash, path.data(), path.size());
+	hash = hash_bytes(hash, &size, sizeof(size));
+	char name[32];
+	SDL_snprintf(name, sizeof(name), "%016" SDL_PRIx64 ".thumb", hash);
+	return directory + name;
+}
+
+/*
+Set the modification time of a file to the current time, so that pruning the
+store keeps the thumbnails used recently. Does nothing on platforms without a
+way to do so.
+*/
+static void touch(const std::string& path) {
+#if defined(SDL_PLATFORM_WINDOWS)
+	int wide_size =
+		MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (wide_size <= 0) {
+		return;
+	}
+	std::wstring wide_path(static_cast<std::size_t>(wide_size), L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide_path.data(),
+						wide_size);
+	HANDLE file = CreateFileW(wide_path.c_str(), FILE_WRITE_ATTRIBUTES,
+							  FILE_SHARE_READ | FILE_SHARE_WRITE |
+								  FILE_SHARE_DELETE,
+							  nullptr, OPEN_EXISTING, 0, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		SetFileTime(file, nullptr, nullptr, &now);
+		CloseHandle(file);
+	}
+#elif defined(THUMBNAIL_STORE_POSIX)
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+#else
+	(void)path;
+#endif
+}
+
+SDL_Surface* ThumbnailStore::load(const std::string& path,
+								  const SDL_PathInfo& info, int size,
+								  SDL_PixelFormat format) const {
+	if (directory.empty()) {
+		return nullptr;
+	}
+	const std::string stored_path = file_path(path, size);
+	std::size_t length = 0;
+	void* data = SDL_LoadFile(stored_path.c_str(), &length);
+	if (data == nullptr) {
+		return nullptr;
+	}
+
+	// Check that the file belongs to the image, in its current version.
+	SDL_IOStream* stream = SDL_IOFromConstMem(data, length);
+	Uint8 magic[sizeof(MAGIC)] = {};
+	Uint32 stored_size = 0;
+	Uint64 file_size = 0;
+	Sint64 modify_time = 0;
+	Uint32 path_length = 0;
+	bool valid = stream != nullptr &&
+				 SDL_ReadIO(stream, magic, sizeof(magic)) == sizeof(magic) &&
+				 std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 &&
+				 SDL_ReadU32LE(stream, &stored_size) &&
+				 SDL_ReadU64LE(stream, &file_size) &&
+				 SDL_ReadS64LE(stream, &modify_time) &&
+				 SDL_ReadU32LE(stream, &path_length) &&
+				 stored_size == static_cast<Uint32>(size) &&
+				 file_size == info.size && modify_time == info.modify_time &&
+				 path_length == path.size();
+	std::size_t offset = 0;
+	if (valid) {
+		offset = static_cast<std::size_t>(SDL_TellIO(stream));
+		valid = length - offset >= path_length &&
+				std::memcmp(static_cast<const Uint8*>(data) + offset,
+							path.data(), path_length) == 0;
+		offset += path_length;
+	}
+	SDL_CloseIO(stream);
+
+	SDL_Surface* thumbnail = nullptr;
+	const Uint8* image = static_cast<const Uint8*>(data) + offset;
+	const std::size_t image_size = length - offset;
+	if (valid && is_png(image, image_size)) {
+		thumbnail = decode_png(image, image_size, format);
+	} else if (valid && is_jpeg(image, image_size)) {
+		DecodeOutput output;
+		output.create = [&thumbnail, format](int width, int height) {
+			thumbnail = SDL_CreateSurface(width, height, format);
+			return thumbnail;
+		};
+		if (!decode_jpeg(image, image_size, format, output)) {
+			SDL_DestroySurface(thumbnail);
+			thumbnail = nullptr;
+		}
+	}
+	SDL_free(data);
+	if (thumbnail != nullptr) {
+		touch(stored_path);
+	}
+	return thumbnail;
+}
+
+namespace {
+
+// A file found while pruning the store.
+struct StoredThumbnail {
+	std::string path;
+	Uint64 size;
+	SDL_Time modify_time;  // When the thumbnail was last used.
+	bool temporary;		   // Whether the file is still being written, or was
+						   // left behind by a writer which did not finish.
+};
+
+}  // namespace
+
+// Whether a file name ends with an extension.
+static bool has_extension(const char* name, const char* extension) {
+	const std::size_t length = SDL_strlen(name);
+	const std::size_t extension_length = SDL_strlen(extension);
+	return length > extension_length &&
+		   SDL_strcmp(name + length - extension_length, extension) == 0;
+}
+
+static SDL_EnumerationResult SDLCALL add_thumbnail(void* userdata,
+												   const char* directory,
+												   const char* name) {
+	const bool temporary = has_extension(name, ".tmp");
+	SDL_PathInfo info;
+	if (temporary || has_extension(name, ".thumb")) {
+		std::string path = std::string(directory) + name;
+		if (SDL_GetPathInfo(path.c_str(), &info) &&
+			info.type == SDL_PATHTYPE_FILE) {
+			static_cast<std::vector<StoredThumbnail>*>(userdata)->push_back(
+				{std::move(path), info.size, info.modify_time, temporary});
+		}
+	}
+	return SDL_ENUM_CONTINUE;
+}
+
+void ThumbnailStore::prune(std::size_t capacity) const {
+	if (directory.empty()) {
+		return;
+	}
+	std::vector<StoredThumbnail> thumbnails;
+	if (!SDL_EnumerateDirectory(directory.c_str(), add_thumbnail,
+								&thumbnails)) {
+		SDL_Log("Failed to prune thumbnails: %s", SDL_GetError());
+		return;
+	}
+	SDL_Time now = 0;
+	SDL_GetCurrentTime(&now);
+	Uint64 total = 0;
+	std::size_t removed = 0;
+	for (const StoredThumbnail& thumbnail : thumbnails) {
+		if (thumbnail.temporary &&
+			now - thumbnail.modify_time > STALE_TEMPORARY_AGE &&
+			SDL_RemovePath(thumbnail.path.c_str())) {
+			removed++;
+		} else {
+			total += thumbnail.size;
+		}
+	}
+
+	// Remove the thumbnails used longest ago. Temporary files still being
+	// written count towards the capacity but are left alone.
+	thumbnails.erase(std::remove_if(thumbnails.begin(), thumbnails.end(),
+									[](const StoredThumbnail& thumbnail) {
+										return thumbnail.temporary;
+									}),
+					 thumbnails.end());
+	std::sort(thumbnails.begin(), thumbnails.end(),
+			  [](const StoredThumbnail& a, const StoredThumbnail& b) {
+				  return a.modify_time < b.modify_time;
+			  });
+	for (const StoredThumbnail& thumbnail : thumbnails) {
+		if (total <= capacity) {
+			break;
+		}
+		if (SDL_RemovePath(thumbnail.path.c_str())) {
+			total -= thumbnail.size;
+			removed++;
+		}
+	}
+	if (removed > 0) {
+		SDL_Log("Removed %zu old thumbnails", removed);
+	}
+}
+
+// Whether all pixels of a surface in a decoder format are opaque.
+static bool is_opaque(const SDL_Surface* surface) {
+	PixelPacking packing{};
+	if (!get_packing(surface->format, packing) || packing.alpha == 0) {
+		return true;
+	}
+	for (int y = 0; y < surface->h; y++) {
+		const auto* row = reinterpret_cast<const std::uint32_t*>(
+			static_cast<const Uint8*>(surface->pixels) +
+			static_cast<std::size_t>(y) * surface->pitch);
+		for (int x = 0; x < surface->w; x++) {
+			if ((row[x] & packing.alpha) != packing.alpha) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool ThumbnailStore::save(const std::string& path, const SDL_PathInfo& info,
+						  int size, SDL_Surface* thumbnail) const {
+	if (directory.empty()) {
+		return SDL_SetError("Thumbnails are not saved");
+	}
+	std::vector<Uint8> image;
+	if (is_opaque(thumbnail) ? !encode_jpeg(thumbnail, JPEG_QUALITY, image)
+							 : !encode_png(thumbnail, image)) {
+		return false;
+	}
+
+	const std::string final_path = file_path(path, size);
+	char suffix[32];
+	SDL_snprintf(suffix, sizeof(suffix), ".%" SDL_PRIu64 ".tmp",
+				 static_cast<Uint64>(SDL_GetCurrentThreadID()));
+	const std::string temporary_path = final_path + suffix;
+	SDL_IOStream* stream = SDL_IOFromFile(temporary_path.c_str(), "wb");
+	if (stream == nullptr) {
+		return false;
+	}
+	bool written =
+		SDL_WriteIO(stream, MAGIC, sizeof(MAGIC)) == sizeof(MAGIC) &&
+		SDL_WriteU32LE(stream, static_cast<Uint32>(size)) &&
+		SDL_WriteU64LE(stream, info.size) &&
+		SDL_WriteS64LE(stream, info.modify_time) &&
+		SDL_WriteU32LE(stream, static_cast<Uint32>(path.size())) &&
+		SDL_WriteIO(stream, path.data(), path.size()) == path.size() &&
+		SDL_WriteIO(stream, image.data(), image.size()) == image.size();
+	written = SDL_CloseIO(stream) && written;
+	if (!written ||
+		!SDL_RenamePath(temporary_path.c_str(), final_path.c_str())) {
+		const std::string reason = SDL_GetError();
+		SDL_RemovePath(temporary_path.c_str());
+		return SDL_SetError("%s", reason.c_str());
+	}
+	return true;
+}
@@ -0,0 +1,80 @@
+#ifndef SRC_THUMBNAIL_STORE_H_
+#define SRC_THUMBNAIL_STORE_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <string>
+
+/*
+Persistent cache of thumbnails on disk, so that a folder of images only has to
+be decoded once.
+
+Every thumbnail is stored in a file of its own, named after a hash of the path
+of the image and the size of the thumbnail, so the thumbnail of a changed image
+replaces the old one. The file starts with a small header repeating the path
+and recording the size and modification time of the image, which guards
+against hash collisions and stale thumbnails, followed by the thumbnail as a
+JPEG file, or a PNG file if it has transparent pixels. A thumbnail of a photo
+takes around 10 to 20 KB this way. Thumbnails of images which have been moved
+or deleted are left behind until `prune()` removes them. Loading a thumbnail
+updates the modification time of its file, so the ones pruned first are those
+used longest ago.
+
+Files are written to a temporary name first and then renamed, so concurrent
+readers and writers (including other instances of the application) never see
+a partly written thumbnail. The store keeps no other state, so its member
+functions may be called from any thread.
+*/
+class ThumbnailStore {
+   private:
+	std::string directory;	// Ends with a path separator, empty if the store
+							// is disabled.
+
+	std::string file_path(const std::string& path, int size) const;
+
+   public:
+	/*
+	Open a store, creating its directory if necessary.
+
+	@param directory The directory holding the thumbnails, ending with a path
+	separator. If it is empty or cannot be created, the store is disabled and
+	never finds or saves any thumbnail.
+	*/
+	explicit ThumbnailStore(std::string directory);
+
+	// The default directory, inside the user's preference directory.
+	static std::string default_directory();
+
+	/*
+	Remove the thumbnails used longest ago until the store holds at most
+	`capacity` bytes of them, and the temporary files left behind by writers
+	which did not finish.
+	*/
+	void prune(std::size_t capacity) const;
+
+	/*
+	Find the thumbnail of an image.
+
+	@param path The path of the image (UTF-8).
+	@param info The size and modification time of the image file.
+	@param size The largest width and height of the thumbnail, which is part
+	of the key, since thumbnails of other sizes are not useful.
+
+	@return A surface owned by the caller, or `nullptr` if the store has no
+	valid thumbnail of the image.
+	*/
+	SDL_Surface* load(const std::string& path, const SDL_PathInfo& info,
+					  int size, SDL_PixelFormat format) const;
+
+	/*
+	Store the thumbnail of an image, replacing any previous one.
+
+	@return `false` if the thumbnail could not be written, in which case
+	`SDL_GetError()` describes the error.
+	*/
+	bool save(const std::string& path, const SDL_PathInfo& info, int size,
+			  SDL_Surface* thumbnail) const;
+};
+
+#endif	// SRC_THUMBNAIL_STORE_H_
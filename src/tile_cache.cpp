@@ -0,0 +1,244 @@
+#include "tile_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "profiler.h"
+
+// Tile textures always use a 32-bit pixel format.
+static const std::size_t TEXTURE_BYTES =
+	static_cast<std::size_t>(TileCache::TEXTURE_SIZE) *
+	TileCache::TEXTURE_SIZE * 4;
+
+TileCache::TileCache(SDL_Renderer* renderer, std::size_t budget,
+					 int uploads_per_frame)
+	: renderer{renderer},
+	  budget{budget},
+	  usage{0},
+	  frame{0},
+	  uploads_left{0},
+	  uploads_per_frame{uploads_per_frame},
+	  deferred{false},
+	  failing{false} {
+	auto max_size = SDL_GetNumberProperty(
+		SDL_GetRendererProperties(renderer),
+		SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 0);
+	if (max_size != 0 && max_size < TEXTURE_SIZE) {
+		SDL_Log("The renderer only supports %dx%d textures, tiles need %dx%d",
+				static_cast<int>(max_size), static_cast<int>(max_size),
+				TEXTURE_SIZE, TEXTURE_SIZE);
+	}
+}
+
+void TileCache::set_budget(std::size_t bytes) {
+	budget = bytes;
+	evict();
+}
+
+void TileCache::begin_frame() {
+	frame++;
+	uploads_left = uploads_per_frame;
+	deferred = false;
+}
+
+/*
+Destroy the least recently used tiles until the cache fits in the budget,
+without touching the tiles used during the current frame.
+*/
+void TileCache::evict() {
+	while (usage > budget && !tiles.empty() && tiles.back().frame != frame) {
+		SDL_DestroyTexture(tiles.back().texture);
+		index.erase(tiles.back().key);
+		tiles.pop_back();
+		usage -= TEXTURE_BYTES;
+	}
+}
+
+/*
+Get a texture for a new tile. Once the budget is used up, the texture of the
+least recently used tile is taken over, which saves creating a texture.
+*/
+SDL_Texture* TileCache::reuse_or_create(SDL_PixelFormat format) {
+	if (usage + TEXTURE_BYTES > budget && !tiles.empty() &&
+		tiles.back().frame != frame && tiles.back().texture->format == format) {
+		SDL_Texture* texture = tiles.back().texture;
+		index.erase(tiles.back().key);
+		tiles.pop_back();
+		return texture;
+	}
+	SDL_Texture* texture =
+		SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC,
+						  TEXTURE_SIZE, TEXTURE_SIZE);
+	if (texture != nullptr) {
+		usage += TEXTURE_BYTES;
+	}
+	return texture;
+}
+
+// The rows of the level a tile needs, including the border below it.
+static int needed_rows(const TileKey& key) {
+	return std::min((key.y + 1) * ImagePyramid::TILE_SIZE + 1,
+					key.image->level(key.level)->h);
+}
+
+// The number of rows of a tile which can be drawn, given the final rows of its
+// level.
+static int valid_rows(const TileKey& key, int ready) {
+	const int y0 = key.y * ImagePyramid::TILE_SIZE;
+	const int height = std::min(ImagePyramid::TILE_SIZE,
+								key.image->level(key.level)->h - y0);
+	return std::clamp(ready - y0, 0, height);
+}
+
+/*
+Copy a tile and its border into a texture. Borders inside the level come from
+the neighbouring tiles, borders at the edges of the level repeat the edge.
+
+@param ready The number of final rows of the level. Only the final rows of the
+tile are uploaded, with the last one repeated as the border below them.
+@param source Makes the pixels instead of copying them, if set.
+*/
+bool TileCache::upload(const TileKey& key, SDL_Texture* texture, int ready,
+					   const TileSource& source) {
+	ProfileScope profile(PROFILE_STAGE_UPLOAD);
+	const SDL_Surface* level = key.image->level(key.level);
+	const int x0 = key.x * ImagePyramid::TILE_SIZE;
+	const int y0 = key.y * ImagePyramid::TILE_SIZE;
+	const int width = std::min(ImagePyramid::TILE_SIZE, level->w - x0);
+	const int height = valid_rows(key, ready);
+	const SDL_Rect rect{0, 0, width + 2, height + 2};
+	const auto* pixels = static_cast<const Uint8*>(level->pixels);
+
+	if (source) {
+		const std::size_t pitch = static_cast<std::size_t>(rect.w) * 4;
+		staging.resize(pitch * rect.h);
+		SDL_Surface* tile =
+			SDL_CreateSurfaceFrom(rect.w, rect.h, level->format,
+								  staging.data(), static_cast<int>(pitch));
+		if (tile == nullptr) {
+			return false;
+		}
+		source(key, SDL_Rect{x0 - 1, y0 - 1, rect.w, rect.h}, ready, tile);
+		SDL_DestroySurface(tile);
+		return SDL_UpdateTexture(texture, &rect, staging.data(),
+								 static_cast<int>(pitch));
+	}
+
+	// Tiles away from the edges can be uploaded straight from the level.
+	if (x0 > 0 && y0 > 0 && x0 + width < level->w && y0 + height < ready) {
+		const Uint8* start =
+			pixels + static_cast<std::size_t>(y0 - 1) * level->pitch +
+			static_cast<std::size_t>(x0 - 1) * 4;
+		return SDL_UpdateTexture(texture, &rect, start, level->pitch);
+	}
+
+	const std::size_t pitch = static_cast<std::size_t>(rect.w) * 4;
+	staging.resize(pitch * rect.h);
+	for (int row = 0; row < rect.h; row++) {
+		const int y = std::clamp(y0 - 1 + row, 0, ready - 1);
+		const Uint8* source = pixels + static_cast<std::size_t>(y) *
+										   level->pitch +
+							  static_cast<std::size_t>(x0) * 4;
+		Uint8* out = staging.data() + row * pitch;
+		std::memcpy(out + 4, source, static_cast<std::size_t>(width) * 4);
+		std::memcpy(out, x0 > 0 ? source - 4 : source, 4);
+		std::memcpy(out + pitch - 4,
+					x0 + width < level->w ? source + width * 4
+										  : source + (width - 1) * 4,
+					4);
+	}
+	return SDL_UpdateTexture(texture, &rect, staging.data(),
+							 static_cast<int>(pitch));
+}
+
+SDL_Texture* TileCache::find(const TileKey& key, int& rows) {
+	auto it = index.find(key);
+	if (it == index.end()) {
+		return nullptr;
+	}
+	tiles.splice(tiles.begin(), tiles, it->second);
+	Tile& tile = *it->second;
+	tile.frame = frame;
+	rows = valid_rows(key, tile.ready);
+	return tile.texture;
+}
+
+SDL_Texture* TileCache::request(const TileKey& key, int& rows,
+								const TileSource& source) {
+	const int ready = key.image->ready_rows(key.level);
+	SDL_Texture* texture = find(key, rows);
+	if (texture != nullptr) {
+		// Add the rows decoded since the tile was uploaded.
+		Tile& tile = *index.find(key)->second;
+		if (tile.ready < needed_rows(key) && tile.ready < ready) {
+			if (uploads_left == 0) {
+				deferred = true;
+				return texture;
+			}
+			uploads_left--;
+			if (upload(key, texture, ready, source)) {
+				tile.ready = ready;
+				rows = valid_rows(key, ready);
+			}
+		}
+		return texture;
+	}
+	if (valid_rows(key, ready) == 0) {
+		return nullptr;
+	}
+	if (uploads_left == 0) {
+		deferred = true;
+		return nullptr;
+	}
+	uploads_left--;
+
+	texture = reuse_or_create(key.image->format());
+	if (texture == nullptr || !upload(key, texture, ready, source)) {
+		// Only report the first of a series of failures, since the same tiles
+		// are requested again every frame.
+		if (!failing) {
+			SDL_Log("Failed to upload tile: %s", SDL_GetError());
+			failing = true;
+		}
+		if (texture != nullptr) {
+			SDL_DestroyTexture(texture);
+			usage -= TEXTURE_BYTES;
+		}
+		return nullptr;
+	}
+	failing = false;
+
+	tiles.push_front(Tile{key, texture, frame, ready});
+	index.emplace(key, tiles.begin());
+	evict();
+	rows = valid_rows(key, ready);
+	return texture;
+}
+
+void TileCache::release(const ImagePyramid* image) {
+	for (auto it = tiles.begin(); it != tiles.end();) {
+		if (it->key.image != image) {
+			++it;
+			continue;
+		}
+		SDL_DestroyTexture(it->texture);
+		index.erase(it->key);
+		it = tiles.erase(it);
+		usage -= TEXTURE_BYTES;
+	}
+}
+
+void TileCache::uv(const SDL_FRect& rect, SDL_FPoint& uv_min,
+				   SDL_FPoint& uv_max) {
+	// Skip the border.
+	const float size = TEXTURE_SIZE;
+	uv_min = SDL_FPoint{(rect.x + 1) / size, (rect.y + 1) / size};
+	uv_max = SDL_FPoint{(rect.x + rect.w + 1) / size,
+						(rect.y + rect.h + 1) / size};
+}
+
+TileCache::~TileCache() {
+	for (Tile& tile : tiles) {
+		SDL_DestroyTexture(tile.texture);
+	}
+}
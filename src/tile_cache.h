@@ -0,0 +1,168 @@
+#ifndef SRC_TILE_CACHE_H_
+#define SRC_TILE_CACHE_H_
+
+#include <SDL3/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "image_pyramid.h"
+
+// Identifies one tile of one mip level of an image.
+struct TileKey {
+	const ImagePyramid* image;
+	int level;
+	int x;	// Column and row of the tile within the level.
+	int y;
+	// Distinguishes the pixels made by a `TileSource`, 0 being the pixels of
+	// the level.
+	std::uint64_t version = 0;
+
+	bool operator==(const TileKey& other) const {
+		return image == other.image && level == other.level && x == other.x &&
+			   y == other.y && version == other.version;
+	}
+};
+
+template <>
+struct std::hash<TileKey> {
+	std::size_t operator()(const TileKey& key) const {
+		std::size_t h = std::hash<const ImagePyramid*>()(key.image);
+		h = h * 31 + static_cast<std::size_t>(key.level);
+		h = h * 0x9e3779b1u + static_cast<std::size_t>(key.x);
+		h = h * 0x9e3779b1u + static_cast<std::size_t>(key.y);
+		return h * 0x9e3779b1u + static_cast<std::size_t>(key.version);
+	}
+};
+
+/*
+Makes the pixels of tiles instead of copying them from their level, e.g. with
+adjustments applied to them.
+
+@param area The part of the level to fill `tile` with, which includes the
+border of the tile. Pixels outside the level or beyond the final rows repeat
+the nearest pixel inside, as for tiles copied from their level.
+@param ready The number of final rows of the level.
+*/
+using TileSource = std::function<void(const TileKey& key, const SDL_Rect& area,
+									  int ready, SDL_Surface* tile)>;
+
+/*
+Textures holding the tiles of `ImagePyramid`s, of which only the recently drawn
+ones are kept within a memory budget.
+
+Every tile texture has a border of one pixel copied from the neighbouring
+tiles, so that bilinear filtering does not show seams between tiles. Drawing a
+tile should therefore use the texture coordinates from `TileCache::uv()`.
+
+Textures used during a frame are never evicted or reused before the next call
+to `begin_frame()`, since ImGui only draws them when the frame is rendered. The
+budget may be exceeded if a single frame needs more tiles than it allows.
+
+All member functions must be called from the thread owning the renderer.
+*/
+class TileCache {
+   private:
+	struct Tile {
+		TileKey key;
+		SDL_Texture* texture;
+		std::uint64_t frame;  // The frame the tile was last used in.
+		int ready;	// The final rows of the level when the tile was uploaded.
+	};
+
+	SDL_Renderer* renderer;
+	std::size_t budget;
+	std::size_t usage;
+	std::uint64_t frame;
+	int uploads_left;
+	int uploads_per_frame;
+	bool deferred;	// Whether a tile was left for the next frame.
+	bool failing;  // Whether the last upload failed.
+	std::list<Tile> tiles;	// Most recently used first.
+	std::unordered_map<TileKey, std::list<Tile>::iterator> index;
+	std::vector<Uint8> staging;	 // Border tiles are assembled here.
+
+	SDL_Texture* reuse_or_create(SDL_PixelFormat format);
+	bool upload(const TileKey& key, SDL_Texture* texture, int ready,
+				const TileSource& source);
+	void evict();
+
+   public:
+	// Width and height of tile textures, including the border.
+	static constexpr int TEXTURE_SIZE = ImagePyramid::TILE_SIZE + 2;
+
+	/*
+	Create an empty cache.
+
+	@param renderer The renderer used to create textures, which must outlive
+	the cache.
+	@param budget The largest number of bytes of texture memory to use.
+	@param uploads_per_frame The largest number of tiles uploaded per frame,
+	which bounds the time a frame spends uploading.
+	*/
+	TileCache(SDL_Renderer* renderer, std::size_t budget,
+			  int uploads_per_frame);
+
+	TileCache(const TileCache&) = delete;
+	TileCache& operator=(const TileCache&) = delete;
+
+	// Change the memory budget, evicting tiles if necessary.
+	void set_budget(std::size_t bytes);
+
+	// Bytes of texture memory currently used by the cache.
+	std::size_t memory_usage() const { return usage; }
+
+	// Start a new frame, which must happen before drawing anything.
+	void begin_frame();
+
+	/*
+	Whether the upload limit kept a requested tile from being uploaded or
+	updated during this frame, in which case the next frame uploads more.
+	*/
+	bool uploads_deferred() const { return deferred; }
+
+	/*
+	Get the texture of a tile, uploading it if it is not in the cache yet or
+	updating it if more of its rows have been decoded.
+
+	@param rows Receives the number of rows at the top of the tile which can be
+	drawn.
+	@param source Makes the pixels of the tile if set, in which case
+	`key.version` must identify what it makes.
+	@return The texture, or `nullptr` if the tile is not in the cache and
+	either none of its rows have been decoded yet or the upload limit of this
+	frame has been reached (or creating the texture failed).
+	*/
+	SDL_Texture* request(const TileKey& key, int& rows,
+						 const TileSource& source = nullptr);
+
+	/*
+	Get the texture of a tile only if it is already in the cache, as it is.
+	*/
+	SDL_Texture* find(const TileKey& key, int& rows);
+
+	/*
+	Drop all tiles of an image, which must happen before the image is
+	destroyed.
+	*/
+	void release(const ImagePyramid* image);
+
+	/*
+	Get the texture coordinates of a part of a tile.
+
+	@param rect The part of the tile, in pixels of the tile's level relative to
+	the top left corner of the tile.
+	@param uv_min Receives the texture coordinates of the top left corner.
+	@param uv_max Receives the texture coordinates of the bottom right corner.
+	*/
+	static void uv(const SDL_FRect& rect, SDL_FPoint& uv_min,
+				   SDL_FPoint& uv_max);
+
+	~TileCache();
+};
+
+#endif	// SRC_TILE_CACHE_H_
@@ -0,0 +1,38 @@
+#include "worker_thread.h"
+
+#include <utility>
+
+WorkerThread::WorkerThread()
+	: stopping{false}, thread(&WorkerThread::work, this) {}
+
+void WorkerThread::work() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		job_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+		if (jobs.empty()) {
+			return;	 // Stopping, with every job done.
+		}
+		std::function<void()> job = std::move(jobs.front());
+		jobs.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
+	}
+}
+
+void WorkerThread::submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	job_available.notify_one();
+}
+
+WorkerThread::~WorkerThread() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	job_available.notify_one();
+	thread.join();
+}
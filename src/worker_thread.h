@@ -0,0 +1,39 @@
+#ifndef SRC_WORKER_THREAD_H_
+#define SRC_WORKER_THREAD_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/*
+A thread running jobs one at a time, in the order they were submitted, for work
+that must not hold up the thread submitting it, such as the main thread. Jobs
+needing more than one thread can use a `TaskPool`.
+*/
+class WorkerThread {
+   private:
+	std::mutex mutex;  // Guards `jobs` and `stopping`.
+	std::condition_variable job_available;
+	std::deque<std::function<void()>> jobs;
+	bool stopping;
+	std::thread thread;
+
+	void work();
+
+   public:
+	// Start the thread.
+	WorkerThread();
+
+	WorkerThread(const WorkerThread&) = delete;
+	WorkerThread& operator=(const WorkerThread&) = delete;
+
+	// Queue a job, which is run once the jobs submitted before it are done.
+	void submit(std::function<void()> job);
+
+	// Run the jobs left in the queue and wait for the thread to exit.
+	~WorkerThread();
+};
+
+#endif	// SRC_WORKER_THREAD_H_